@@ -0,0 +1,680 @@
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include "activation.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ACTIVATION_X86
+#define TARGET_AVX2	  __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define ACTIVATION_X86
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+using namespace std;
+
+// The kernel chosen with selectActivationKernel. KERNEL_AUTO until one is chosen.
+static ActivationKernel selectedKernel = KERNEL_AUTO;
+
+// The precision chosen with selectActivationPrecision.
+static ActivationPrecision selectedPrecision = PRECISION_EXACT;
+
+// Coefficients of the Taylor series of e^r, 1/13! down to 1/2!. Degree 13 is accurate to under
+// an ulp for |r| <= ln(2)/2, and a polynomial of degree d starts from expCoefficients[13 - d].
+// Degree 6 is within 1.7e-7.
+static const double expCoefficients[] = {
+	1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+	1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0
+};
+
+// ln(2) split so that n * ln2Hi is exact for the exponents we reach (Cody & Waite).
+static const double ln2Hi = 6.93145751953125e-1;
+static const double ln2Lo = 1.42860682030941723212e-6;
+static const double log2e = 1.4426950408889634;
+
+/*
+ * Returns whether the CPU and operating system support a kernel.
+ *
+ * Parameters:
+ * ActivationKernel kernel - The kernel to check.
+ */
+static bool kernelSupported(ActivationKernel kernel) {
+	if (kernel == KERNEL_SCALAR || kernel == KERNEL_AUTO) {
+		return true;
+	}
+#if defined(ACTIVATION_X86) && defined(__GNUC__)
+	if (kernel == KERNEL_AVX2) {
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	}
+	if (kernel == KERNEL_AVX512) {
+		return __builtin_cpu_supports("avx512f");
+	}
+#elif defined(ACTIVATION_X86)
+	// Check the CPU flags, then that the OS saves the vector registers (XCR0) on a context switch.
+	int info[4];
+	__cpuid(info, 1);
+	bool fma	 = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+	__cpuidex(info, 7, 0);
+	if (kernel == KERNEL_AVX2) {
+		return fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+	}
+	if (kernel == KERNEL_AVX512) {
+		return (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+	}
+#endif
+	return false;
+}
+
+/*
+ * Returns the widest kernel the CPU supports.
+ */
+static ActivationKernel bestKernel() {
+	if (kernelSupported(KERNEL_AVX512)) {
+		return KERNEL_AVX512;
+	}
+	if (kernelSupported(KERNEL_AVX2)) {
+		return KERNEL_AVX2;
+	}
+	return KERNEL_SCALAR;
+}
+
+/*
+ * Selects the implementation used by rbfActivations. Call this before starting any threads that
+ * evaluate the network. Returns false, leaving the selection unchanged, if the CPU doesn't support
+ * the requested kernel.
+ *
+ * Parameters:
+ * ActivationKernel kernel - The kernel to use.
+ */
+bool selectActivationKernel(ActivationKernel kernel) {
+	if (!kernelSupported(kernel)) {
+		return false;
+	}
+	selectedKernel = kernel;
+	return true;
+}
+
+/*
+ * Returns the kernel currently used by rbfActivations. Never returns KERNEL_AUTO.
+ */
+ActivationKernel activationKernel() {
+	static const ActivationKernel autoKernel = bestKernel();
+	return selectedKernel == KERNEL_AUTO ? autoKernel : selectedKernel;
+}
+
+/*
+ * Selects how accurately rbfActivations and rbfForward calculate exp. Call this before starting any
+ * threads that evaluate the network.
+ *
+ * Parameters:
+ * ActivationPrecision precision - The precision to use.
+ */
+void selectActivationPrecision(ActivationPrecision precision) {
+	selectedPrecision = precision;
+}
+
+/*
+ * Returns the precision currently used by rbfActivations and rbfForward.
+ */
+ActivationPrecision activationPrecision() {
+	return selectedPrecision;
+}
+
+/*
+ * Returns the degree of the exp polynomial for a precision.
+ *
+ * Parameters:
+ * ActivationPrecision precision - The precision.
+ */
+static inline int expDegree(ActivationPrecision precision) {
+	return precision == PRECISION_FAST ? EXP_DEGREE_FAST : EXP_DEGREE_EXACT;
+}
+
+/*
+ * Calculates e^x one value at a time, the same way as the vector kernels' exp4. Used by the scalar
+ * kernel with PRECISION_FAST in place of the C library's exp.
+ *
+ * Parameters:
+ * double x	  - The exponent.
+ * int degree - The degree of the polynomial, at most EXP_DEGREE_EXACT.
+ */
+static inline double polynomialExp(double x, int degree) {
+	if (x < -708.39) {
+		return 0;
+	}
+	x = x < 709.0 ? x : 709.0;
+
+	double n = nearbyint(x * log2e);
+	double r = x - n * ln2Hi;
+	r -= n * ln2Lo;
+
+	double p = expCoefficients[EXP_DEGREE_EXACT - degree];
+	for (int i = EXP_DEGREE_EXACT - degree + 1; i < EXP_DEGREE_EXACT - 1; i++) {
+		p = p * r + expCoefficients[i];
+	}
+	p = p * r + 1.0;
+	p = p * r + 1.0;
+
+	// Build 2^n directly in the exponent bits.
+	uint64_t bits = (uint64_t) ((int64_t) n + 1023) << 52;
+	double power;
+	memcpy(&power, &bits, sizeof(power));
+	return p * power;
+}
+
+/*
+ * Returns a printable name for a kernel.
+ *
+ * Parameters:
+ * ActivationKernel kernel - The kernel to name.
+ */
+const char *activationKernelName(ActivationKernel kernel) {
+	switch (kernel) {
+		case KERNEL_SCALAR: return "scalar";
+		case KERNEL_AVX2:	return "avx2";
+		case KERNEL_AVX512: return "avx512";
+		default:			return "auto";
+	}
+}
+
+/*
+ * Copies a matrix of centers from the stride-3 layout used by k-means into structure-of-arrays form,
+ * where all of the first coordinates come first, then all of the second, then all of the third.
+ *
+ * Parameters:
+ * const double *centers - A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount		 - The number of centers.
+ * double *soaCenters	 - A preallocated array of size 3 x neuronCount to hold the result.
+ */
+void centersToSoA(const double *centers, int neuronCount, double *soaCenters) {
+	for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+		for (int i = 0; i < 3; i++) {
+			soaCenters[i * neuronCount + neuronIndex] = centers[neuronIndex * 3 + i];
+		}
+	}
+}
+
+/*
+ * Calculates the activations of a range of neurons one at a time, using the C library's exp unless
+ * the precision is PRECISION_FAST.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfActivations.
+ */
+static void rbfActivationsScalar(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, double *activations) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	double scale = -1.0 / (2 * width * width);
+
+	for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+		double dx = cx[neuronIndex] - input[0], dy = cy[neuronIndex] - input[1], dz = cz[neuronIndex] - input[2];
+		double exponent = (dx * dx + dy * dy + dz * dz) * scale;
+		activations[neuronIndex - neuronBegin] = precision == PRECISION_FAST ? polynomialExp(exponent, EXP_DEGREE_FAST) : exp(exponent);
+	}
+}
+
+/*
+ * Calculates the activations of a range of neurons one at a time and accumulates their sums.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfForward.
+ */
+static void rbfForwardScalar(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	double scale = -1.0 / (2 * width * width);
+
+	for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+		double dx = cx[neuronIndex] - input[0], dy = cy[neuronIndex] - input[1], dz = cz[neuronIndex] - input[2];
+		double exponent   = (dx * dx + dy * dy + dz * dz) * scale;
+		double activation = precision == PRECISION_FAST ? polynomialExp(exponent, EXP_DEGREE_FAST) : exp(exponent);
+		activations[neuronIndex - neuronBegin] = activation;
+		activationSum += activation;
+		weightedSum	  += activation * weights[neuronIndex];
+	}
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons one at a time.
+ *
+ * Parameters:
+ * See rbfTableActivations.
+ */
+static void rbfTableActivationsScalar(const double *const *rows, int neuronBegin, int neuronEnd, double *activations) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+	for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+		activations[neuronIndex - neuronBegin] = x[neuronIndex] * y[neuronIndex] * z[neuronIndex];
+	}
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons one at a time and accumulates their sums.
+ *
+ * Parameters:
+ * See rbfTableForward.
+ */
+static void rbfTableForwardScalar(const double *const *rows, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+	for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+		double activation = x[neuronIndex] * y[neuronIndex] * z[neuronIndex];
+		activations[neuronIndex - neuronBegin] = activation;
+		activationSum += activation;
+		weightedSum	  += activation * weights[neuronIndex];
+	}
+}
+
+#ifdef ACTIVATION_X86
+
+// Each vector kernel hands its last few neurons to the scalar one as a tail call, and GCC doesn't clear
+// the upper halves of the vector registers before it. The SSE code of the scalar kernel and of the
+// caller would then stall on every transition, so the vector kernels call _mm256_zeroupper themselves.
+
+/*
+ * Calculates e^x for 4 values. x is written as n * ln(2) + r, e^r comes from a polynomial
+ * and 2^n is built directly in the exponent bits. Results below the smallest normal double flush to 0.
+ *
+ * Parameters:
+ * __m256d x  - The exponents.
+ * int degree - The degree of the polynomial, at most EXP_DEGREE_EXACT.
+ */
+TARGET_AVX2 static inline __m256d exp4(__m256d x, int degree) {
+	const __m256d minArg = _mm256_set1_pd(-708.39);
+	const __m256d magic	 = _mm256_set1_pd(6755399441055744.0);
+
+	__m256d underflow = _mm256_cmp_pd(x, minArg, _CMP_LT_OQ);
+	x = _mm256_min_pd(_mm256_max_pd(x, minArg), _mm256_set1_pd(709.0));
+
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(ln2Hi), x);
+	r = _mm256_fnmadd_pd(n, _mm256_set1_pd(ln2Lo), r);
+
+	__m256d p = _mm256_set1_pd(expCoefficients[EXP_DEGREE_EXACT - degree]);
+	for (int i = EXP_DEGREE_EXACT - degree + 1; i < EXP_DEGREE_EXACT - 1; i++) {
+		p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(expCoefficients[i]));
+	}
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+
+	// Adding 1.5 * 2^52 leaves n as an integer in the low bits of the mantissa.
+	__m256i exponent = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)), _mm256_castpd_si256(magic));
+	exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+
+	return _mm256_andnot_pd(underflow, _mm256_mul_pd(p, _mm256_castsi256_pd(exponent)));
+}
+
+/*
+ * Calculates the activations of a range of neurons 4 at a time.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfActivations.
+ */
+TARGET_AVX2 static void rbfActivationsAvx2(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, double *activations) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	__m256d x = _mm256_set1_pd(input[0]), y = _mm256_set1_pd(input[1]), z = _mm256_set1_pd(input[2]);
+	__m256d scale = _mm256_set1_pd(-1.0 / (2 * width * width));
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 4 <= neuronEnd; neuronIndex += 4) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(cx + neuronIndex), x);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(cy + neuronIndex), y);
+		__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(cz + neuronIndex), z);
+		__m256d distance = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+		_mm256_storeu_pd(activations + neuronIndex - neuronBegin, exp4(_mm256_mul_pd(distance, scale), expDegree(precision)));
+	}
+	_mm256_zeroupper();
+	rbfActivationsScalar(precision, input, soaCenters, neuronCount, neuronIndex, neuronEnd, width, activations + neuronIndex - neuronBegin);
+}
+
+/*
+ * Calculates the activations of a range of neurons 4 at a time, accumulating their sums in registers.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfForward.
+ */
+TARGET_AVX2 static void rbfForwardAvx2(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	__m256d x = _mm256_set1_pd(input[0]), y = _mm256_set1_pd(input[1]), z = _mm256_set1_pd(input[2]);
+	__m256d scale = _mm256_set1_pd(-1.0 / (2 * width * width));
+	__m256d activationSums = _mm256_setzero_pd(), weightedSums = _mm256_setzero_pd();
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 4 <= neuronEnd; neuronIndex += 4) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(cx + neuronIndex), x);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(cy + neuronIndex), y);
+		__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(cz + neuronIndex), z);
+		__m256d distance   = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+		__m256d activation = exp4(_mm256_mul_pd(distance, scale), expDegree(precision));
+		_mm256_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+		activationSums = _mm256_add_pd(activationSums, activation);
+		weightedSums   = _mm256_fmadd_pd(activation, _mm256_loadu_pd(weights + neuronIndex), weightedSums);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, activationSums);
+	activationSum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_storeu_pd(lanes, weightedSums);
+	weightedSum	  += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_zeroupper();
+	rbfForwardScalar(precision, input, soaCenters, neuronCount, neuronIndex, neuronEnd, width, weights, activations + neuronIndex - neuronBegin, activationSum, weightedSum);
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons 4 at a time.
+ *
+ * Parameters:
+ * See rbfTableActivations.
+ */
+TARGET_AVX2 static void rbfTableActivationsAvx2(const double *const *rows, int neuronBegin, int neuronEnd, double *activations) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 4 <= neuronEnd; neuronIndex += 4) {
+		__m256d activation = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(x + neuronIndex), _mm256_loadu_pd(y + neuronIndex)), _mm256_loadu_pd(z + neuronIndex));
+		_mm256_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+	}
+	_mm256_zeroupper();
+	rbfTableActivationsScalar(rows, neuronIndex, neuronEnd, activations + neuronIndex - neuronBegin);
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons 4 at a time, accumulating their sums in registers.
+ *
+ * Parameters:
+ * See rbfTableForward.
+ */
+TARGET_AVX2 static void rbfTableForwardAvx2(const double *const *rows, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+	__m256d activationSums = _mm256_setzero_pd(), weightedSums = _mm256_setzero_pd();
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 4 <= neuronEnd; neuronIndex += 4) {
+		__m256d activation = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(x + neuronIndex), _mm256_loadu_pd(y + neuronIndex)), _mm256_loadu_pd(z + neuronIndex));
+		_mm256_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+		activationSums = _mm256_add_pd(activationSums, activation);
+		weightedSums   = _mm256_fmadd_pd(activation, _mm256_loadu_pd(weights + neuronIndex), weightedSums);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, activationSums);
+	activationSum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_storeu_pd(lanes, weightedSums);
+	weightedSum	  += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_zeroupper();
+	rbfTableForwardScalar(rows, neuronIndex, neuronEnd, weights, activations + neuronIndex - neuronBegin, activationSum, weightedSum);
+}
+
+/*
+ * Calculates e^x for 8 values, the same way as exp4, with scalef applying the 2^n. The unmasked
+ * min, max, roundscale and scalef start from an undefined register in GCC's headers, which -Wall
+ * reports as maybe uninitialized, so their masked forms are used on every lane from x instead.
+ *
+ * Parameters:
+ * __m512d x  - The exponents.
+ * int degree - The degree of the polynomial, at most EXP_DEGREE_EXACT.
+ */
+TARGET_AVX512 static inline __m512d exp8(__m512d x, int degree) {
+	const __m512d minArg = _mm512_set1_pd(-708.39);
+	const __mmask8 all	 = 0xFF;
+
+	__mmask8 underflow = _mm512_cmp_pd_mask(x, minArg, _CMP_LT_OQ);
+	x = _mm512_mask_min_pd(x, all, _mm512_mask_max_pd(x, all, x, minArg), _mm512_set1_pd(709.0));
+
+	__m512d n = _mm512_mask_roundscale_pd(x, all, _mm512_mul_pd(x, _mm512_set1_pd(log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(ln2Hi), x);
+	r = _mm512_fnmadd_pd(n, _mm512_set1_pd(ln2Lo), r);
+
+	__m512d p = _mm512_set1_pd(expCoefficients[EXP_DEGREE_EXACT - degree]);
+	for (int i = EXP_DEGREE_EXACT - degree + 1; i < EXP_DEGREE_EXACT - 1; i++) {
+		p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(expCoefficients[i]));
+	}
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+
+	return _mm512_maskz_mov_pd(~underflow, _mm512_mask_scalef_pd(p, all, p, n));
+}
+
+/*
+ * Adds the 8 lanes of a register in the same order as _mm512_reduce_add_pd, halves first, without
+ * its extracts from an undefined register.
+ *
+ * Parameters:
+ * __m512d sums - The lanes to add.
+ */
+TARGET_AVX512 static inline double sum8(__m512d sums) {
+	double lanes[8];
+	_mm512_storeu_pd(lanes, sums);
+	return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+/*
+ * Calculates the activations of a range of neurons 8 at a time.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfActivations.
+ */
+TARGET_AVX512 static void rbfActivationsAvx512(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, double *activations) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	__m512d x = _mm512_set1_pd(input[0]), y = _mm512_set1_pd(input[1]), z = _mm512_set1_pd(input[2]);
+	__m512d scale = _mm512_set1_pd(-1.0 / (2 * width * width));
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 8 <= neuronEnd; neuronIndex += 8) {
+		__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(cx + neuronIndex), x);
+		__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(cy + neuronIndex), y);
+		__m512d dz = _mm512_sub_pd(_mm512_loadu_pd(cz + neuronIndex), z);
+		__m512d distance = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+		_mm512_storeu_pd(activations + neuronIndex - neuronBegin, exp8(_mm512_mul_pd(distance, scale), expDegree(precision)));
+	}
+	_mm256_zeroupper();
+	rbfActivationsScalar(precision, input, soaCenters, neuronCount, neuronIndex, neuronEnd, width, activations + neuronIndex - neuronBegin);
+}
+
+
+/*
+ * Calculates the activations of a range of neurons 8 at a time, accumulating their sums in registers.
+ *
+ * Parameters:
+ * ActivationPrecision precision - How accurately to calculate exp.
+ * Otherwise see rbfForward.
+ */
+TARGET_AVX512 static void rbfForwardAvx512(ActivationPrecision precision, const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *cx = soaCenters, *cy = soaCenters + neuronCount, *cz = soaCenters + 2 * neuronCount;
+	__m512d x = _mm512_set1_pd(input[0]), y = _mm512_set1_pd(input[1]), z = _mm512_set1_pd(input[2]);
+	__m512d scale = _mm512_set1_pd(-1.0 / (2 * width * width));
+	__m512d activationSums = _mm512_setzero_pd(), weightedSums = _mm512_setzero_pd();
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 8 <= neuronEnd; neuronIndex += 8) {
+		__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(cx + neuronIndex), x);
+		__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(cy + neuronIndex), y);
+		__m512d dz = _mm512_sub_pd(_mm512_loadu_pd(cz + neuronIndex), z);
+		__m512d distance   = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+		__m512d activation = exp8(_mm512_mul_pd(distance, scale), expDegree(precision));
+		_mm512_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+		activationSums = _mm512_add_pd(activationSums, activation);
+		weightedSums   = _mm512_fmadd_pd(activation, _mm512_loadu_pd(weights + neuronIndex), weightedSums);
+	}
+
+	activationSum += sum8(activationSums);
+	weightedSum	  += sum8(weightedSums);
+	_mm256_zeroupper();
+	rbfForwardScalar(precision, input, soaCenters, neuronCount, neuronIndex, neuronEnd, width, weights, activations + neuronIndex - neuronBegin, activationSum, weightedSum);
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons 8 at a time.
+ *
+ * Parameters:
+ * See rbfTableActivations.
+ */
+TARGET_AVX512 static void rbfTableActivationsAvx512(const double *const *rows, int neuronBegin, int neuronEnd, double *activations) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 8 <= neuronEnd; neuronIndex += 8) {
+		__m512d activation = _mm512_mul_pd(_mm512_mul_pd(_mm512_loadu_pd(x + neuronIndex), _mm512_loadu_pd(y + neuronIndex)), _mm512_loadu_pd(z + neuronIndex));
+		_mm512_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+	}
+	_mm256_zeroupper();
+	rbfTableActivationsScalar(rows, neuronIndex, neuronEnd, activations + neuronIndex - neuronBegin);
+}
+
+/*
+ * Multiplies the per-dimension activations of a range of neurons 8 at a time, accumulating their sums in registers.
+ *
+ * Parameters:
+ * See rbfTableForward.
+ */
+TARGET_AVX512 static void rbfTableForwardAvx512(const double *const *rows, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *x = rows[0], *y = rows[1], *z = rows[2];
+	__m512d activationSums = _mm512_setzero_pd(), weightedSums = _mm512_setzero_pd();
+
+	int neuronIndex = neuronBegin;
+	for (; neuronIndex + 8 <= neuronEnd; neuronIndex += 8) {
+		__m512d activation = _mm512_mul_pd(_mm512_mul_pd(_mm512_loadu_pd(x + neuronIndex), _mm512_loadu_pd(y + neuronIndex)), _mm512_loadu_pd(z + neuronIndex));
+		_mm512_storeu_pd(activations + neuronIndex - neuronBegin, activation);
+		activationSums = _mm512_add_pd(activationSums, activation);
+		weightedSums   = _mm512_fmadd_pd(activation, _mm512_loadu_pd(weights + neuronIndex), weightedSums);
+	}
+
+	activationSum += sum8(activationSums);
+	weightedSum	  += sum8(weightedSums);
+	_mm256_zeroupper();
+	rbfTableForwardScalar(rows, neuronIndex, neuronEnd, weights, activations + neuronIndex - neuronBegin, activationSum, weightedSum);
+}
+#endif
+
+/*
+ * Calculates the activation exp(-||x - c||^2 / (2 * width^2)) of neurons neuronBegin to neuronEnd for
+ * one input point, several neurons at a time when a vector kernel is selected. The vector kernels use
+ * their own exp, which agrees with the C library to within a couple of units in the last place, or
+ * to within 2e-7 relative with PRECISION_FAST.
+ *
+ * Parameters:
+ * const double *input		- One data point, which is an array of 3 values.
+ * const double *soaCenters - The centers in structure-of-arrays form, see centersToSoA.
+ * int neuronCount			- The total number of centers, which is the length of each coordinate array.
+ * int neuronBegin			- The first neuron to evaluate.
+ * int neuronEnd			- One past the last neuron to evaluate.
+ * double width				- The width of each RBF neuron.
+ * double *activations		- A preallocated array to hold the result. activations[0] is the
+ *							  activation of neuron neuronBegin.
+ */
+void rbfActivations(const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, double *activations) {
+	switch (activationKernel()) {
+#ifdef ACTIVATION_X86
+		case KERNEL_AVX512:
+			rbfActivationsAvx512(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, activations);
+			break;
+		case KERNEL_AVX2:
+			rbfActivationsAvx2(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, activations);
+			break;
+#endif
+		default:
+			rbfActivationsScalar(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, activations);
+			break;
+	}
+}
+
+/*
+ * Calculates the activations of neurons neuronBegin to neuronEnd for one input point, like
+ * rbfActivations, and adds their sum and their weighted sum to the running totals for the point.
+ * The sums are kept in registers while the neurons are evaluated.
+ *
+ * Parameters:
+ * const double *input		- One data point, which is an array of 3 values.
+ * const double *soaCenters - The centers in structure-of-arrays form, see centersToSoA.
+ * int neuronCount			- The total number of centers, which is the length of each coordinate array.
+ * int neuronBegin			- The first neuron to evaluate.
+ * int neuronEnd			- One past the last neuron to evaluate.
+ * double width				- The width of each RBF neuron.
+ * const double *weights	- The weight array for the network, length neuronCount.
+ * double *activations		- A preallocated array to hold the activations. activations[0] is the
+ *							  activation of neuron neuronBegin.
+ * double &activationSum	- The running sum of the point's activations.
+ * double &weightedSum		- The running sum of the point's activations multiplied by their weights.
+ */
+void rbfForward(const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	switch (activationKernel()) {
+#ifdef ACTIVATION_X86
+		case KERNEL_AVX512:
+			rbfForwardAvx512(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, weights, activations, activationSum, weightedSum);
+			break;
+		case KERNEL_AVX2:
+			rbfForwardAvx2(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, weights, activations, activationSum, weightedSum);
+			break;
+#endif
+		default:
+			rbfForwardScalar(selectedPrecision, input, soaCenters, neuronCount, neuronBegin, neuronEnd, width, weights, activations, activationSum, weightedSum);
+			break;
+	}
+}
+
+/*
+ * Multiplies the per-dimension activations of neurons neuronBegin to neuronEnd for one input point,
+ * several neurons at a time when a vector kernel is selected. See ActivationTables.
+ *
+ * Parameters:
+ * const double *const *rows - The table row of each of the point's 3 coordinates, length neuronCount each.
+ * int neuronBegin			 - The first neuron to evaluate.
+ * int neuronEnd			 - One past the last neuron to evaluate.
+ * double *activations		 - A preallocated array to hold the result. activations[0] is the
+ *							   activation of neuron neuronBegin.
+ */
+void rbfTableActivations(const double *const *rows, int neuronBegin, int neuronEnd, double *activations) {
+	switch (activationKernel()) {
+#ifdef ACTIVATION_X86
+		case KERNEL_AVX512:
+			rbfTableActivationsAvx512(rows, neuronBegin, neuronEnd, activations);
+			break;
+		case KERNEL_AVX2:
+			rbfTableActivationsAvx2(rows, neuronBegin, neuronEnd, activations);
+			break;
+#endif
+		default:
+			rbfTableActivationsScalar(rows, neuronBegin, neuronEnd, activations);
+			break;
+	}
+}
+
+/*
+ * Multiplies the per-dimension activations of neurons neuronBegin to neuronEnd for one input point,
+ * like rbfTableActivations, and adds their sum and their weighted sum to the running totals for the
+ * point. The sums are kept in registers while the neurons are evaluated.
+ *
+ * Parameters:
+ * const double *const *rows - The table row of each of the point's 3 coordinates, length neuronCount each.
+ * int neuronBegin			 - The first neuron to evaluate.
+ * int neuronEnd			 - One past the last neuron to evaluate.
+ * const double *weights	 - The weight array for the network, length neuronCount.
+ * double *activations		 - A preallocated array to hold the activations. activations[0] is the
+ *							   activation of neuron neuronBegin.
+ * double &activationSum	 - The running sum of the point's activations.
+ * double &weightedSum		 - The running sum of the point's activations multiplied by their weights.
+ */
+void rbfTableForward(const double *const *rows, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	switch (activationKernel()) {
+#ifdef ACTIVATION_X86
+		case KERNEL_AVX512:
+			rbfTableForwardAvx512(rows, neuronBegin, neuronEnd, weights, activations, activationSum, weightedSum);
+			break;
+		case KERNEL_AVX2:
+			rbfTableForwardAvx2(rows, neuronBegin, neuronEnd, weights, activations, activationSum, weightedSum);
+			break;
+#endif
+		default:
+			rbfTableForwardScalar(rows, neuronBegin, neuronEnd, weights, activations, activationSum, weightedSum);
+			break;
+	}
+}
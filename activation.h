@@ -0,0 +1,144 @@
+#pragma once
+
+// The degrees of the polynomial the vector kernels approximate exp with. See ActivationPrecision.
+#define EXP_DEGREE_EXACT 13
+#define EXP_DEGREE_FAST	 6
+
+// The most PRECISION_FAST may change a trained network's validation error by, relative to it. See test/test.
+#define FAST_EXP_TOLERANCE 1e-4
+
+/*
+ * The implementations of the RBF activation kernel. KERNEL_AUTO picks the widest one the CPU supports.
+ */
+enum ActivationKernel {
+	KERNEL_AUTO,
+	KERNEL_SCALAR,
+	KERNEL_AVX2,
+	KERNEL_AVX512
+};
+
+/*
+ * How accurately the activation kernels calculate exp. PRECISION_FAST uses a polynomial of degree
+ * EXP_DEGREE_FAST rather than EXP_DEGREE_EXACT, which is within 2e-7 of exp relative to its value,
+ * and the scalar kernel uses the same polynomial in place of the C library's exp.
+ */
+enum ActivationPrecision {
+	PRECISION_EXACT,
+	PRECISION_FAST
+};
+
+/*
+ * Selects the implementation used by rbfActivations. Call this before starting any threads that
+ * evaluate the network. Returns false, leaving the selection unchanged, if the CPU doesn't support
+ * the requested kernel.
+ *
+ * Parameters:
+ * ActivationKernel kernel - The kernel to use.
+ */
+bool selectActivationKernel(ActivationKernel kernel);
+
+/*
+ * Returns the kernel currently used by rbfActivations. Never returns KERNEL_AUTO.
+ */
+ActivationKernel activationKernel();
+
+/*
+ * Selects how accurately rbfActivations and rbfForward calculate exp. Call this before starting any
+ * threads that evaluate the network.
+ *
+ * Parameters:
+ * ActivationPrecision precision - The precision to use.
+ */
+void selectActivationPrecision(ActivationPrecision precision);
+
+/*
+ * Returns the precision currently used by rbfActivations and rbfForward.
+ */
+ActivationPrecision activationPrecision();
+
+/*
+ * Returns a printable name for a kernel.
+ *
+ * Parameters:
+ * ActivationKernel kernel - The kernel to name.
+ */
+const char *activationKernelName(ActivationKernel kernel);
+
+/*
+ * Copies a matrix of centers from the stride-3 layout used by k-means into structure-of-arrays form,
+ * where all of the first coordinates come first, then all of the second, then all of the third.
+ *
+ * Parameters:
+ * const double *centers - A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount		 - The number of centers.
+ * double *soaCenters	 - A preallocated array of size 3 x neuronCount to hold the result.
+ */
+void centersToSoA(const double *centers, int neuronCount, double *soaCenters);
+
+/*
+ * Calculates the activation exp(-||x - c||^2 / (2 * width^2)) of neurons neuronBegin to neuronEnd for
+ * one input point, several neurons at a time when a vector kernel is selected. The vector kernels use
+ * their own exp, which agrees with the C library to within a couple of units in the last place, or
+ * to within 2e-7 relative with PRECISION_FAST.
+ *
+ * Parameters:
+ * const double *input		- One data point, which is an array of 3 values.
+ * const double *soaCenters - The centers in structure-of-arrays form, see centersToSoA.
+ * int neuronCount			- The total number of centers, which is the length of each coordinate array.
+ * int neuronBegin			- The first neuron to evaluate.
+ * int neuronEnd			- One past the last neuron to evaluate.
+ * double width				- The width of each RBF neuron.
+ * double *activations		- A preallocated array to hold the result. activations[0] is the
+ *							  activation of neuron neuronBegin.
+ */
+void rbfActivations(const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, double *activations);
+
+/*
+ * Calculates the activations of neurons neuronBegin to neuronEnd for one input point, like
+ * rbfActivations, and adds their sum and their weighted sum to the running totals for the point.
+ * The sums are kept in registers while the neurons are evaluated.
+ *
+ * Parameters:
+ * const double *input		- One data point, which is an array of 3 values.
+ * const double *soaCenters - The centers in structure-of-arrays form, see centersToSoA.
+ * int neuronCount			- The total number of centers, which is the length of each coordinate array.
+ * int neuronBegin			- The first neuron to evaluate.
+ * int neuronEnd			- One past the last neuron to evaluate.
+ * double width				- The width of each RBF neuron.
+ * const double *weights	- The weight array for the network, length neuronCount.
+ * double *activations		- A preallocated array to hold the activations. activations[0] is the
+ *							  activation of neuron neuronBegin.
+ * double &activationSum	- The running sum of the point's activations.
+ * double &weightedSum		- The running sum of the point's activations multiplied by their weights.
+ */
+void rbfForward(const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double *activations, double &activationSum, double &weightedSum);
+
+/*
+ * Multiplies the per-dimension activations of neurons neuronBegin to neuronEnd for one input point,
+ * several neurons at a time when a vector kernel is selected. See ActivationTables.
+ *
+ * Parameters:
+ * const double *const *rows - The table row of each of the point's 3 coordinates, length neuronCount each.
+ * int neuronBegin			 - The first neuron to evaluate.
+ * int neuronEnd			 - One past the last neuron to evaluate.
+ * double *activations		 - A preallocated array to hold the result. activations[0] is the
+ *							   activation of neuron neuronBegin.
+ */
+void rbfTableActivations(const double *const *rows, int neuronBegin, int neuronEnd, double *activations);
+
+/*
+ * Multiplies the per-dimension activations of neurons neuronBegin to neuronEnd for one input point,
+ * like rbfTableActivations, and adds their sum and their weighted sum to the running totals for the
+ * point. The sums are kept in registers while the neurons are evaluated.
+ *
+ * Parameters:
+ * const double *const *rows - The table row of each of the point's 3 coordinates, length neuronCount each.
+ * int neuronBegin			 - The first neuron to evaluate.
+ * int neuronEnd			 - One past the last neuron to evaluate.
+ * const double *weights	 - The weight array for the network, length neuronCount.
+ * double *activations		 - A preallocated array to hold the activations. activations[0] is the
+ *							   activation of neuron neuronBegin.
+ * double &activationSum	 - The running sum of the point's activations.
+ * double &weightedSum		 - The running sum of the point's activations multiplied by their weights.
+ */
+void rbfTableForward(const double *const *rows, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum);
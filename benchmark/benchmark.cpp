@@ -0,0 +1,621 @@
+/*
+ * Benchmarks for the predictor: the data loaders, k-means and its initializers, the batched and
+ * sparse forward passes, a training epoch, the error calculation, loading a model and predicting
+ * with it, and a reduced end-to-end sweep.
+ * Every case uses data/train.csv and fixed seeds, so runs on the same machine are comparable. Run
+ * from the repository root so the data files are found.
+ *
+ * Usage:
+ * benchmark/benchmark [--json results.json] [--filter name] [--data data/train.csv]
+ *
+ * Build:
+ * g++ -O2 -pthread benchmark/benchmark.cpp io.cpp kmeans.cpp network.cpp activation.cpp clusters.cpp sweep.cpp grid.cpp model.cpp tables.cpp -o benchmark/benchmark
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "../activation.h"
+#include "../clusters.h"
+#include "../io.h"
+#include "../kmeans.hpp"
+#include "../model.h"
+#include "../network.h"
+#include "../sweep.h"
+
+#define BENCHMARK_SEED		  10
+#define BENCHMARK_MAX_RESULTS 96
+#define BENCHMARK_WIDTH		  0.05
+#define BENCHMARK_CUTOFF	  6
+#define BENCHMARK_MODEL		  "benchmark.model"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * The timing of a single benchmark case.
+ *
+ * Members:
+ * char name[64]	   - The name of the case.
+ * int repeats		   - The number of times the case was run.
+ * double bestSeconds  - The fastest run.
+ * double meanSeconds  - The mean of every run.
+ * double megabytes	   - The amount of data each run processes, or 0 if throughput doesn't apply.
+ * int iterations	   - A case specific count, such as k-means iterations, or 0.
+ */
+struct BenchmarkResult {
+	char   name[64];
+	int	   repeats;
+	double bestSeconds;
+	double meanSeconds;
+	double megabytes;
+	int	   iterations;
+};
+
+/*
+ * The state shared by every benchmark case.
+ *
+ * Members:
+ * char *csvFilename					- The CSV file the data set was loaded from.
+ * char *binaryFilename					- The binary copy of the CSV file, for the mapData case.
+ * const double *normalizationConstants	- Constants used to normalize the input data.
+ * const char *filter					- Only cases whose names contain this are run. NULL runs every case.
+ * DataSet train						- The data set every case runs on.
+ * int neuronCount						- The number of neurons in the current case's network.
+ * KMeansRoutine kmeans					- The k-means routine the current k-means case runs.
+ * ClusterInitializer initializer		- How the current k-means case seeds its centers.
+ * double *centers						- The current network's centers, size neuronCount x 3.
+ * double *weights						- The current network's weights, length neuronCount.
+ * ActivationMatrix activations			- The activations of the training data for the current network.
+ * double *output						- The network output for the training data.
+ * double *residuals					- The residual of each training data point, for train.
+ * NeuronGrid grid						- The current network's centers bucketed into a grid, for getOutputSparse.
+ * ActivationTables tables				- The current network's activations tabulated over the calendar inputs.
+ * Model model							- The current network saved and loaded again as a model.
+ * PredictionTable predictionTable		- The model compiled into a quantized table of every prediction.
+ * int iterations						- Set by cases that report a count, such as k-means iterations.
+ * BenchmarkResult results[]			- The results so far.
+ * int resultCount						- The number of results so far.
+ */
+struct Benchmark {
+	char			   *csvFilename;
+	char			   *binaryFilename;
+	const double	   *normalizationConstants;
+	const char		   *filter;
+	DataSet				train;
+	int					neuronCount;
+	KMeansRoutine		kmeans;
+	ClusterInitializer	initializer;
+	double			   *centers;
+	double			   *weights;
+	ActivationMatrix	activations;
+	double			   *output;
+	double			   *residuals;
+	NeuronGrid			grid;
+	ActivationTables	tables;
+	Model				model;
+	PredictionTable		predictionTable;
+	int					iterations;
+	BenchmarkResult		results[BENCHMARK_MAX_RESULTS];
+	int					resultCount;
+};
+
+/*
+ * Returns whether the filter selects a case.
+ *
+ * Parameters:
+ * const Benchmark &benchmark - The shared state holding the filter.
+ * const char *name			  - The name of the case.
+ */
+static bool selected(const Benchmark &benchmark, const char *name) {
+	return benchmark.filter == NULL || strstr(name, benchmark.filter) != NULL;
+}
+
+/*
+ * Runs a benchmark case repeats times and records its timing, unless the filter excludes it.
+ *
+ * Parameters:
+ * Benchmark &benchmark			   - The shared state, which the case reads its inputs from.
+ * const char *name				   - The name of the case.
+ * int repeats					   - The number of times to run the case.
+ * void (*function)(Benchmark&)	   - The case.
+ * double megabytes				   - The amount of data each run processes, or 0.
+ */
+static void runCase(Benchmark &benchmark, const char *name, int repeats, void (*function)(Benchmark&), double megabytes) {
+	if (!selected(benchmark, name)) {
+		return;
+	}
+	if (benchmark.resultCount == BENCHMARK_MAX_RESULTS) {
+		printf("Too many benchmark cases, skipping %s.\n", name);
+		return;
+	}
+
+	BenchmarkResult &result = benchmark.results[benchmark.resultCount++];
+	snprintf(result.name, sizeof(result.name), "%s", name);
+	result.repeats	   = repeats;
+	result.bestSeconds = 1e30;
+	result.meanSeconds = 0;
+	result.megabytes   = megabytes;
+
+	benchmark.iterations = 0;
+	for (int repeat = 0; repeat < repeats; repeat++) {
+		steady_clock::time_point start = steady_clock::now();
+		function(benchmark);
+		double seconds = duration<double>(steady_clock::now() - start).count();
+		result.bestSeconds = seconds < result.bestSeconds ? seconds : result.bestSeconds;
+		result.meanSeconds += seconds / repeats;
+	}
+	result.iterations = benchmark.iterations;
+
+	printf("%-36s %10.3f ms %10.3f ms", result.name, result.bestSeconds * 1000, result.meanSeconds * 1000);
+	if (megabytes > 0) {
+		printf(" %9.1f MB/s", megabytes / result.bestSeconds);
+	}
+	if (result.iterations > 0) {
+		printf(" %6d iterations", result.iterations);
+	}
+	printf("\n");
+}
+
+/*
+ * Returns the size of a file in megabytes.
+ *
+ * Parameters:
+ * char *filename - The name of the file.
+ */
+static double fileMegabytes(char *filename) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	double size = ftell(file) / (1024.0 * 1024.0);
+	fclose(file);
+	return size;
+}
+
+/*
+ * Loads the CSV file with the original two pass loader, getFileSize followed by loadData.
+ */
+static void benchmarkLoadData(Benchmark &benchmark) {
+	int		count  = getFileSize(benchmark.csvFilename);
+	double *input  = (double*) malloc(sizeof(double) * count * 3);
+	double *target = (double*) malloc(sizeof(double) * count);
+	loadData(benchmark.csvFilename, benchmark.normalizationConstants, input, target);
+	free(input);
+	free(target);
+}
+
+/*
+ * Loads the CSV file with the single pass loader.
+ */
+static void benchmarkParseData(Benchmark &benchmark) {
+	DataSet dataSet;
+	if (parseData(benchmark.csvFilename, benchmark.normalizationConstants, dataSet)) {
+		freeDataSet(dataSet);
+	}
+}
+
+/*
+ * Maps in the binary copy of the CSV file, including verifying its checksum.
+ */
+static void benchmarkMapData(Benchmark &benchmark) {
+	DataSet dataSet;
+	if (mapData(benchmark.binaryFilename, benchmark.csvFilename, benchmark.normalizationConstants, dataSet)) {
+		freeDataSet(dataSet);
+	}
+}
+
+/*
+ * Copies the data set with its rows with identical inputs merged.
+ */
+static void benchmarkCompactData(Benchmark &benchmark) {
+	DataSet compact;
+	if (compactDataSet(benchmark.train, compact) > 0) {
+		freeDataSet(compact);
+	}
+}
+
+/*
+ * Clusters the data set into neuronCount clusters with benchmark.kmeans, seeded by
+ * benchmark.initializer, and leaves the centers in benchmark.centers.
+ */
+static void benchmarkKmeans(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * trainSet.count);
+	int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * benchmark.neuronCount);
+	double *clusterEnergies    = (double*) malloc(sizeof(double) * benchmark.neuronCount);
+	int		seed			   = BENCHMARK_SEED;
+	initializeCenters(trainSet, benchmark.neuronCount, benchmark.initializer, &seed, benchmark.centers);
+	i4vec_negone(trainSet.count, clusterAllocations);
+	benchmark.kmeans(3, trainSet.count, benchmark.neuronCount, 500, benchmark.iterations, trainSet.input, clusterAllocations, benchmark.centers, clusterPopulations, clusterEnergies);
+	free(clusterAllocations);
+	free(clusterPopulations);
+	free(clusterEnergies);
+}
+
+/*
+ * Clusters the data set into neuronCount clusters with hmeans_03 on every available core, seeded
+ * with the first data points.
+ */
+static void benchmarkHmeans(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * trainSet.count);
+	int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * benchmark.neuronCount);
+	double *clusterEnergies    = (double*) malloc(sizeof(double) * benchmark.neuronCount);
+	for (int i = 0; i < benchmark.neuronCount * 3; i++) {
+		benchmark.centers[i] = trainSet.input[i];
+	}
+	i4vec_negone(trainSet.count, clusterAllocations);
+	int threadCount = thread::hardware_concurrency();
+	hmeans_03(3, trainSet.count, benchmark.neuronCount, 500, benchmark.iterations, trainSet.input, clusterAllocations, benchmark.centers, clusterPopulations, clusterEnergies, threadCount > 0 ? threadCount : 1);
+	free(clusterAllocations);
+	free(clusterPopulations);
+	free(clusterEnergies);
+}
+
+/*
+ * Clusters the binary copy of the data set with mini-batch k-means, streaming each batch from the
+ * file, seeded with the first data points.
+ */
+static void benchmarkStreamKmeans(Benchmark &benchmark) {
+	DataStream stream;
+	if (!openDataStream(benchmark.binaryFilename, benchmark.normalizationConstants, stream)) {
+		return;
+	}
+	double *clusterCenters = (double*) malloc(sizeof(double) * benchmark.neuronCount * 3);
+	int		seed		   = BENCHMARK_SEED;
+	if (readRows(stream, 0, benchmark.neuronCount, clusterCenters)) {
+		clusterMiniBatch(stream, benchmark.neuronCount, 1024, 500, 1e-6, &seed, clusterCenters, benchmark.iterations);
+	}
+	free(clusterCenters);
+	closeDataStream(stream);
+}
+
+/*
+ * Calculates the network output for the whole data set.
+ */
+static void benchmarkGetOutput(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	getOutput(trainSet.input, trainSet.count, benchmark.neuronCount, benchmark.centers, benchmark.weights, BENCHMARK_WIDTH, benchmark.activations, benchmark.output);
+}
+
+/*
+ * Buckets the current network's centers into benchmark.grid, replacing the last grid.
+ */
+static void benchmarkBuildGrid(Benchmark &benchmark) {
+	freeNeuronGrid(benchmark.grid);
+	buildNeuronGrid(benchmark.centers, benchmark.neuronCount, BENCHMARK_WIDTH, BENCHMARK_CUTOFF, benchmark.grid);
+}
+
+/*
+ * Calculates the network output for the whole data set, evaluating only the neurons near each
+ * input. Reports the mean number of neurons evaluated per input.
+ */
+static void benchmarkGetOutputSparse(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	benchmark.iterations = (int) getOutputSparse(trainSet.input, trainSet.count, benchmark.grid, benchmark.weights, benchmark.output);
+}
+
+/*
+ * Calculates the network output, residuals and squared error for the whole data set in one pass.
+ */
+static void benchmarkGetOutputError(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	getOutputError(trainSet.input, trainSet.count, benchmark.neuronCount, benchmark.centers, benchmark.weights, BENCHMARK_WIDTH, benchmark.activations,
+		trainSet.target, benchmark.output, benchmark.residuals);
+}
+
+/*
+ * Calculates the network output, residuals and squared error like benchmarkGetOutputError, with exp
+ * calculated by the shorter polynomial of PRECISION_FAST.
+ */
+static void benchmarkGetOutputErrorFast(Benchmark &benchmark) {
+	selectActivationPrecision(PRECISION_FAST);
+	benchmarkGetOutputError(benchmark);
+	selectActivationPrecision(PRECISION_EXACT);
+}
+
+/*
+ * Tabulates the current network's activations into benchmark.tables, replacing the last tables.
+ */
+static void benchmarkBuildTables(Benchmark &benchmark) {
+	freeActivationTables(benchmark.tables);
+	buildActivationTables(benchmark.centers, benchmark.neuronCount, BENCHMARK_WIDTH, benchmark.normalizationConstants, benchmark.tables);
+}
+
+/*
+ * Calculates the network output, residuals and squared error like getOutputError, looking the activations up in benchmark.tables.
+ */
+static void benchmarkGetOutputTables(Benchmark &benchmark) {
+	benchmark.activations.tables = &benchmark.tables;
+	benchmarkGetOutputError(benchmark);
+	benchmark.activations.tables = NULL;
+}
+
+/*
+ * Calculates the network output, residuals and squared error from the activations the last getOutputError stored.
+ */
+static void benchmarkGetStoredOutputError(Benchmark &benchmark) {
+	getStoredOutputError(benchmark.activations, benchmark.weights, benchmark.train.target, benchmark.output, benchmark.residuals);
+}
+
+/*
+ * Applies one gradient descent weight update, using the activations and residuals of the last getOutputError.
+ */
+static void benchmarkTrain(Benchmark &benchmark) {
+	train(0.02, benchmark.residuals, benchmark.activations, benchmark.neuronCount, benchmark.weights, 1);
+}
+
+/*
+ * Calculates the error of the last getOutput.
+ */
+static void benchmarkCalculateError(Benchmark &benchmark) {
+	const DataSet &trainSet = benchmark.train;
+	calculateError(trainSet.target, benchmark.output, trainSet.count);
+}
+
+/*
+ * Loads the current network from BENCHMARK_MODEL into benchmark.model, replacing the last model.
+ */
+static void benchmarkLoadModel(Benchmark &benchmark) {
+	freeModel(benchmark.model);
+	if (!loadModel((char*) BENCHMARK_MODEL, MODEL_CUTOFF, benchmark.model)) {
+		printf("Could not load %s.\n", BENCHMARK_MODEL);
+		exit(1);
+	}
+}
+
+/*
+ * Predicts every hour of a year one at a time, as a caller serving single requests would.
+ */
+static void benchmarkPredictModel(Benchmark &benchmark) {
+	for (int dayOfYear = 1; dayOfYear <= 365; dayOfYear++) {
+		for (int hour = 0; hour < 24; hour++) {
+			benchmark.output[(dayOfYear - 1) * 24 + hour] = predictModel(benchmark.model, dayOfYear, hour, (dayOfYear - 1) % 7 + 1);
+		}
+	}
+}
+
+/*
+ * Compiles the current model into benchmark.predictionTable, replacing the last table.
+ */
+static void benchmarkCompileTable(Benchmark &benchmark) {
+	freePredictionTable(benchmark.predictionTable);
+	compilePredictionTable(benchmark.model, TABLE_QUANTIZED, benchmark.predictionTable);
+}
+
+/*
+ * Predicts every hour of a year one at a time from the compiled table.
+ */
+static void benchmarkPredictTable(Benchmark &benchmark) {
+	for (int dayOfYear = 1; dayOfYear <= 365; dayOfYear++) {
+		for (int hour = 0; hour < 24; hour++) {
+			benchmark.output[(dayOfYear - 1) * 24 + hour] = predictTable(benchmark.predictionTable, dayOfYear, hour, (dayOfYear - 1) % 7 + 1);
+		}
+	}
+}
+
+/*
+ * Runs a 2 x 2 sweep with the driver's defaults, training on the data set and scoring on it too.
+ */
+static void benchmarkSweep(Benchmark &benchmark) {
+	SweepSettings settings;
+	settings.countMin		   = 50;
+	settings.countStep		   = 50;
+	settings.countNum		   = 2;
+	settings.widthMin		   = 0.03;
+	settings.widthStep		   = 0.03;
+	settings.widthNum		   = 2;
+	settings.epochCount		   = 20;
+	settings.learningRate	   = 0.02;
+	settings.convergence.patience	 = 0;
+	settings.convergence.minDelta	 = 0;
+	settings.convergence.restoreBest = false;
+	settings.threadCount	   = 0;
+	settings.seed			   = BENCHMARK_SEED;
+	settings.warmStartClusters = true;
+	settings.kmeans			   = kmeans_04;
+	settings.clusterInitializer = INITIALIZE_FIRST_POINTS;
+	settings.trainingMode	   = TRAIN_GRADIENT_DESCENT;
+	settings.ridge			   = 1e-6;
+	settings.activationLayout  = ACTIVATIONS_SAMPLE_MAJOR;
+	settings.activationStorage = ACTIVATIONS_DOUBLE;
+	settings.activationTables  = false;
+	settings.trainThreads	   = 1;
+	settings.halvingEpochs	   = 0;
+	settings.halvingRate	   = 3;
+	settings.sparseCutoff	   = 0;
+	settings.compactData	   = true;
+	settings.modelFilename	   = NULL;
+	settings.normalizationConstants = benchmark.normalizationConstants;
+	settings.checkpointFilename = NULL;
+	settings.checkpointEpochs	= 0;
+
+	float optimisationResults[4];
+	runSweep(settings, benchmark.train, benchmark.train, benchmark.train, optimisationResults);
+}
+
+/*
+ * Writes the results as JSON, for tracking regressions between runs.
+ *
+ * Parameters:
+ * const Benchmark &benchmark - The results to write.
+ * const char *filename		  - The name of the file to write.
+ */
+static bool writeJson(const Benchmark &benchmark, const char *filename) {
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "{\n\t\"context\": {\n");
+	fprintf(file, "\t\t\"data\": \"%s\",\n", benchmark.csvFilename);
+	fprintf(file, "\t\t\"rows\": %d,\n", benchmark.train.count);
+	fprintf(file, "\t\t\"seed\": %d,\n", BENCHMARK_SEED);
+	fprintf(file, "\t\t\"activationKernel\": \"%s\",\n", activationKernelName(activationKernel()));
+	fprintf(file, "\t\t\"hardwareThreads\": %u\n", thread::hardware_concurrency());
+	fprintf(file, "\t},\n\t\"benchmarks\": [\n");
+	for (int i = 0; i < benchmark.resultCount; i++) {
+		const BenchmarkResult &result = benchmark.results[i];
+		fprintf(file, "\t\t{ \"name\": \"%s\", \"repeats\": %d, \"bestMs\": %.6f, \"meanMs\": %.6f",
+			result.name, result.repeats, result.bestSeconds * 1000, result.meanSeconds * 1000);
+		if (result.megabytes > 0) {
+			fprintf(file, ", \"megabytesPerSecond\": %.3f", result.megabytes / result.bestSeconds);
+		}
+		if (result.iterations > 0) {
+			fprintf(file, ", \"iterations\": %d", result.iterations);
+		}
+		fprintf(file, " }%s\n", i + 1 < benchmark.resultCount ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]) {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	const int	 neuronCounts[]			  = { 50, 200, 500 };
+	const int	 neuronCountNum			  = sizeof(neuronCounts) / sizeof(neuronCounts[0]);
+	const int	 maxNeuronCount			  = neuronCounts[neuronCountNum - 1];
+
+	// hmeans_01, kmeans_01 and kmeans_02 are much slower, so they only run once.
+	const KMeansRoutine kmeansRoutines[] = { hmeans_01,	  kmeans_01,   kmeans_02,	kmeans_03,	 kmeansMiniBatch,	kmeans_04 };
+	const char		   *kmeansNames[]	 = { "hmeans_01", "kmeans_01", "kmeans_02", "kmeans_03", "kmeansMiniBatch", "kmeans_04" };
+	const int			kmeansRepeats[]	 = { 1,			  1,		   1,			3,			 3,					3 };
+	const int			kmeansNum		 = sizeof(kmeansRoutines) / sizeof(kmeansRoutines[0]);
+
+	// Each initializer is timed together with the kmeans_04 run it seeds, which reports its iterations.
+	const char *initializerNames[] = { "cluster_initialize_1", "cluster_initialize_2", "cluster_initialize_3", "cluster_initialize_4",
+									   "cluster_initialize_5", "cluster_initialize_6", "cluster_initialize_7" };
+	const int	initializerNum	   = sizeof(initializerNames) / sizeof(initializerNames[0]);
+
+	Benchmark *benchmark = (Benchmark*) calloc(1, sizeof(Benchmark));
+	benchmark->csvFilename			  = (char*) "data/train.csv";
+	benchmark->binaryFilename		  = (char*) "data/train.bin";
+	benchmark->normalizationConstants = normalizationConstants;
+	const char *jsonFilename = NULL;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--json") == 0) {
+			jsonFilename = argv[i + 1];
+		} else if (strcmp(argv[i], "--filter") == 0) {
+			benchmark->filter = argv[i + 1];
+		} else if (strcmp(argv[i], "--data") == 0) {
+			benchmark->csvFilename = argv[i + 1];
+		} else {
+			printf("Unknown option %s.\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (!parseData(benchmark->csvFilename, normalizationConstants, benchmark->train)) {
+		return 1;
+	}
+	if (strcmp(benchmark->csvFilename, "data/train.csv") != 0) {
+		benchmark->binaryFilename = (char*) "benchmark.bin";
+	}
+	saveData(benchmark->binaryFilename, benchmark->csvFilename, normalizationConstants, benchmark->train);
+
+	benchmark->centers	 = (double*) malloc(sizeof(double) * maxNeuronCount * 3);
+	benchmark->weights	 = (double*) malloc(sizeof(double) * maxNeuronCount);
+	benchmark->output	 = (double*) malloc(sizeof(double) * benchmark->train.count);
+	benchmark->residuals = (double*) malloc(sizeof(double) * benchmark->train.count);
+	allocateActivationMatrix(benchmark->activations, ACTIVATIONS_DOUBLE, ACTIVATIONS_SAMPLE_MAJOR, benchmark->train.count, maxNeuronCount);
+
+	printf("%s, %d rows, %s kernel\n", benchmark->csvFilename, benchmark->train.count, activationKernelName(activationKernel()));
+	printf("%-36s %13s %13s\n", "Case", "Best", "Mean");
+
+	double megabytes = fileMegabytes(benchmark->csvFilename);
+	runCase(*benchmark, "load/loadData",  20, benchmarkLoadData,  megabytes);
+	runCase(*benchmark, "load/parseData", 20, benchmarkParseData, megabytes);
+	runCase(*benchmark, "load/mapData",	  20, benchmarkMapData,	  fileMegabytes(benchmark->binaryFilename));
+	runCase(*benchmark, "load/compactDataSet", 20, benchmarkCompactData, 0);
+
+	for (int i = 0; i < neuronCountNum; i++) {
+		char name[64];
+		benchmark->neuronCount = neuronCounts[i];
+		int seed = BENCHMARK_SEED;
+		randomMatrix(benchmark->weights, 1, benchmark->neuronCount, 1, &seed);
+
+		snprintf(name, sizeof(name), "kmeans/hmeans_03/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 1, benchmarkHmeans, 0);
+		snprintf(name, sizeof(name), "kmeans/clusterMiniBatch/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 3, benchmarkStreamKmeans, 0);
+		benchmark->kmeans = kmeans_04;
+		for (int j = 0; j < initializerNum; j++) {
+			snprintf(name, sizeof(name), "initialize/%s/%d", initializerNames[j], benchmark->neuronCount);
+			benchmark->initializer = (ClusterInitializer) j;
+			runCase(*benchmark, name, 1, benchmarkKmeans, 0);
+		}
+		benchmark->initializer = INITIALIZE_FIRST_POINTS;
+		for (int j = 0; j < kmeansNum; j++) {
+			snprintf(name, sizeof(name), "kmeans/%s/%d", kmeansNames[j], benchmark->neuronCount);
+			benchmark->kmeans = kmeansRoutines[j];
+			runCase(*benchmark, name, kmeansRepeats[j], benchmarkKmeans, 0);
+		}
+
+		// Later cases use the centers k-means leaves behind, so the last routine runs even when it isn't selected.
+		if (!selected(*benchmark, name)) {
+			benchmarkKmeans(*benchmark);
+		}
+
+		// The sparse forward pass uses the grid built from those centers.
+		benchmarkBuildGrid(*benchmark);
+		snprintf(name, sizeof(name), "forward/buildNeuronGrid/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkBuildGrid, 0);
+		snprintf(name, sizeof(name), "forward/getOutputSparse/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetOutputSparse, 0);
+
+		// Likewise train uses the residuals of getOutputError.
+		snprintf(name, sizeof(name), "forward/getOutput/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetOutput, 0);
+		benchmarkGetOutputError(*benchmark);
+		snprintf(name, sizeof(name), "forward/getOutputError/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetOutputError, 0);
+		snprintf(name, sizeof(name), "forward/getOutputErrorFast/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetOutputErrorFast, 0);
+		benchmarkGetOutputError(*benchmark);
+		snprintf(name, sizeof(name), "forward/getStoredOutputError/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetStoredOutputError, 0);
+		benchmarkBuildTables(*benchmark);
+		snprintf(name, sizeof(name), "forward/buildActivationTables/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkBuildTables, 0);
+		snprintf(name, sizeof(name), "forward/getOutputTables/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkGetOutputTables, 0);
+		snprintf(name, sizeof(name), "train/train/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkTrain, 0);
+
+		// Predictions use the network as it stands, saved and loaded as a model.
+		saveModel((char*) BENCHMARK_MODEL, normalizationConstants, benchmark->centers, benchmark->weights, benchmark->neuronCount, BENCHMARK_WIDTH);
+		benchmarkLoadModel(*benchmark);
+		snprintf(name, sizeof(name), "predict/loadModel/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkLoadModel, 0);
+		snprintf(name, sizeof(name), "predict/predictModel/%dx8760", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkPredictModel, 0);
+		benchmarkCompileTable(*benchmark);
+		snprintf(name, sizeof(name), "predict/compilePredictionTable/%d", benchmark->neuronCount);
+		runCase(*benchmark, name, 3, benchmarkCompileTable, 0);
+		snprintf(name, sizeof(name), "predict/predictTable/%dx8760", benchmark->neuronCount);
+		runCase(*benchmark, name, 10, benchmarkPredictTable, 0);
+	}
+	remove(BENCHMARK_MODEL);
+	runCase(*benchmark, "error/calculateError", 100, benchmarkCalculateError, 0);
+	runCase(*benchmark, "sweep/runSweep/2x2", 1, benchmarkSweep, 0);
+
+	if (jsonFilename != NULL && !writeJson(*benchmark, jsonFilename)) {
+		printf("Could not write %s.\n", jsonFilename);
+	}
+
+	freeActivationMatrix(benchmark->activations);
+	freeNeuronGrid(benchmark->grid);
+	freeActivationTables(benchmark->tables);
+	freeModel(benchmark->model);
+	freePredictionTable(benchmark->predictionTable);
+	freeDataSet(benchmark->train);
+	free(benchmark->centers);
+	free(benchmark->weights);
+	free(benchmark->output);
+	free(benchmark->residuals);
+	free(benchmark);
+	return 0;
+}
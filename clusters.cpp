@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "kmeans.hpp"
+#include "clusters.h"
+
+#define KMEANS_MAX_ITERATIONS	  500
+#define MINIBATCH_SIZE			  1024
+#define MINIBATCH_SEED			  1
+#define MINIBATCH_SMOOTHING		  0.1	// The weight of the newest batch in the smoothed movement.
+#define MINIBATCH_TOLERANCE		  1e-6
+#define MINIBATCH_REASSIGNMENT	  0.1	// Centers given less than this fraction of the busiest one's points are restarted.
+
+using namespace std;
+
+/*
+ * State shared between the threads clustering independent neuronCounts.
+ *
+ * Members:
+ * const DataSet *train			  - The data set to cluster.
+ * ClusterCache *cache			  - The cache being filled.
+ * KMeansRoutine kmeans			  - The k-means routine to cluster with.
+ * ClusterInitializer initializer - How the centers are seeded.
+ * int seed						  - The random number generator seed for the initializer.
+ * atomic<int> nextIndex		  - The next cache entry to be claimed.
+ */
+struct ClusterState {
+	const DataSet	  *train;
+	ClusterCache	  *cache;
+	KMeansRoutine	   kmeans;
+	ClusterInitializer initializer;
+	int				   seed;
+	atomic<int>		   nextIndex;
+};
+
+/*
+ * Seeds the cluster centers for k-means.
+ *
+ * Parameters:
+ * const DataSet &train			  - The data set to cluster.
+ * int neuronCount				  - The number of clusters.
+ * ClusterInitializer initializer - How the centers are seeded.
+ * int *seed					  - The random number generator state. Must be non-zero.
+ * double *clusterCenters		  - A preallocated matrix to hold the centers, size neuronCount x 3.
+ */
+void initializeCenters(const DataSet &train, int neuronCount, ClusterInitializer initializer, int *seed, double *clusterCenters) {
+	double *centers;
+	switch (initializer) {
+	case INITIALIZE_RANDOM_BOX:
+		centers = cluster_initialize_2(3, train.count, neuronCount, train.input, seed);
+		break;
+	case INITIALIZE_RANDOM_ASSIGNMENT:
+		centers = cluster_initialize_3(3, train.count, neuronCount, train.input, seed);
+		break;
+	case INITIALIZE_RANDOM_WEIGHTS:
+		centers = cluster_initialize_4(3, train.count, neuronCount, train.input, seed);
+		break;
+	case INITIALIZE_RANDOM_COMBINATION:
+		centers = cluster_initialize_5(3, train.count, neuronCount, train.input, seed);
+		break;
+	case INITIALIZE_KMEANS_PLUS_PLUS:
+		centers = cluster_initialize_6(3, train.count, neuronCount, train.input, seed);
+		break;
+	case INITIALIZE_KMEANS_PARALLEL:
+		centers = cluster_initialize_7(3, train.count, neuronCount, train.input, seed);
+		break;
+	default:
+		centers = cluster_initialize_1(3, train.count, neuronCount, train.input);
+		break;
+	}
+
+	for (int i = 0; i < neuronCount * 3; i++) {
+		clusterCenters[i] = centers[i];
+	}
+	delete[] centers;
+}
+
+/*
+ * Clusters each cache entry claimed from the queue from scratch.
+ *
+ * Parameters:
+ * ClusterState *state - The state shared between the threads.
+ */
+static void clusterWorker(ClusterState *state) {
+	const DataSet &train = *state->train;
+	ClusterCache  &cache = *state->cache;
+
+	int maxNeuronCount = cache.neuronCounts[cache.countNum - 1];
+	int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * train.count);
+	int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * maxNeuronCount);
+	double *clusterEnergies    = (double*) malloc(sizeof(double) * maxNeuronCount);
+
+	int countIndex;
+	while ((countIndex = state->nextIndex++) < cache.countNum) {
+		int neuronCount = cache.neuronCounts[countIndex];
+		int seed		= state->seed;
+		initializeCenters(train, neuronCount, state->initializer, &seed, cache.centers[countIndex]);
+		state->kmeans(3, train.count, neuronCount, KMEANS_MAX_ITERATIONS, cache.iterationCount[countIndex], train.input, clusterAllocations, cache.centers[countIndex], clusterPopulations, clusterEnergies);
+		printf("Count %d\tK-means converged in %d iterations.\n", neuronCount, cache.iterationCount[countIndex]);
+	}
+
+	free(clusterAllocations);
+	free(clusterPopulations);
+	free(clusterEnergies);
+}
+
+/*
+ * Clusters the cache entries in order, starting each from the solution for the previous entry.
+ *
+ * Parameters:
+ * const DataSet &train			  - The data set to cluster.
+ * KMeansRoutine kmeans			  - The k-means routine to cluster with.
+ * ClusterInitializer initializer - How the centers of the first entry are seeded.
+ * int seed						  - The random number generator seed for the initializer.
+ * int maxNeuronCount			  - The largest neuronCount in the cache.
+ * ClusterCache &cache			  - The cache to fill.
+ */
+static void clusterIncremental(const DataSet &train, KMeansRoutine kmeans, ClusterInitializer initializer, int seed, int maxNeuronCount, ClusterCache &cache) {
+	int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * train.count);
+	int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * maxNeuronCount);
+	double *clusterEnergies    = (double*) malloc(sizeof(double) * maxNeuronCount);
+
+	for (int countIndex = 0; countIndex < cache.countNum; countIndex++) {
+		int     neuronCount	   = cache.neuronCounts[countIndex];
+		double *clusterCenters = cache.centers[countIndex];
+
+		if (countIndex == 0) {
+			initializeCenters(train, neuronCount, initializer, &seed, clusterCenters);
+		} else {
+			// Keep the previous centers and split its highest energy clusters to make up the difference.
+			int previousCount = cache.neuronCounts[countIndex - 1];
+			for (int i = 0; i < previousCount * 3; i++) {
+				clusterCenters[i] = cache.centers[countIndex - 1][i];
+			}
+			cluster_split(3, train.count, previousCount, neuronCount - previousCount, train.input, clusterAllocations, clusterCenters, clusterEnergies);
+		}
+
+		kmeans(3, train.count, neuronCount, KMEANS_MAX_ITERATIONS, cache.iterationCount[countIndex], train.input, clusterAllocations, clusterCenters, clusterPopulations, clusterEnergies);
+		printf("Count %d\tK-means converged in %d iterations.\n", neuronCount, cache.iterationCount[countIndex]);
+	}
+
+	free(clusterAllocations);
+	free(clusterPopulations);
+	free(clusterEnergies);
+}
+
+/*
+ * Clusters the data points of a stream with mini-batch k-means. Each batch is batchSize points drawn
+ * at random from the stream, which move the centers as in kmeans_mini_batch. Clustering stops when
+ * the mean squared distance the centers move per point, smoothed over recent batches, falls below
+ * tolerance, or after batchMax batches. Only one batch is held in memory at a time, so memory doesn't
+ * depend on the size of the stream. Returns false if the stream can't be read.
+ *
+ * Parameters:
+ * DataStream &stream	  - The data points to cluster.
+ * int neuronCount		  - The number of clusters.
+ * int batchSize		  - The number of points in each batch.
+ * int batchMax			  - The maximum number of batches.
+ * double tolerance		  - The smoothed movement per point to stop at.
+ * int *seed			  - The random number generator state batches are drawn with. Must be non-zero.
+ * double *clusterCenters - On input, the initial centers. On output, the final centers. Size neuronCount x 3.
+ * int &batchCount		  - The number of batches taken.
+ */
+bool clusterMiniBatch(DataStream &stream, int neuronCount, int batchSize, int batchMax, double tolerance, int *seed, double *clusterCenters, int &batchCount) {
+	double *batch		 = (double*) malloc(sizeof(double) * batchSize * 3);
+	int	   *batchCluster = (int*)	 malloc(sizeof(int)	   * batchSize);
+	int	   *clusterCount = (int*)	 calloc(neuronCount, sizeof(int));
+
+	bool   read		= true;
+	double movement = -1;
+	for (batchCount = 0; batchCount < batchMax; ) {
+		read = readSample(stream, batchSize, seed, batch);
+		if (!read) {
+			break;
+		}
+		batchCount++;
+
+		double batchMovement = kmeans_mini_batch(3, batchSize, neuronCount, batch, batchCluster, clusterCenters, clusterCount) / batchSize;
+
+		// Mini-batches can't move a center nothing is near, so restart the centers that have been given
+		// far fewer points than the busiest one at random points of the batch.
+		int maxCount = 0, minCount = batchSize * batchCount;
+		for (int k = 0; k < neuronCount; k++) {
+			maxCount = clusterCount[k] > maxCount ? clusterCount[k] : maxCount;
+		}
+		for (int k = 0; k < neuronCount; k++) {
+			if (clusterCount[k] >= MINIBATCH_REASSIGNMENT * maxCount && clusterCount[k] < minCount) {
+				minCount = clusterCount[k];
+			}
+		}
+		for (int k = 0; k < neuronCount; k++) {
+			if (clusterCount[k] < MINIBATCH_REASSIGNMENT * maxCount) {
+				int j = i4_uniform(0, batchSize - 1, seed);
+				for (int i = 0; i < 3; i++) {
+					clusterCenters[k * 3 + i] = batch[j * 3 + i];
+				}
+				clusterCount[k] = minCount;
+			}
+		}
+		movement = movement < 0 ? batchMovement : (1 - MINIBATCH_SMOOTHING) * movement + MINIBATCH_SMOOTHING * batchMovement;
+		if (movement < tolerance) {
+			break;
+		}
+	}
+
+	free(batch);
+	free(batchCluster);
+	free(clusterCount);
+	return read;
+}
+
+/*
+ * A KMeansRoutine that runs clusterMiniBatch over the points in memory, with MINIBATCH_SIZE points per
+ * batch, at most it_max batches and a fixed seed, then assigns every point to its nearest center. It
+ * gives a coarser clustering than kmeans_04 in a time that doesn't grow with the number of points,
+ * apart from the final assignment. Only 3 dimensional points are supported.
+ */
+void kmeansMiniBatch(int dim_num, int point_num, int cluster_num, int it_max, int &it_num, double point[], int cluster[], double cluster_center[], int cluster_population[], double cluster_energy[]) {
+	DataStream stream;
+	openMemoryStream(point, point_num, stream);
+	int seed = MINIBATCH_SEED;
+	clusterMiniBatch(stream, cluster_num, MINIBATCH_SIZE, it_max, MINIBATCH_TOLERANCE, &seed, cluster_center, it_num);
+	closeDataStream(stream);
+
+	// Assign every point to its nearest center, for the populations and energies.
+	for (int k = 0; k < cluster_num; k++) {
+		cluster_population[k] = 0;
+		cluster_energy[k]	  = 0;
+	}
+	for (int j = 0; j < point_num; j++) {
+		double nearestDistance = r8_huge();
+		for (int k = 0; k < cluster_num; k++) {
+			double distance = 0;
+			for (int i = 0; i < dim_num; i++) {
+				double difference = point[j * dim_num + i] - cluster_center[k * dim_num + i];
+				distance += difference * difference;
+			}
+			if (distance < nearestDistance) {
+				nearestDistance = distance;
+				cluster[j]		= k;
+			}
+		}
+		cluster_population[cluster[j]]++;
+		cluster_energy[cluster[j]] += nearestDistance;
+	}
+}
+
+/*
+ * Clusters the training data once for each neuronCount in countMin:countStep and stores the centers.
+ *
+ * With warmStart, the counts are clustered in increasing order and each clustering starts from the
+ * previous solution, with the highest energy clusters split to make up the extra centers. This only
+ * leaves k-means a few local moves to make, but it has to run on a single thread. Without warmStart,
+ * every count is seeded by initializer and clustered independently on threadCount threads. Every
+ * count is seeded from the same seed, so the centers don't depend on the order the threads run in.
+ *
+ * Parameters:
+ * const DataSet &train			  - The data set to cluster.
+ * int countMin					  - The smallest neuronCount.
+ * int countStep				  - The step between neuronCounts. Must not exceed countMin when warm starting.
+ * int countNum					  - The number of neuronCounts.
+ * bool warmStart				  - Whether to grow each clustering from the previous one.
+ * int threadCount				  - The number of threads to cluster on when not warm starting.
+ * KMeansRoutine kmeans			  - The k-means routine to cluster with.
+ * ClusterInitializer initializer - How the centers are seeded. Only the first count is seeded when warm starting.
+ * int seed						  - The random number generator seed for the initializer. Must be non-zero.
+ * ClusterCache &cache			  - The cache to fill. Release it with freeClusterCache.
+ */
+void buildClusterCache(const DataSet &train, int countMin, int countStep, int countNum, bool warmStart, int threadCount, KMeansRoutine kmeans, ClusterInitializer initializer, int seed, ClusterCache &cache) {
+	cache.countNum		 = countNum;
+	cache.neuronCounts	 = (int*)	  malloc(sizeof(int)	 * countNum);
+	cache.centers		 = (double**) malloc(sizeof(double*) * countNum);
+	cache.iterationCount = (int*)	  malloc(sizeof(int)	 * countNum);
+	for (int countIndex = 0; countIndex < countNum; countIndex++) {
+		cache.neuronCounts[countIndex]	 = countMin + countIndex * countStep;
+		cache.centers[countIndex]		 = (double*) malloc(sizeof(double) * cache.neuronCounts[countIndex] * 3);
+		cache.iterationCount[countIndex] = 0;
+	}
+
+	if (warmStart) {
+		clusterIncremental(train, kmeans, initializer, seed, countMin + (countNum - 1) * countStep, cache);
+		return;
+	}
+
+	ClusterState state;
+	state.train		  = &train;
+	state.cache		  = &cache;
+	state.kmeans	  = kmeans;
+	state.initializer = initializer;
+	state.seed		  = seed;
+	state.nextIndex	  = 0;
+
+	if (threadCount > countNum) {
+		threadCount = countNum;
+	}
+	vector<thread> threads;
+	for (int i = 0; i < threadCount; i++) {
+		threads.push_back(thread(clusterWorker, &state));
+	}
+	for (int i = 0; i < threadCount; i++) {
+		threads[i].join();
+	}
+}
+
+/*
+ * Releases the memory held by a cluster cache.
+ *
+ * Parameters:
+ * ClusterCache &cache - The cache to release.
+ */
+void freeClusterCache(ClusterCache &cache) {
+	for (int countIndex = 0; countIndex < cache.countNum; countIndex++) {
+		free(cache.centers[countIndex]);
+	}
+	free(cache.neuronCounts);
+	free(cache.centers);
+	free(cache.iterationCount);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "io.h"
+
+/*
+ * A k-means routine. kmeans_01 to kmeans_04, hmeans_01 and kmeansMiniBatch all have this signature.
+ */
+typedef void (*KMeansRoutine)(int dim_num, int point_num, int cluster_num, int it_max, int &it_num, double point[], int cluster[], double cluster_center[], int cluster_population[], double cluster_energy[]);
+
+/*
+ * How the cluster centers are seeded before k-means is run, named after the routine that seeds them.
+ *
+ * INITIALIZE_FIRST_POINTS		 - The first data points, see cluster_initialize_1.
+ * INITIALIZE_RANDOM_BOX		 - Random points in the bounding box of the data, see cluster_initialize_2.
+ * INITIALIZE_RANDOM_ASSIGNMENT	 - The centroids of a random assignment of the data, see cluster_initialize_3.
+ * INITIALIZE_RANDOM_WEIGHTS	 - The centroids of random fractions of each data point, see cluster_initialize_4.
+ * INITIALIZE_RANDOM_COMBINATION - Random convex combinations of the data, see cluster_initialize_5.
+ * INITIALIZE_KMEANS_PLUS_PLUS	 - K-means++ seeding, see cluster_initialize_6.
+ * INITIALIZE_KMEANS_PARALLEL	 - K-means|| seeding, which takes a few passes over the data rather
+ *								   than one per center, see cluster_initialize_7.
+ */
+enum ClusterInitializer {
+	INITIALIZE_FIRST_POINTS,
+	INITIALIZE_RANDOM_BOX,
+	INITIALIZE_RANDOM_ASSIGNMENT,
+	INITIALIZE_RANDOM_WEIGHTS,
+	INITIALIZE_RANDOM_COMBINATION,
+	INITIALIZE_KMEANS_PLUS_PLUS,
+	INITIALIZE_KMEANS_PARALLEL
+};
+
+/*
+ * Seeds the cluster centers for k-means.
+ *
+ * Parameters:
+ * const DataSet &train			  - The data set to cluster.
+ * int neuronCount				  - The number of clusters.
+ * ClusterInitializer initializer - How the centers are seeded.
+ * int *seed					  - The random number generator state. Must be non-zero.
+ * double *clusterCenters		  - A preallocated matrix to hold the centers, size neuronCount x 3.
+ */
+void initializeCenters(const DataSet &train, int neuronCount, ClusterInitializer initializer, int *seed, double *clusterCenters);
+
+/*
+ * Clusters the data points of a stream with mini-batch k-means. Each batch is batchSize points drawn
+ * at random from the stream, which move the centers as in kmeans_mini_batch. Clustering stops when
+ * the mean squared distance the centers move per point, smoothed over recent batches, falls below
+ * tolerance, or after batchMax batches. Only one batch is held in memory at a time, so memory doesn't
+ * depend on the size of the stream. Returns false if the stream can't be read.
+ *
+ * Parameters:
+ * DataStream &stream	  - The data points to cluster.
+ * int neuronCount		  - The number of clusters.
+ * int batchSize		  - The number of points in each batch.
+ * int batchMax			  - The maximum number of batches.
+ * double tolerance		  - The smoothed movement per point to stop at.
+ * int *seed			  - The random number generator state batches are drawn with. Must be non-zero.
+ * double *clusterCenters - On input, the initial centers. On output, the final centers. Size neuronCount x 3.
+ * int &batchCount		  - The number of batches taken.
+ */
+bool clusterMiniBatch(DataStream &stream, int neuronCount, int batchSize, int batchMax, double tolerance, int *seed, double *clusterCenters, int &batchCount);
+
+/*
+ * A KMeansRoutine that runs clusterMiniBatch over the points in memory, with MINIBATCH_SIZE points per
+ * batch, at most it_max batches and a fixed seed, then assigns every point to its nearest center. It
+ * gives a coarser clustering than kmeans_04 in a time that doesn't grow with the number of points,
+ * apart from the final assignment. Only 3 dimensional points are supported.
+ */
+void kmeansMiniBatch(int dim_num, int point_num, int cluster_num, int it_max, int &it_num, double point[], int cluster[], double cluster_center[], int cluster_population[], double cluster_energy[]);
+
+/*
+ * The cluster centers for a range of neuronCounts, computed once and shared read-only between every
+ * network that uses them.
+ *
+ * Members:
+ * int countNum		   - The number of neuronCounts in the cache.
+ * int *neuronCounts   - The neuronCount of each entry. Length is countNum.
+ * double **centers	   - The cluster centers of each entry, size neuronCounts[i] x 3. Stride 3.
+ * int *iterationCount - The number of k-means iterations each entry took. Length is countNum.
+ */
+struct ClusterCache {
+	int		 countNum;
+	int		*neuronCounts;
+	double **centers;
+	int		*iterationCount;
+};
+
+/*
+ * Clusters the training data once for each neuronCount in countMin:countStep and stores the centers.
+ *
+ * With warmStart, the counts are clustered in increasing order and each clustering starts from the
+ * previous solution, with the highest energy clusters split to make up the extra centers. This only
+ * leaves k-means a few local moves to make, but it has to run on a single thread. Without warmStart,
+ * every count is seeded by initializer and clustered independently on threadCount threads. Every
+ * count is seeded from the same seed, so the centers don't depend on the order the threads run in.
+ *
+ * Parameters:
+ * const DataSet &train			  - The data set to cluster.
+ * int countMin					  - The smallest neuronCount.
+ * int countStep				  - The step between neuronCounts. Must not exceed countMin when warm starting.
+ * int countNum					  - The number of neuronCounts.
+ * bool warmStart				  - Whether to grow each clustering from the previous one.
+ * int threadCount				  - The number of threads to cluster on when not warm starting.
+ * KMeansRoutine kmeans			  - The k-means routine to cluster with.
+ * ClusterInitializer initializer - How the centers are seeded. Only the first count is seeded when warm starting.
+ * int seed						  - The random number generator seed for the initializer. Must be non-zero.
+ * ClusterCache &cache			  - The cache to fill. Release it with freeClusterCache.
+ */
+void buildClusterCache(const DataSet &train, int countMin, int countStep, int countNum, bool warmStart, int threadCount, KMeansRoutine kmeans, ClusterInitializer initializer, int seed, ClusterCache &cache);
+
+/*
+ * Releases the memory held by a cluster cache.
+ *
+ * Parameters:
+ * ClusterCache &cache - The cache to release.
+ */
+void freeClusterCache(ClusterCache &cache);
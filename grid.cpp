@@ -0,0 +1,190 @@
+#include <cmath>
+#include <stdlib.h>
+#include "activation.h"
+#include "grid.h"
+
+using namespace std;
+
+/*
+ * Adds the activations of neurons neuronBegin to neuronEnd to the running totals for an input point,
+ * like rbfForward, using a block of GRID_FORWARD_BLOCK activations on the stack.
+ *
+ * Parameters:
+ * const double *input		- One data point, which is an array of 3 values.
+ * const double *soaCenters - The centers in structure-of-arrays form, see centersToSoA.
+ * int neuronCount			- The total number of centers, which is the length of each coordinate array.
+ * int neuronBegin			- The first neuron to evaluate.
+ * int neuronEnd			- One past the last neuron to evaluate.
+ * double width				- The width of each RBF neuron.
+ * const double *weights	- The weight of each center, length neuronCount.
+ * double &activationSum	- The running sum of the point's activations.
+ * double &weightedSum		- The running sum of the point's activations multiplied by their weights.
+ */
+static void forwardBlocks(const double *input, const double *soaCenters, int neuronCount, int neuronBegin, int neuronEnd, double width, const double *weights, double &activationSum, double &weightedSum) {
+	double activations[GRID_FORWARD_BLOCK];
+	for (int blockBegin = neuronBegin; blockBegin < neuronEnd; blockBegin += GRID_FORWARD_BLOCK) {
+		int blockEnd = blockBegin + GRID_FORWARD_BLOCK < neuronEnd ? blockBegin + GRID_FORWARD_BLOCK : neuronEnd;
+		rbfForward(input, soaCenters, neuronCount, blockBegin, blockEnd, width, weights, activations, activationSum, weightedSum);
+	}
+}
+
+/*
+ * Buckets the centers of a network into a grid and lists the neurons that matter to each cell.
+ *
+ * Parameters:
+ * const double *centers - A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount		 - The number of centers.
+ * double width			 - The width of each RBF neuron.
+ * double cutoff		 - How many widths further than the nearest neuron one has to be to be left
+ *						   out, before allowing for the number of neurons. See NeuronGrid.
+ * NeuronGrid &grid		 - The grid to fill. Release it with freeNeuronGrid.
+ */
+void buildNeuronGrid(const double *centers, int neuronCount, double width, double cutoff, NeuronGrid &grid) {
+	grid.neuronCount = neuronCount;
+	grid.width		 = width;
+	grid.soaCenters	 = (double*) malloc(sizeof(double) * neuronCount * 3);
+	centersToSoA(centers, neuronCount, grid.soaCenters);
+
+	// Cover the unit cube and every center with cells about a width across.
+	for (int i = 0; i < 3; i++) {
+		double lower = 0, upper = 1;
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			lower = fmin(lower, centers[neuronIndex * 3 + i]);
+			upper = fmax(upper, centers[neuronIndex * 3 + i]);
+		}
+		double cells = ceil((upper - lower) / width);
+		grid.cellCount[i] = cells < GRID_MAX_CELLS ? (int) cells : GRID_MAX_CELLS;
+		grid.origin[i]	  = lower;
+		grid.cellSize[i]  = (upper - lower) / grid.cellCount[i];
+	}
+
+	// The distances from a cell to a center are sums over the dimensions, so tabulate each dimension's
+	// share of the closest and furthest squared distance from every slice of cells to every center.
+	double *closestShare[3], *furthestShare[3];
+	for (int i = 0; i < 3; i++) {
+		closestShare[i]	 = (double*) malloc(sizeof(double) * grid.cellCount[i] * neuronCount);
+		furthestShare[i] = (double*) malloc(sizeof(double) * grid.cellCount[i] * neuronCount);
+		for (int slice = 0; slice < grid.cellCount[i]; slice++) {
+			double lower = grid.origin[i] + slice * grid.cellSize[i], upper = lower + grid.cellSize[i];
+			for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+				double center = centers[neuronIndex * 3 + i];
+				double gap	  = fmax(fmax(lower - center, center - upper), 0);
+				double reach  = fmax(center - lower, upper - center);
+				closestShare[i][slice * neuronCount + neuronIndex]	= gap * gap;
+				furthestShare[i][slice * neuronCount + neuronIndex] = reach * reach;
+			}
+		}
+	}
+
+	int cellTotal = grid.cellCount[0] * grid.cellCount[1] * grid.cellCount[2];
+	int entryCapacity = neuronCount * 16;
+	double *closest = (double*) malloc(sizeof(double) * neuronCount);
+	grid.cellStart	  = (int*) malloc(sizeof(int) * (cellTotal + 1));
+	grid.entryNeurons = (int*) malloc(sizeof(int) * entryCapacity);
+	grid.entryCount	  = 0;
+
+	double margin = width * width * (cutoff * cutoff + 2 * log((double) neuronCount));
+	for (int cell = 0; cell < cellTotal; cell++) {
+		int x = cell % grid.cellCount[0], y = cell / grid.cellCount[0] % grid.cellCount[1], z = cell / (grid.cellCount[0] * grid.cellCount[1]);
+		const double *closestX	= closestShare[0]  + x * neuronCount, *closestY  = closestShare[1]  + y * neuronCount, *closestZ  = closestShare[2]  + z * neuronCount;
+		const double *furthestX = furthestShare[0] + x * neuronCount, *furthestY = furthestShare[1] + y * neuronCount, *furthestZ = furthestShare[2] + z * neuronCount;
+
+		// Find the closest any point of the cell can be to each center, and the furthest from the nearest one.
+		double nearestFurthest = HUGE_VAL;
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			closest[neuronIndex] = closestX[neuronIndex] + closestY[neuronIndex] + closestZ[neuronIndex];
+			double furthest = furthestX[neuronIndex] + furthestY[neuronIndex] + furthestZ[neuronIndex];
+			nearestFurthest = furthest < nearestFurthest ? furthest : nearestFurthest;
+		}
+
+		// List every neuron that could be within the margin of the nearest one.
+		grid.cellStart[cell] = grid.entryCount;
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			if (closest[neuronIndex] < nearestFurthest + margin) {
+				if (grid.entryCount == entryCapacity) {
+					entryCapacity *= 2;
+					grid.entryNeurons = (int*) realloc(grid.entryNeurons, sizeof(int) * entryCapacity);
+				}
+				grid.entryNeurons[grid.entryCount++] = neuronIndex;
+			}
+		}
+	}
+	grid.cellStart[cellTotal] = grid.entryCount;
+
+	// Lay the centers of the entries out so each cell's list can be evaluated several neurons at a time.
+	grid.soaEntries = (double*) malloc(sizeof(double) * grid.entryCount * 3);
+	for (int entry = 0; entry < grid.entryCount; entry++) {
+		for (int i = 0; i < 3; i++) {
+			grid.soaEntries[i * grid.entryCount + entry] = centers[grid.entryNeurons[entry] * 3 + i];
+		}
+	}
+
+	free(closest);
+	for (int i = 0; i < 3; i++) {
+		free(closestShare[i]);
+		free(furthestShare[i]);
+	}
+}
+
+/*
+ * Releases the memory held by a grid.
+ *
+ * Parameters:
+ * NeuronGrid &grid - The grid to release.
+ */
+void freeNeuronGrid(NeuronGrid &grid) {
+	free(grid.cellStart);
+	free(grid.entryNeurons);
+	free(grid.soaEntries);
+	free(grid.soaCenters);
+	grid.cellStart	  = NULL;
+	grid.entryNeurons = NULL;
+	grid.soaEntries	  = NULL;
+	grid.soaCenters	  = NULL;
+}
+
+/*
+ * Copies the weights of a network into the order of the grid's entries.
+ *
+ * Parameters:
+ * const NeuronGrid &grid - The grid.
+ * const double *weights  - The weight array for the network, length neuronCount.
+ * double *entryWeights	  - A preallocated array to hold the weight of each entry, length entryCount.
+ */
+void weightsToGrid(const NeuronGrid &grid, const double *weights, double *entryWeights) {
+	for (int entry = 0; entry < grid.entryCount; entry++) {
+		entryWeights[entry] = weights[grid.entryNeurons[entry]];
+	}
+}
+
+/*
+ * Calculates the activations of the neurons listed for the cell an input point is in, and adds their
+ * sum and weighted sum to the running totals for the point, like rbfForward. Inputs outside the grid
+ * are evaluated against every neuron. The activations are evaluated GRID_FORWARD_BLOCK at a time on
+ * the stack, so nothing is allocated and a grid can be shared between threads. Returns the number of
+ * neurons evaluated.
+ *
+ * Parameters:
+ * const NeuronGrid &grid	  - The grid.
+ * const double *input		  - One data point, which is an array of 3 values.
+ * const double *weights	  - The weight array for the network, length neuronCount.
+ * const double *entryWeights - The weights in the order of the grid's entries, see weightsToGrid.
+ * double &activationSum	  - The running sum of the point's activations.
+ * double &weightedSum		  - The running sum of the point's activations multiplied by their weights.
+ */
+int gridForward(const NeuronGrid &grid, const double *input, const double *weights, const double *entryWeights, double &activationSum, double &weightedSum) {
+	int cell = 0;
+	for (int i = 2; i >= 0; i--) {
+		double position = (input[i] - grid.origin[i]) / grid.cellSize[i];
+		if (!(position >= 0 && position <= grid.cellCount[i])) {
+			forwardBlocks(input, grid.soaCenters, grid.neuronCount, 0, grid.neuronCount, grid.width, weights, activationSum, weightedSum);
+			return grid.neuronCount;
+		}
+		int index = position < grid.cellCount[i] ? (int) position : grid.cellCount[i] - 1;
+		cell = cell * grid.cellCount[i] + index;
+	}
+
+	int entryBegin = grid.cellStart[cell], entryEnd = grid.cellStart[cell + 1];
+	forwardBlocks(input, grid.soaEntries, grid.entryCount, entryBegin, entryEnd, grid.width, entryWeights, activationSum, weightedSum);
+	return entryEnd - entryBegin;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// The most cells along each dimension of a grid. Cells are otherwise a width across.
+#define GRID_MAX_CELLS 32
+
+// The number of activations gridForward evaluates at a time.
+#define GRID_FORWARD_BLOCK 64
+
+/*
+ * The centers of a network bucketed into a uniform grid over (dayOfYear, hour, dayOfWeek), so that
+ * only the neurons near an input need to be evaluated. Each cell keeps its own list of the neurons
+ * that can matter to an input anywhere in it. The grid covers the centers and the unit cube the
+ * inputs are normalized into.
+ *
+ * The list of a cell is chosen so that, for any input in the cell, the activations of the neurons
+ * left out add up to at most epsilon = exp(-cutoff^2 / 2) of the activations of the ones kept.
+ * Let U be the smallest distance within which some neuron is of every point of the cell, so that
+ * neuron's activation is at least exp(-U^2 / (2 * width^2)) anywhere in the cell. A neuron is left
+ * out if every point of the cell is at least sqrt(U^2 + width^2 * (cutoff^2 + 2 * ln(neuronCount)))
+ * from it, so each one left out has an activation below epsilon / neuronCount of that.
+ *
+ * If the neurons left out have activations a_i and weights w_i, and the ones kept have an
+ * activation sum S, the output moves by at most (|sum a_i w_i| + |output| sum a_i) / S. Since
+ * |output| never exceeds max|w|, every output is within 2 * epsilon * max|w| of the dense one.
+ *
+ * Members:
+ * int neuronCount	  - The number of neurons in the network.
+ * double width		  - The width of each RBF neuron.
+ * double origin[3]	  - The corner of the first cell.
+ * double cellSize[3] - The size of a cell along each dimension.
+ * int cellCount[3]	  - The number of cells along each dimension.
+ * int *cellStart	  - The first entry of each cell's list, with the first dimension varying fastest,
+ *						followed by the entryCount. Length is cellCount[0] x cellCount[1] x cellCount[2] + 1.
+ * int entryCount	  - The total length of the lists.
+ * int *entryNeurons  - The index in the network of the neuron in each entry. Length is entryCount.
+ * double *soaEntries - The center of each entry, in structure-of-arrays form. See centersToSoA.
+ * double *soaCenters - Every center in network order, in structure-of-arrays form, for inputs
+ *						outside the grid.
+ */
+struct NeuronGrid {
+	int		neuronCount;
+	double	width;
+	double	origin[3];
+	double	cellSize[3];
+	int		cellCount[3];
+	int	   *cellStart;
+	int		entryCount;
+	int	   *entryNeurons;
+	double *soaEntries;
+	double *soaCenters;
+};
+
+/*
+ * Buckets the centers of a network into a grid and lists the neurons that matter to each cell.
+ *
+ * Parameters:
+ * const double *centers - A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount		 - The number of centers.
+ * double width			 - The width of each RBF neuron.
+ * double cutoff		 - How many widths further than the nearest neuron one has to be to be left
+ *						   out, before allowing for the number of neurons. See NeuronGrid.
+ * NeuronGrid &grid		 - The grid to fill. Release it with freeNeuronGrid.
+ */
+void buildNeuronGrid(const double *centers, int neuronCount, double width, double cutoff, NeuronGrid &grid);
+
+/*
+ * Releases the memory held by a grid.
+ *
+ * Parameters:
+ * NeuronGrid &grid - The grid to release.
+ */
+void freeNeuronGrid(NeuronGrid &grid);
+
+/*
+ * Copies the weights of a network into the order of the grid's entries.
+ *
+ * Parameters:
+ * const NeuronGrid &grid - The grid.
+ * const double *weights  - The weight array for the network, length neuronCount.
+ * double *entryWeights	  - A preallocated array to hold the weight of each entry, length entryCount.
+ */
+void weightsToGrid(const NeuronGrid &grid, const double *weights, double *entryWeights);
+
+/*
+ * Calculates the activations of the neurons listed for the cell an input point is in, and adds their
+ * sum and weighted sum to the running totals for the point, like rbfForward. Inputs outside the grid
+ * are evaluated against every neuron. The activations are evaluated GRID_FORWARD_BLOCK at a time on
+ * the stack, so nothing is allocated and a grid can be shared between threads. Returns the number of
+ * neurons evaluated.
+ *
+ * Parameters:
+ * const NeuronGrid &grid	  - The grid.
+ * const double *input		  - One data point, which is an array of 3 values.
+ * const double *weights	  - The weight array for the network, length neuronCount.
+ * const double *entryWeights - The weights in the order of the grid's entries, see weightsToGrid.
+ * double &activationSum	  - The running sum of the point's activations.
+ * double &weightedSum		  - The running sum of the point's activations multiplied by their weights.
+ */
+int gridForward(const NeuronGrid &grid, const double *input, const double *weights, const double *entryWeights, double &activationSum, double &weightedSum);
@@ -2,9 +2,181 @@
 #include <sstream>
 #include <string>
 #include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "kmeans.hpp"
+#include "io.h"
+
+// The binary data format. Bump the version whenever the layout changes so old files are rebuilt.
+#define DATA_MAGIC		 "RBFDATA"
+#define DATA_VERSION	 2
+#define DATA_COLUMNS	 3
+#define DATA_HEADER_SIZE 128
+#define DATA_ALIGNMENT	 64
+
+// The CSV parser's read size, which is also the longest line it accepts, and its first row capacity.
+#define PARSE_BLOCK_SIZE	 (1 << 20)
+#define PARSE_INITIAL_ROWS 4096
+
+// A file stream samples from this many blocks of consecutive rows held in memory, replacing one every
+// block's worth of draws. 256 blocks of 64 rows is 384KB, however large the file.
+#define STREAM_BLOCK_ROWS	64
+#define STREAM_BUFFER_BLOCKS 256
 
 using namespace std;
 
+/*
+ * The header at the start of a binary data file. See saveData.
+ *
+ * Members:
+ * char magic[8]					- DATA_MAGIC, null terminated.
+ * uint32_t version					- DATA_VERSION.
+ * uint32_t rowCount				- The number of data points.
+ * uint32_t columnCount				- The number of input values per data point, DATA_COLUMNS.
+ * uint32_t reserved				- Zero.
+ * double normalizationConstants[3]	- The constants the inputs were normalized with.
+ * uint64_t inputOffset				- The position of the input block from the start of the file.
+ * uint64_t targetOffset			- The position of the target block from the start of the file.
+ * uint64_t checksum				- The checksum of the input block followed by the target block.
+ * uint64_t sourceSize				- The size of the CSV file the data was converted from, or 0.
+ * int64_t sourceTime				- The modification time of the CSV file, or 0.
+ */
+struct DataHeader {
+	char	 magic[8];
+	uint32_t version;
+	uint32_t rowCount;
+	uint32_t columnCount;
+	uint32_t reserved;
+	double	 normalizationConstants[DATA_COLUMNS];
+	uint64_t inputOffset;
+	uint64_t targetOffset;
+	uint64_t checksum;
+	uint64_t sourceSize;
+	int64_t	 sourceTime;
+};
+
+/*
+ * Moves to an offset in a file, which may be beyond 2GB. Returns false on failure.
+ *
+ * Parameters:
+ * FILE *file		- The file to seek in.
+ * long long offset - The offset to move to.
+ * int origin		- SEEK_SET, SEEK_CUR or SEEK_END, as for fseek.
+ */
+static bool seekFile(FILE *file, long long offset, int origin) {
+#ifdef _WIN32
+	return _fseeki64(file, offset, origin) == 0;
+#else
+	return fseeko(file, (off_t) offset, origin) == 0;
+#endif
+}
+
+/*
+ * Returns the current offset in a file, which may be beyond 2GB.
+ *
+ * Parameters:
+ * FILE *file - The file.
+ */
+static long long tellFile(FILE *file) {
+#ifdef _WIN32
+	return _ftelli64(file);
+#else
+	return (long long) ftello(file);
+#endif
+}
+
+/*
+ * Reads the size and modification time of a file, which a binary data file records of the CSV file it
+ * was converted from. Returns false if the file can't be found.
+ *
+ * Parameters:
+ * const char *filename - The name of the file.
+ * uint64_t &size		- Set to the size of the file.
+ * int64_t &time		- Set to the modification time of the file.
+ */
+static bool fileStamp(const char *filename, uint64_t &size, int64_t &time) {
+	struct stat fileStat;
+	if (stat(filename, &fileStat) != 0) {
+		return false;
+	}
+	size = (uint64_t) fileStat.st_size;
+	time = (int64_t) fileStat.st_mtime;
+	return true;
+}
+
+/*
+ * Returns whether the blocks a data file's header describes are aligned, in order and inside a file
+ * of the given size. Each offset and length is checked against the size on its own, so a corrupt
+ * header can't wrap the sums around.
+ *
+ * Parameters:
+ * const DataHeader &header - The header.
+ * uint64_t size			- The size of the file.
+ */
+static bool blocksFit(const DataHeader &header, uint64_t size) {
+	uint64_t inputBytes	 = sizeof(double) * DATA_COLUMNS * (uint64_t) header.rowCount;
+	uint64_t targetBytes = sizeof(double) * (uint64_t) header.rowCount;
+	return header.inputOffset % DATA_ALIGNMENT == 0 && header.targetOffset % DATA_ALIGNMENT == 0
+		&& header.inputOffset <= size && inputBytes <= size - header.inputOffset
+		&& header.targetOffset <= size && targetBytes <= size - header.targetOffset
+		&& header.inputOffset <= header.targetOffset && inputBytes <= header.targetOffset - header.inputOffset;
+}
+
+/*
+ * Continues a 64-bit FNV-1a checksum over an array of doubles, a whole value at a time.
+ *
+ * Parameters:
+ * uint64_t hash		- The checksum so far. Start with 14695981039346656037.
+ * const double *values - The values to add.
+ * size_t count			- The number of values.
+ */
+uint64_t checksum(uint64_t hash, const double *values, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		uint64_t bits;
+		memcpy(&bits, values + i, sizeof(bits));
+		hash ^= bits;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/*
+ * Continues a 64-bit FNV-1a checksum over a block of memory, a byte at a time.
+ *
+ * Parameters:
+ * uint64_t hash	- The checksum so far. Start with 14695981039346656037.
+ * const void *data - The bytes to add.
+ * size_t size		- The number of bytes.
+ */
+uint64_t checksumBytes(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char*) data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/*
+ * Rounds a file offset up to the next multiple of DATA_ALIGNMENT.
+ *
+ * Parameters:
+ * uint64_t offset - The offset to round.
+ */
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+}
+
 /*
 * Returns the number of lines in the file specified by filename.
 *
@@ -69,19 +241,615 @@ void loadData(char *filename, const double *normalizationConstants, double *resu
 	}
 }
 
+/*
+ * Parses one CSV row of integers in place. Returns the number of fields read, or -1 if a field isn't
+ * an integer or there are more than fieldCount of them.
+ *
+ * Parameters:
+ * const char *line	 - The start of the row.
+ * const char *end	 - The end of the row, excluding the line ending.
+ * int *fields		 - A preallocated array to hold the fields.
+ * int fieldCount	 - The most fields the row may hold.
+ */
+static int parseRow(const char *line, const char *end, int *fields, int fieldCount) {
+	int count = 0;
+	while (true) {
+		bool negative = line < end && *line == '-';
+		if (negative) {
+			line++;
+		}
+
+		// Read at most 9 digits so the value can't overflow. A 10th digit then fails the ',' check below.
+		int value = 0, digits = 0;
+		while (line < end && *line >= '0' && *line <= '9' && digits < 9) {
+			value = value * 10 + (*line++ - '0');
+			digits++;
+		}
+		if (digits == 0 || count == fieldCount) {
+			return -1;
+		}
+		fields[count++] = negative ? -value : value;
+
+		if (line == end) {
+			return count;
+		}
+		if (*line++ != ',') {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Loads a CSV data file of dayOfYear,hour,dayOfWeek,target rows into a data set in a single pass,
+ * normalizing the inputs as it goes. The file is read in large blocks and the integers are parsed
+ * in place, and the arrays are grown as rows are read, so the file doesn't need counting first.
+ * Blank lines are skipped. Returns false, reporting the line number of the first malformed row to
+ * stderr, if any row doesn't hold exactly 4 integer fields.
+ *
+ * Parameters:
+ * char *filename						- The name of the file to load from.
+ * const double *normalizationConstants	- Constants used to normalize the input data, length 3.
+ * DataSet &dataSet						- The data set to fill. Release it with freeDataSet.
+ */
+bool parseData(char *filename, const double *normalizationConstants, DataSet &dataSet) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "%s: could not open file\n", filename);
+		return false;
+	}
+
+	int		capacity = PARSE_INITIAL_ROWS, count = 0;
+	double *input	 = (double*) malloc(sizeof(double) * capacity * DATA_COLUMNS);
+	double *target	 = (double*) malloc(sizeof(double) * capacity);
+	char   *buffer	 = (char*)	 malloc(PARSE_BLOCK_SIZE);
+
+	// Each block is parsed up to its last complete line, and the partial line is moved to the front
+	// of the buffer to be completed by the next read.
+	int	   lineNumber = 1;
+	size_t carried	  = 0;
+	bool   valid	  = true, endOfFile = false;
+	while (valid && !endOfFile) {
+		size_t size = carried + fread(buffer + carried, 1, PARSE_BLOCK_SIZE - carried, file);
+		endOfFile = size < PARSE_BLOCK_SIZE;
+
+		const char *line = buffer, *bufferEnd = buffer + size;
+		while (valid) {
+			const char *lineEnd = (const char*) memchr(line, '\n', bufferEnd - line);
+			if (lineEnd == NULL) {
+				if (!endOfFile || line == bufferEnd) {
+					break;
+				}
+				lineEnd = bufferEnd;	// The last line has no line ending.
+			}
+
+			const char *fieldsEnd = lineEnd > line && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+			if (fieldsEnd > line) {
+				int fields[DATA_COLUMNS + 1];
+				if (parseRow(line, fieldsEnd, fields, DATA_COLUMNS + 1) != DATA_COLUMNS + 1) {
+					fprintf(stderr, "%s:%d: expected %d comma separated integers\n", filename, lineNumber, DATA_COLUMNS + 1);
+					valid = false;
+					break;
+				}
+
+				if (count == capacity) {
+					capacity *= 2;
+					input  = (double*) realloc(input,  sizeof(double) * capacity * DATA_COLUMNS);
+					target = (double*) realloc(target, sizeof(double) * capacity);
+				}
+				for (int column = 0; column < DATA_COLUMNS; column++) {
+					input[count * DATA_COLUMNS + column] = fields[column] / normalizationConstants[column];
+				}
+				target[count++] = fields[DATA_COLUMNS];
+			}
+
+			lineNumber++;
+			line = lineEnd < bufferEnd ? lineEnd + 1 : bufferEnd;
+		}
+
+		carried = bufferEnd - line;
+		if (valid && carried == PARSE_BLOCK_SIZE) {
+			fprintf(stderr, "%s:%d: line is longer than %d bytes\n", filename, lineNumber, PARSE_BLOCK_SIZE);
+			valid = false;
+		}
+		memmove(buffer, line, carried);
+	}
+
+	free(buffer);
+	fclose(file);
+	if (!valid) {
+		free(input);
+		free(target);
+		return false;
+	}
+
+	dataSet.input		 = input;
+	dataSet.target		 = target;
+	dataSet.count		 = count;
+	dataSet.mapping		 = NULL;
+	dataSet.mappingSize	 = 0;
+	dataSet.weight		 = NULL;
+	dataSet.rowCount	 = count;
+	dataSet.targetSpread = 0;
+	return true;
+}
+
+/*
+ * A row of a data set and its position, so rows with identical inputs can be sorted next to each other.
+ *
+ * Members:
+ * double input[3] - The row's input.
+ * int index	   - The position of the row in the data set.
+ */
+struct CompactRow {
+	double input[3];
+	int	   index;
+};
+
+/*
+ * Orders rows by their inputs, and rows with identical inputs by their position. For qsort.
+ *
+ * Parameters:
+ * const void *a - The first CompactRow.
+ * const void *b - The second CompactRow.
+ */
+static int compareRows(const void *a, const void *b) {
+	const CompactRow *rowA = (const CompactRow*) a, *rowB = (const CompactRow*) b;
+	for (int i = 0; i < 3; i++) {
+		if (rowA->input[i] != rowB->input[i]) {
+			return rowA->input[i] < rowB->input[i] ? -1 : 1;
+		}
+	}
+	return rowA->index - rowB->index;
+}
+
+/*
+ * Copies a data set with the rows that have identical inputs merged into single weighted data points,
+ * see DataSet. The data points keep the order of each input's first row. Returns the number of rows
+ * merged away; if there are none compact is left unset, so a data set never carries weights it doesn't
+ * need. The compacted data points aren't a substitute for the rows when clustering, as the k-means
+ * routines would count each of them once.
+ *
+ * Parameters:
+ * const DataSet &dataSet - The data set to compact.
+ * DataSet &compact		  - The data set to fill with the compacted copy. Release it with freeDataSet.
+ */
+int compactDataSet(const DataSet &dataSet, DataSet &compact) {
+	if (dataSet.weight != NULL) {
+		return 0;
+	}
+
+	// Sort the rows so identical inputs are adjacent, and point every row at the first row of its input.
+	int count = dataSet.count;
+	CompactRow *rows  = (CompactRow*) malloc(sizeof(CompactRow) * count);
+	int		   *first = (int*)		  malloc(sizeof(int)		* count);
+	for (int dataIndex = 0; dataIndex < count; dataIndex++) {
+		memcpy(rows[dataIndex].input, dataSet.input + dataIndex * 3, sizeof(rows[dataIndex].input));
+		rows[dataIndex].index = dataIndex;
+	}
+	qsort(rows, count, sizeof(CompactRow), compareRows);
+
+	int distinctCount = 0;
+	for (int sortedIndex = 0; sortedIndex < count; sortedIndex++) {
+		bool repeat = sortedIndex > 0 && memcmp(rows[sortedIndex - 1].input, rows[sortedIndex].input, sizeof(rows[sortedIndex].input)) == 0;
+		first[rows[sortedIndex].index] = repeat ? first[rows[sortedIndex - 1].index] : rows[sortedIndex].index;
+		distinctCount += !repeat;
+	}
+	free(rows);
+
+	if (distinctCount == count) {
+		free(first);
+		return 0;
+	}
+
+	// Number the first rows in order, then sum each data point's rows into it.
+	double *input  = (double*) malloc(sizeof(double) * distinctCount * 3);
+	double *target = (double*) calloc(distinctCount, sizeof(double));
+	double *weight = (double*) calloc(distinctCount, sizeof(double));
+	int	   *point  = (int*)	   malloc(sizeof(int)	 * count);
+	int pointCount = 0;
+	for (int dataIndex = 0; dataIndex < count; dataIndex++) {
+		if (first[dataIndex] == dataIndex) {
+			memcpy(input + pointCount * 3, dataSet.input + dataIndex * 3, sizeof(double) * 3);
+			point[dataIndex] = pointCount++;
+		} else {
+			point[dataIndex] = point[first[dataIndex]];
+		}
+		target[point[dataIndex]] += dataSet.target[dataIndex];
+		weight[point[dataIndex]] += 1;
+	}
+
+	// The spread is taken about each mean, rather than from the sum of squares, so it doesn't cancel.
+	double targetSpread = 0;
+	for (int dataIndex = 0; dataIndex < count; dataIndex++) {
+		double deviation = dataSet.target[dataIndex] - target[point[dataIndex]] / weight[point[dataIndex]];
+		targetSpread += deviation * deviation;
+	}
+	free(first);
+	free(point);
+
+	compact.input		 = input;
+	compact.target		 = target;
+	compact.count		 = distinctCount;
+	compact.mapping		 = NULL;
+	compact.mappingSize	 = 0;
+	compact.weight		 = weight;
+	compact.rowCount	 = count;
+	compact.targetSpread = targetSpread;
+	return count - distinctCount;
+}
+
+/*
+ * Saves a data set in the binary format read by mapData. Returns false if the file can't be written.
+ *
+ * The binary file is a 128 byte header followed by two blocks, each aligned to 64 bytes:
+ * the normalized inputs as rowCount x 3 doubles with stride 3, and then the rowCount target doubles.
+ * The header holds the magic "RBFDATA", a format version, the row count, the column count, the
+ * normalization constants, the offsets of both blocks, a 64-bit FNV-1a checksum of their contents, and
+ * the size and modification time of the CSV file the data came from. Values are written in the
+ * machine's native byte order. The format has no weights, so a compacted data set can't be saved.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file to write, replacing any previous one.
+ * char *csvFilename					- The CSV file the data set was parsed from, which mapData checks the
+ *										  binary file is still up to date with. NULL if there isn't one.
+ * const double *normalizationConstants	- The constants the data set's inputs were normalized with, length 3.
+ * const DataSet &dataSet				- The data set to save.
+ */
+bool saveData(char *filename, char *csvFilename, const double *normalizationConstants, const DataSet &dataSet) {
+	if (dataSet.weight != NULL) {
+		return false;
+	}
+
+	int			  rowCount = dataSet.count;
+	const double *input	   = dataSet.input;
+	const double *target   = dataSet.target;
+
+	DataHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, DATA_MAGIC);
+	header.version		= DATA_VERSION;
+	header.rowCount		= rowCount;
+	header.columnCount	= DATA_COLUMNS;
+	header.inputOffset	= DATA_HEADER_SIZE;
+	header.targetOffset = alignOffset(header.inputOffset + sizeof(double) * rowCount * DATA_COLUMNS);
+	header.checksum		= checksum(checksum(14695981039346656037ull, input, (size_t) rowCount * DATA_COLUMNS), target, rowCount);
+	memcpy(header.normalizationConstants, normalizationConstants, sizeof(header.normalizationConstants));
+	if (csvFilename != NULL) {
+		fileStamp(csvFilename, header.sourceSize, header.sourceTime);
+	}
+
+	// Write the header and both blocks, zero padding up to each block's offset.
+	char   padding[DATA_HEADER_SIZE] = { 0 };
+	size_t inputPadding				 = header.targetOffset - header.inputOffset - sizeof(double) * rowCount * DATA_COLUMNS;
+	FILE  *file						 = fopen(filename, "wb");
+	bool written = file != NULL
+		&& fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(padding, 1, DATA_HEADER_SIZE - sizeof(header), file) == DATA_HEADER_SIZE - sizeof(header)
+		&& fwrite(input, sizeof(double) * DATA_COLUMNS, rowCount, file) == (size_t) rowCount
+		&& fwrite(padding, 1, inputPadding, file) == inputPadding
+		&& fwrite(target, sizeof(double), rowCount, file) == (size_t) rowCount;
+	if (file != NULL && fclose(file) != 0) {
+		written = false;
+	}
+	return written;
+}
+
+/*
+ * Converts a CSV data file into the binary format read by mapData, normalizing the inputs on the way.
+ * Returns false if the CSV file is malformed or the binary file can't be written.
+ *
+ * Parameters:
+ * char *csvFilename					- The name of the CSV file to convert.
+ * char *binaryFilename					- The name of the binary file to write, replacing any previous one.
+ * const double *normalizationConstants	- Constants used to normalize the input data, length 3.
+ */
+bool convertToBinary(char *csvFilename, char *binaryFilename, const double *normalizationConstants) {
+	DataSet dataSet;
+	if (!parseData(csvFilename, normalizationConstants, dataSet)) {
+		return false;
+	}
+	bool written = saveData(binaryFilename, csvFilename, normalizationConstants, dataSet);
+	freeDataSet(dataSet);
+	return written;
+}
+
+/*
+ * Maps a binary data file written by saveData into memory and points a data set at it, so
+ * the data is used in place rather than parsed or copied. Returns false, leaving the data set
+ * unchanged, if the file is missing, truncated, has a different version or normalization constants,
+ * fails its checksum, or is out of date with its CSV file. The mapping is copy-on-write, so the data
+ * set can be modified without changing the file.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file.
+ * char *csvFilename					- The CSV file the binary file was converted from. If its size or
+ *										  modification time differ from those saveData recorded, the binary
+ *										  file is out of date. NULL, or a CSV file that's missing, isn't checked.
+ * const double *normalizationConstants	- The normalization constants the file must have been written with.
+ * DataSet &dataSet						- The data set to fill. Release it with freeDataSet.
+ */
+bool mapData(char *filename, char *csvFilename, const double *normalizationConstants, DataSet &dataSet) {
+	void  *mapping = NULL;
+	size_t size	   = 0;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= DATA_HEADER_SIZE) {
+		size = (size_t) fileSize.QuadPart;
+		HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (fileMapping != NULL) {
+			mapping = MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, 0);
+			CloseHandle(fileMapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	int file = open(filename, O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size >= DATA_HEADER_SIZE) {
+		size	= (size_t) fileStat.st_size;
+		mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		if (mapping == MAP_FAILED) {
+			mapping = NULL;
+		}
+	}
+	close(file);
+#endif
+	if (mapping == NULL) {
+		return false;
+	}
+
+	// Check the header describes this format and these constants, and that both blocks fit in the file.
+	const DataHeader *header = (const DataHeader*) mapping;
+	bool valid = memcmp(header->magic, DATA_MAGIC, sizeof(DATA_MAGIC)) == 0
+		&& header->version == DATA_VERSION
+		&& header->columnCount == DATA_COLUMNS
+		&& memcmp(header->normalizationConstants, normalizationConstants, sizeof(header->normalizationConstants)) == 0
+		&& blocksFit(*header, size);
+
+	// And that the CSV file hasn't changed since it was converted.
+	uint64_t sourceSize;
+	int64_t	 sourceTime;
+	if (valid && csvFilename != NULL && fileStamp(csvFilename, sourceSize, sourceTime)) {
+		valid = header->sourceSize == sourceSize && header->sourceTime == sourceTime;
+	}
+
+	const double *input	 = (const double*) ((const char*) mapping + (valid ? header->inputOffset : 0));
+	const double *target = (const double*) ((const char*) mapping + (valid ? header->targetOffset : 0));
+	valid = valid && header->checksum == checksum(checksum(14695981039346656037ull, input, (size_t) header->rowCount * DATA_COLUMNS), target, header->rowCount);
+
+	if (!valid) {
+		DataSet invalid = { NULL, NULL, 0, mapping, size, NULL, 0, 0 };
+		freeDataSet(invalid);
+		return false;
+	}
+
+	dataSet.input		 = (double*) input;
+	dataSet.target		 = (double*) target;
+	dataSet.count		 = header->rowCount;
+	dataSet.mapping		 = mapping;
+	dataSet.mappingSize	 = size;
+	dataSet.weight		 = NULL;
+	dataSet.rowCount	 = header->rowCount;
+	dataSet.targetSpread = 0;
+	return true;
+}
+
+/*
+ * Releases a data set, unmapping it if it came from mapData and freeing its arrays otherwise.
+ *
+ * Parameters:
+ * DataSet &dataSet - The data set to release.
+ */
+void freeDataSet(DataSet &dataSet) {
+	if (dataSet.mapping != NULL) {
+#ifdef _WIN32
+		UnmapViewOfFile(dataSet.mapping);
+#else
+		munmap(dataSet.mapping, dataSet.mappingSize);
+#endif
+	} else {
+		free(dataSet.input);
+		free(dataSet.target);
+	}
+	free(dataSet.weight);
+	dataSet.input	 = NULL;
+	dataSet.target	 = NULL;
+	dataSet.count	 = 0;
+	dataSet.mapping	 = NULL;
+	dataSet.weight	 = NULL;
+	dataSet.rowCount = 0;
+}
+
+/*
+ * Opens a binary data file written by saveData for reading on demand. Returns false if the file is
+ * missing, truncated, or has a different version or normalization constants. Only the header is
+ * read, so unlike mapData the checksum isn't verified.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file.
+ * const double *normalizationConstants	- The normalization constants the file must have been written with.
+ * DataStream &stream					- The stream to open. Release it with closeDataStream.
+ */
+bool openDataStream(char *filename, const double *normalizationConstants, DataStream &stream) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	// Check the header as mapData does, using the file's size in place of the mapping's.
+	DataHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, DATA_MAGIC, sizeof(DATA_MAGIC)) == 0
+		&& header.version == DATA_VERSION
+		&& header.columnCount == DATA_COLUMNS
+		&& memcmp(header.normalizationConstants, normalizationConstants, sizeof(header.normalizationConstants)) == 0
+		&& seekFile(file, 0, SEEK_END)
+		&& blocksFit(header, (uint64_t) tellFile(file));
+	if (!valid) {
+		fclose(file);
+		return false;
+	}
+
+	// Every read is a seek followed by a whole block, straight into the stream's buffer, so stdio's
+	// buffering would only copy it twice.
+	setvbuf(file, NULL, _IONBF, 0);
+	stream.file		   = file;
+	stream.input	   = NULL;
+	stream.count	   = header.rowCount;
+	stream.inputOffset = header.inputOffset;
+	stream.buffer	   = (double*) malloc(sizeof(double) * DATA_COLUMNS * STREAM_BLOCK_ROWS * STREAM_BUFFER_BLOCKS);
+	stream.blockRows   = (int*)	   calloc(STREAM_BUFFER_BLOCKS, sizeof(int));
+	stream.drawCount   = 0;
+	return true;
+}
+
+/*
+ * Points a stream at data points already in memory, so the same code can sample either.
+ *
+ * Parameters:
+ * const double *input - The data points, stride 3. Must outlive the stream.
+ * int count		   - The number of data points.
+ * DataStream &stream  - The stream to open.
+ */
+void openMemoryStream(const double *input, int count, DataStream &stream) {
+	stream.file		   = NULL;
+	stream.input	   = input;
+	stream.count	   = count;
+	stream.inputOffset = 0;
+	stream.buffer	   = NULL;
+	stream.blockRows   = NULL;
+	stream.drawCount   = 0;
+}
+
+/*
+ * Reads consecutive data points from a stream. Returns false if the file can't be read.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to read from.
+ * int first		  - The index of the first data point to read.
+ * int rowCount		  - The number of data points to read. first + rowCount must not exceed the count.
+ * double *input	  - A preallocated matrix to hold the data points, size rowCount x 3.
+ */
+bool readRows(DataStream &stream, int first, int rowCount, double *input) {
+	if (stream.file == NULL) {
+		memcpy(input, stream.input + (size_t) first * DATA_COLUMNS, sizeof(double) * DATA_COLUMNS * rowCount);
+		return true;
+	}
+	return seekFile(stream.file, stream.inputOffset + (long long) sizeof(double) * DATA_COLUMNS * first, SEEK_SET)
+		&& fread(input, sizeof(double) * DATA_COLUMNS, rowCount, stream.file) == (size_t) rowCount;
+}
+
+/*
+ * Reads a block of consecutive rows, picked at random from the file, into one of a stream's buffer
+ * blocks. Returns false if the file can't be read.
+ *
+ * Parameters:
+ * DataStream &stream - The file stream.
+ * int block		  - The block of the buffer to fill.
+ * int *seed		  - The random number generator state. Must be non-zero, updated on return.
+ */
+static bool readBlock(DataStream &stream, int block, int *seed) {
+	int blockCount = (stream.count + STREAM_BLOCK_ROWS - 1) / STREAM_BLOCK_ROWS;
+	int first	   = i4_uniform(0, blockCount - 1, seed) * STREAM_BLOCK_ROWS;
+	int rowCount   = stream.count - first < STREAM_BLOCK_ROWS ? stream.count - first : STREAM_BLOCK_ROWS;
+	stream.blockRows[block] = rowCount;
+	return readRows(stream, first, rowCount, stream.buffer + (size_t) block * STREAM_BLOCK_ROWS * DATA_COLUMNS);
+}
+
+/*
+ * Reads data points drawn uniformly at random, with replacement, from a stream. Returns false if the
+ * file can't be read.
+ *
+ * A file isn't read a row at a time. The stream keeps a buffer of STREAM_BUFFER_BLOCKS blocks of
+ * STREAM_BLOCK_ROWS consecutive rows, each picked at random, and draws from it, replacing a block
+ * at random with a new one every STREAM_BLOCK_ROWS draws. Every row is just as likely to be drawn,
+ * but rows that are near each other in the file are more likely to be drawn together.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to read from.
+ * int sampleCount	  - The number of data points to draw.
+ * int *seed		  - The random number generator state. Must be non-zero, updated on return.
+ * double *input	  - A preallocated matrix to hold the data points, size sampleCount x 3.
+ */
+bool readSample(DataStream &stream, int sampleCount, int *seed, double *input) {
+	if (stream.file == NULL) {
+		for (int i = 0; i < sampleCount; i++) {
+			readRows(stream, i4_uniform(0, stream.count - 1, seed), 1, input + i * DATA_COLUMNS);
+		}
+		return true;
+	}
+
+	// Fill every block of the buffer on the first draw.
+	if (stream.blockRows[0] == 0) {
+		for (int block = 0; block < STREAM_BUFFER_BLOCKS; block++) {
+			if (!readBlock(stream, block, seed)) {
+				return false;
+			}
+		}
+	}
+
+	for (int i = 0; i < sampleCount; i++) {
+		if (stream.drawCount == STREAM_BLOCK_ROWS) {
+			if (!readBlock(stream, i4_uniform(0, STREAM_BUFFER_BLOCKS - 1, seed), seed)) {
+				return false;
+			}
+			stream.drawCount = 0;
+		}
+		stream.drawCount++;
+
+		// Draws past the end of a short last block are drawn again, so every row in the buffer is as likely.
+		int block, row;
+		do {
+			block = i4_uniform(0, STREAM_BUFFER_BLOCKS - 1, seed);
+			row	  = i4_uniform(0, STREAM_BLOCK_ROWS - 1, seed);
+		} while (row >= stream.blockRows[block]);
+		memcpy(input + i * DATA_COLUMNS, stream.buffer + ((size_t) block * STREAM_BLOCK_ROWS + row) * DATA_COLUMNS, sizeof(double) * DATA_COLUMNS);
+	}
+	return true;
+}
+
+/*
+ * Closes a stream.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to close.
+ */
+void closeDataStream(DataStream &stream) {
+	if (stream.file != NULL) {
+		fclose(stream.file);
+	}
+	free(stream.buffer);
+	free(stream.blockRows);
+	stream.file		 = NULL;
+	stream.input	 = NULL;
+	stream.count	 = 0;
+	stream.buffer	 = NULL;
+	stream.blockRows = NULL;
+}
+
 /*
  * Generates a random matrix of the given size, where values are between 0 & max.
+ * The generator state is held in seed, so each caller can draw a reproducible stream.
  *
  * Parameters:
  * double *matrix - A preallocated matrix to populate.
  * int rows		  - The number of rows in the matrix.
  * int columns	  - The number of columns in the matrix.
  * double max	  - The maximum value of the normal distribution.
+ * int *seed	  - The random number generator state. Must be non-zero, updated on return.
  */
-void randomMatrix(double *matrix, int rows, int columns, double max) {
+void randomMatrix(double *matrix, int rows, int columns, double max, int *seed) {
 	for (int r = 0; r < rows; r++) {
 		for (int c = 0; c < columns; c++) {
-			matrix[r * columns + c] = rand() / double(RAND_MAX) * max;
+			matrix[r * columns + c] = r8_uniform_01(seed) * max;
 		}
 	}
 }
@@ -146,7 +914,7 @@ void ioToFile(char *filename, double *input, int rows, int columns, const double
 }
 
 /*
- * Saves the input data to a text file.
+ * Saves the input data to a text file. NaN values are written as NaN, which MATLAB's load reads back.
  *
  * Parameters:
  * char *filename - The name of the file to write the data to.
@@ -166,7 +934,11 @@ void matrixToFile(char *filename, float *input, int rows, int columns) {
 		for (int colIndex = 0; colIndex < columns; colIndex++) {
 
 			// Append the input to the string.
-			outputString << input[rowIndex + colIndex] << "\t";
+			if (isnan(input[rowIndex + colIndex])) {
+				outputString << "NaN\t";
+			} else {
+				outputString << input[rowIndex + colIndex] << "\t";
+			}
 		}
 
 		// Start a new line.
@@ -1,3 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A set of data points and their target values.
+ *
+ * Members:
+ * double *input	   - A matrix of count data points, where each point is an array of 3 values. Stride 3.
+ * double *target	   - The target value for each data point. Length is count.
+ * int count		   - The number of data points.
+ * void *mapping	   - The mapped binary file the input & target point into, or NULL if they were
+ *						 allocated with malloc. See mapData.
+ * size_t mappingSize  - The size of the mapping in bytes.
+ * double *weight	   - The number of rows merged into each data point by compactDataSet, or NULL if
+ *						 each data point is a single row. When set, target holds the sum of the merged
+ *						 rows' targets, so target - weight * output is the sum of their residuals.
+ * int rowCount		   - The number of rows the data points stand for. Equal to count without weights.
+ * double targetSpread - The sum of the squared distances of the merged rows' targets from the mean
+ *						 target of their data point. The squared error over the rows is targetSpread plus
+ *						 (target - weight * output)^2 / weight summed over the data points.
+ */
+struct DataSet {
+	double *input;
+	double *target;
+	int		count;
+	void   *mapping;
+	size_t	mappingSize;
+	double *weight;
+	int		rowCount;
+	double	targetSpread;
+};
+
+/*
+ * A source of data points that are read on demand rather than held in memory, so that very large
+ * data sets can be sampled with memory independent of their size. Reads either a binary data file
+ * written by saveData or an array already in memory.
+ *
+ * Members:
+ * FILE *file			 - The binary file, or NULL when reading from memory.
+ * const double *input	 - The data points when reading from memory, stride 3. NULL when reading a file.
+ * int count			 - The number of data points.
+ * long long inputOffset - The offset of the first data point in the file.
+ * double *buffer		 - The blocks of rows readSample draws from, stride 3. NULL when reading from memory.
+ * int *blockRows		 - The number of rows in each block of the buffer, 0 until it's filled.
+ * int drawCount		 - The number of rows drawn since a block of the buffer was last replaced.
+ */
+struct DataStream {
+	FILE		 *file;
+	const double *input;
+	int			  count;
+	long long	  inputOffset;
+	double		 *buffer;
+	int			 *blockRows;
+	int			  drawCount;
+};
+
 /*
  * Returns the number of lines in the file specified by filename.
  *
@@ -19,16 +78,178 @@ int	getFileSize(char *filename);
  */
 void loadData(char *filename, const double *normalizationConstants, double *inputData, double *target);
 
+/*
+ * Loads a CSV data file of dayOfYear,hour,dayOfWeek,target rows into a data set in a single pass,
+ * normalizing the inputs as it goes. The file is read in large blocks and the integers are parsed
+ * in place, and the arrays are grown as rows are read, so the file doesn't need counting first.
+ * Blank lines are skipped. Returns false, reporting the line number of the first malformed row to
+ * stderr, if any row doesn't hold exactly 4 integer fields.
+ *
+ * Parameters:
+ * char *filename						- The name of the file to load from.
+ * const double *normalizationConstants	- Constants used to normalize the input data, length 3.
+ * DataSet &dataSet						- The data set to fill. Release it with freeDataSet.
+ */
+bool parseData(char *filename, const double *normalizationConstants, DataSet &dataSet);
+
+/*
+ * Copies a data set with the rows that have identical inputs merged into single weighted data points,
+ * see DataSet. The data points keep the order of each input's first row. Returns the number of rows
+ * merged away; if there are none compact is left unset, so a data set never carries weights it doesn't
+ * need. The compacted data points aren't a substitute for the rows when clustering, as the k-means
+ * routines would count each of them once.
+ *
+ * Parameters:
+ * const DataSet &dataSet - The data set to compact.
+ * DataSet &compact		  - The data set to fill with the compacted copy. Release it with freeDataSet.
+ */
+int compactDataSet(const DataSet &dataSet, DataSet &compact);
+
+/*
+ * Saves a data set in the binary format read by mapData. Returns false if the file can't be written.
+ *
+ * The binary file is a 128 byte header followed by two blocks, each aligned to 64 bytes:
+ * the normalized inputs as rowCount x 3 doubles with stride 3, and then the rowCount target doubles.
+ * The header holds the magic "RBFDATA", a format version, the row count, the column count, the
+ * normalization constants, the offsets of both blocks, a 64-bit FNV-1a checksum of their contents, and
+ * the size and modification time of the CSV file the data came from. Values are written in the
+ * machine's native byte order. The format has no weights, so a compacted data set can't be saved.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file to write, replacing any previous one.
+ * char *csvFilename					- The CSV file the data set was parsed from, which mapData checks the
+ *										  binary file is still up to date with. NULL if there isn't one.
+ * const double *normalizationConstants	- The constants the data set's inputs were normalized with, length 3.
+ * const DataSet &dataSet				- The data set to save.
+ */
+bool saveData(char *filename, char *csvFilename, const double *normalizationConstants, const DataSet &dataSet);
+
+/*
+ * Converts a CSV data file into the binary format read by mapData, normalizing the inputs on the way.
+ * Returns false if the CSV file is malformed or the binary file can't be written.
+ *
+ * Parameters:
+ * char *csvFilename					- The name of the CSV file to convert.
+ * char *binaryFilename					- The name of the binary file to write, replacing any previous one.
+ * const double *normalizationConstants	- Constants used to normalize the input data, length 3.
+ */
+bool convertToBinary(char *csvFilename, char *binaryFilename, const double *normalizationConstants);
+
+/*
+ * Maps a binary data file written by saveData into memory and points a data set at it, so
+ * the data is used in place rather than parsed or copied. Returns false, leaving the data set
+ * unchanged, if the file is missing, truncated, has a different version or normalization constants,
+ * fails its checksum, or is out of date with its CSV file. The mapping is copy-on-write, so the data
+ * set can be modified without changing the file.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file.
+ * char *csvFilename					- The CSV file the binary file was converted from. If its size or
+ *										  modification time differ from those saveData recorded, the binary
+ *										  file is out of date. NULL, or a CSV file that's missing, isn't checked.
+ * const double *normalizationConstants	- The normalization constants the file must have been written with.
+ * DataSet &dataSet						- The data set to fill. Release it with freeDataSet.
+ */
+bool mapData(char *filename, char *csvFilename, const double *normalizationConstants, DataSet &dataSet);
+
+/*
+ * Releases a data set, unmapping it if it came from mapData and freeing its arrays otherwise.
+ *
+ * Parameters:
+ * DataSet &dataSet - The data set to release.
+ */
+void freeDataSet(DataSet &dataSet);
+
+/*
+ * Opens a binary data file written by saveData for reading on demand. Returns false if the file is
+ * missing, truncated, or has a different version or normalization constants. Only the header is
+ * read, so unlike mapData the checksum isn't verified.
+ *
+ * Parameters:
+ * char *filename						- The name of the binary file.
+ * const double *normalizationConstants	- The normalization constants the file must have been written with.
+ * DataStream &stream					- The stream to open. Release it with closeDataStream.
+ */
+bool openDataStream(char *filename, const double *normalizationConstants, DataStream &stream);
+
+/*
+ * Points a stream at data points already in memory, so the same code can sample either.
+ *
+ * Parameters:
+ * const double *input - The data points, stride 3. Must outlive the stream.
+ * int count		   - The number of data points.
+ * DataStream &stream  - The stream to open.
+ */
+void openMemoryStream(const double *input, int count, DataStream &stream);
+
+/*
+ * Reads consecutive data points from a stream. Returns false if the file can't be read.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to read from.
+ * int first		  - The index of the first data point to read.
+ * int rowCount		  - The number of data points to read. first + rowCount must not exceed the count.
+ * double *input	  - A preallocated matrix to hold the data points, size rowCount x 3.
+ */
+bool readRows(DataStream &stream, int first, int rowCount, double *input);
+
+/*
+ * Reads data points drawn uniformly at random, with replacement, from a stream. Returns false if the
+ * file can't be read.
+ *
+ * A file isn't read a row at a time. The stream keeps a buffer of STREAM_BUFFER_BLOCKS blocks of
+ * STREAM_BLOCK_ROWS consecutive rows, each picked at random, and draws from it, replacing a block
+ * at random with a new one every STREAM_BLOCK_ROWS draws. Every row is just as likely to be drawn,
+ * but rows that are near each other in the file are more likely to be drawn together.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to read from.
+ * int sampleCount	  - The number of data points to draw.
+ * int *seed		  - The random number generator state. Must be non-zero, updated on return.
+ * double *input	  - A preallocated matrix to hold the data points, size sampleCount x 3.
+ */
+bool readSample(DataStream &stream, int sampleCount, int *seed, double *input);
+
+/*
+ * Closes a stream.
+ *
+ * Parameters:
+ * DataStream &stream - The stream to close.
+ */
+void closeDataStream(DataStream &stream);
+
+/*
+ * Continues a 64-bit FNV-1a checksum over an array of doubles, a whole value at a time.
+ *
+ * Parameters:
+ * uint64_t hash		- The checksum so far. Start with 14695981039346656037.
+ * const double *values - The values to add.
+ * size_t count			- The number of values.
+ */
+uint64_t checksum(uint64_t hash, const double *values, size_t count);
+
+/*
+ * Continues a 64-bit FNV-1a checksum over a block of memory, a byte at a time.
+ *
+ * Parameters:
+ * uint64_t hash	- The checksum so far. Start with 14695981039346656037.
+ * const void *data - The bytes to add.
+ * size_t size		- The number of bytes.
+ */
+uint64_t checksumBytes(uint64_t hash, const void *data, size_t size);
+
 /*
  * Generates a random matrix of the given size, where values are between 0 & max.
+ * The generator state is held in seed, so each caller can draw a reproducible stream.
  *
  * Parameters:
  * double *matrix - A preallocated matrix to populate.
  * int rows		  - The number of rows in the matrix.
  * int columns	  - The number of columns in the matrix.
  * double max	  - The maximum value of the normal distribution.
+ * int *seed	  - The random number generator state. Must be non-zero, updated on return.
  */
-void randomMatrix(double *matrix, int rows, int columns, double max);
+void randomMatrix(double *matrix, int rows, int columns, double max, int *seed);
 
 /*
  * Prints the values of a matrix.
@@ -54,7 +275,7 @@ void printMatrix(double *matrix, int rows, int columns);
 void ioToFile(char *filename, double *input, int rows, int columns, const double *normalizationConstants, double *output);
 
 /*
- * Saves the input data to a text file.
+ * Saves the input data to a text file. NaN values are written as NaN, which MATLAB's load reads back.
  *
  * Parameters:
  * char *filename - The name of the file to write the data to.
@@ -5,6 +5,8 @@
 # include <cmath>
 # include <ctime>
 # include <string>
+# include <thread>
+# include <vector>
 # include "kmeans.hpp"
 
 using namespace std;
@@ -203,7 +205,7 @@ double *cluster_energy_compute(int dim_num, int point_num, int cluster_num,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy
-				+ pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				+ r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
@@ -427,7 +429,7 @@ double *cluster_initialize_3(int dim_num, int point_num, int cluster_num,
 	//  The rest of the points get assigned randomly.
 	//
 	for (j = cluster_num; j < point_num; j++) {
-		k = i4_uniform(1, cluster_num, seed);
+		k = i4_uniform(0, cluster_num - 1, seed);
 		for (i = 0; i < dim_num; i++) {
 			cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num]
 				+ point[i + j*dim_num];
@@ -625,6 +627,361 @@ double *cluster_initialize_5(int dim_num, int point_num, int cluster_num,
 }
 //****************************************************************************80
 
+double *cluster_initialize_6(int dim_num, int point_num, int cluster_num,
+	double point[], int *seed)
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   CLUSTER_INITIALIZE_6 initializes the cluster centers by K-Means++ seeding.
+	//
+	//  Discussion:
+	//
+	//    The first cluster center is a data point chosen at random.  Each
+	//    further center is a data point chosen at random with probability
+	//    proportional to its squared distance from the nearest center chosen
+	//    so far, so the centers are spread across the data.  The expected
+	//    energy of the initial clustering is within a factor of
+	//    O(log(CLUSTER_NUM)) of the optimal one.
+	//
+	//    This is CLUSTER_INITIALIZE_W_6 with every weight equal to 1.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Reference:
+	//
+	//    David Arthur, Sergei Vassilvitskii,
+	//    k-means++: The Advantages of Careful Seeding,
+	//    Proceedings of the Eighteenth Annual ACM-SIAM Symposium
+	//    on Discrete Algorithms, 2007, pages 1027-1035.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the coordinates 
+	//    of the points.
+	//
+	//    Input/output, int *SEED, a seed for the random 
+	//    number generator.
+	//
+	//    Output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM],
+	//    the coordinates of the cluster centers.
+	//
+{
+	double *cluster_center;
+	int j;
+	double *weight;
+
+	weight = new double[point_num];
+	for (j = 0; j < point_num; j++) {
+		weight[j] = 1.0;
+	}
+
+	cluster_center = cluster_initialize_w_6(dim_num, point_num, cluster_num,
+		point, weight, seed);
+
+	delete[] weight;
+
+	return cluster_center;
+}
+//****************************************************************************80
+
+double *cluster_initialize_7(int dim_num, int point_num, int cluster_num,
+	double point[], int *seed)
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   CLUSTER_INITIALIZE_7 initializes the cluster centers by K-Means|| seeding.
+	//
+	//  Discussion:
+	//
+	//    K-Means++ seeding makes one pass over the data for every center.
+	//    This routine instead makes a few rounds.  In each round, every
+	//    point is chosen as a candidate independently, with probability
+	//    proportional to its squared distance from the nearest candidate so
+	//    far, so that about 2 * CLUSTER_NUM candidates are chosen per round.
+	//    Each candidate is then weighted by the number of points nearest to
+	//    it, and the cluster centers are chosen from the candidates by
+	//    CLUSTER_INITIALIZE_W_6.
+	//
+	//    Within a round every point is handled independently, so a round
+	//    may be split across processors.  Only the candidates, which are
+	//    far fewer than the points, are seeded one center at a time.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Reference:
+	//
+	//    Bahman Bahmani, Benjamin Moseley, Andrea Vattani, Ravi Kumar,
+	//    Sergei Vassilvitskii,
+	//    Scalable K-Means++,
+	//    Proceedings of the VLDB Endowment,
+	//    Volume 5, Number 7, 2012, pages 622-633.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the coordinates 
+	//    of the points.
+	//
+	//    Input/output, int *SEED, a seed for the random 
+	//    number generator.
+	//
+	//    Output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM],
+	//    the coordinates of the cluster centers.
+	//
+{
+	double *candidate;
+	int candidate_max;
+	int candidate_num;
+	int candidate_old;
+	double *candidate_weight;
+	double *cluster_center;
+	double *distsq;
+	double energy;
+	int i;
+	int j;
+	int k;
+	int *nearest;
+	double point_energy;
+	int round;
+	int round_num = 5;
+	double *seeded;
+
+	candidate_max = 1 + 4 * cluster_num * round_num;
+	candidate = new double[dim_num * candidate_max];
+	distsq = new double[point_num];
+	nearest = new int[point_num];
+	//
+	//  The first candidate is a data point chosen at random.
+	//
+	j = i4_uniform(0, point_num - 1, seed);
+	for (i = 0; i < dim_num; i++) {
+		candidate[i] = point[i + j*dim_num];
+	}
+	candidate_num = 1;
+
+	for (j = 0; j < point_num; j++) {
+		distsq[j] = 0.0;
+		for (i = 0; i < dim_num; i++) {
+			distsq[j] = distsq[j] + r8_square(point[i + j*dim_num] - candidate[i]);
+		}
+		nearest[j] = 0;
+	}
+	//
+	//  Each round chooses candidates from every point independently, then
+	//  updates each point's distance to its nearest candidate.
+	//
+	for (round = 0; round < round_num; round++) {
+		energy = r8vec_sum(point_num, distsq);
+		if (energy <= 0.0) {
+			break;
+		}
+
+		candidate_old = candidate_num;
+		for (j = 0; j < point_num && candidate_num < candidate_max; j++) {
+			if (r8_uniform_01(seed) * energy < 2.0 * (double)cluster_num * distsq[j]) {
+				for (i = 0; i < dim_num; i++) {
+					candidate[i + candidate_num*dim_num] = point[i + j*dim_num];
+				}
+				candidate_num = candidate_num + 1;
+			}
+		}
+
+		for (j = 0; j < point_num; j++) {
+			for (k = candidate_old; k < candidate_num; k++) {
+				point_energy = 0.0;
+				for (i = 0; i < dim_num; i++) {
+					point_energy = point_energy
+						+ r8_square(point[i + j*dim_num] - candidate[i + k*dim_num]);
+				}
+				if (point_energy < distsq[j]) {
+					distsq[j] = point_energy;
+					nearest[j] = k;
+				}
+			}
+		}
+	}
+	//
+	//  Weight each candidate by the number of points nearest to it.
+	//
+	candidate_weight = r8vec_zero_new(candidate_num);
+	for (j = 0; j < point_num; j++) {
+		candidate_weight[nearest[j]] = candidate_weight[nearest[j]] + 1.0;
+	}
+	//
+	//  Choose the cluster centers from the candidates.  If there were too
+	//  few candidates, the rest are data points chosen at random.
+	//
+	seeded = cluster_initialize_w_6(dim_num, candidate_num,
+		i4_min(cluster_num, candidate_num), candidate, candidate_weight, seed);
+
+	cluster_center = new double[dim_num * cluster_num];
+	for (k = 0; k < cluster_num; k++) {
+		if (k < candidate_num) {
+			for (i = 0; i < dim_num; i++) {
+				cluster_center[i + k*dim_num] = seeded[i + k*dim_num];
+			}
+		}
+		else {
+			j = i4_uniform(0, point_num - 1, seed);
+			for (i = 0; i < dim_num; i++) {
+				cluster_center[i + k*dim_num] = point[i + j*dim_num];
+			}
+		}
+	}
+
+	delete[] candidate;
+	delete[] candidate_weight;
+	delete[] distsq;
+	delete[] nearest;
+	delete[] seeded;
+
+	return cluster_center;
+}
+//****************************************************************************80
+
+double *cluster_initialize_w_6(int dim_num, int point_num, int cluster_num,
+	double point[], double weight[], int *seed)
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   CLUSTER_INITIALIZE_W_6 initializes weighted cluster centers by K-Means++ seeding.
+	//
+	//  Discussion:
+	//
+	//    The first cluster center is a data point chosen at random with
+	//    probability proportional to its weight.  Each further center is a
+	//    data point chosen at random with probability proportional to its
+	//    weight times its squared distance from the nearest center chosen
+	//    so far.
+	//
+	//    If every point with positive weight is already a center, the rest
+	//    are chosen with probability proportional to weight alone.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Reference:
+	//
+	//    David Arthur, Sergei Vassilvitskii,
+	//    k-means++: The Advantages of Careful Seeding,
+	//    Proceedings of the Eighteenth Annual ACM-SIAM Symposium
+	//    on Discrete Algorithms, 2007, pages 1027-1035.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the coordinates 
+	//    of the points.
+	//
+	//    Input, double WEIGHT[POINT_NUM], the weights
+	//    assigned to the data points.
+	//
+	//    Input/output, int *SEED, a seed for the random 
+	//    number generator.
+	//
+	//    Output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM],
+	//    the coordinates of the cluster centers.
+	//
+{
+	double *cluster_center;
+	double *distsq;
+	int i;
+	int j;
+	int k;
+	double point_energy;
+	double *probability;
+	double r;
+	double total;
+
+	cluster_center = new double[dim_num * cluster_num];
+	distsq = new double[point_num];
+	probability = new double[point_num];
+
+	for (j = 0; j < point_num; j++) {
+		distsq[j] = r8_huge();
+	}
+
+	for (k = 0; k < cluster_num; k++) {
+		//
+		//  Weight each point by its squared distance to the nearest center.
+		//
+		total = 0.0;
+		if (0 < k) {
+			for (j = 0; j < point_num; j++) {
+				probability[j] = weight[j] * distsq[j];
+				total = total + probability[j];
+			}
+		}
+		if (total <= 0.0) {
+			for (j = 0; j < point_num; j++) {
+				probability[j] = weight[j];
+				total = total + probability[j];
+			}
+		}
+		//
+		//  Choose the next center.
+		//
+		r = r8_uniform_01(seed) * total;
+		for (j = 0; j < point_num - 1; j++) {
+			if (r < probability[j]) {
+				break;
+			}
+			r = r - probability[j];
+		}
+		while (0 < j && probability[j] <= 0.0) {
+			j = j - 1;
+		}
+
+		for (i = 0; i < dim_num; i++) {
+			cluster_center[i + k*dim_num] = point[i + j*dim_num];
+		}
+		//
+		//  Update the distances to the nearest center.
+		//
+		for (j = 0; j < point_num; j++) {
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy
+					+ r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			}
+			distsq[j] = r8_min(distsq[j], point_energy);
+		}
+	}
+
+	delete[] distsq;
+	delete[] probability;
+
+	return cluster_center;
+}
+//****************************************************************************80
+
 void cluster_print_summary(int point_num, int cluster_num,
 	int cluster_population[], double cluster_energy[], double cluster_variance[])
 
@@ -717,20 +1074,31 @@ void cluster_print_summary(int point_num, int cluster_num,
 }
 //****************************************************************************80
 
-double *cluster_variance_compute(int dim_num, int point_num, int cluster_num,
-	double point[], int cluster[], double cluster_center[])
+void cluster_split(int dim_num, int point_num, int cluster_num, int split_num,
+	double point[], int cluster[], double cluster_center[],
+	double cluster_energy[])
 
 	//****************************************************************************80
 	//
 	//  Purpose:
 	//
-	//   CLUSTER_VARIANCE_COMPUTE computes the variance of the clusters.
+	//    CLUSTER_SPLIT adds clusters by splitting the highest energy clusters.
 	//
 	//  Discussion:
 	//
-	//    The cluster variance (from the cluster center) is the average of the 
-	//    sum of the squares of the distances of each point in the cluster to the 
-	//    cluster center.
+	//    This routine is used to warm-start a clustering with more clusters
+	//    from the solution of a clustering with fewer.
+	//
+	//    The SPLIT_NUM clusters with the highest energy are chosen.  For
+	//    each of them, the member point furthest from the cluster center
+	//    becomes the center of a new cluster.  The new centers are stored
+	//    after the existing ones, so CLUSTER_CENTER must have room for
+	//    CLUSTER_NUM + SPLIT_NUM centers.
+	//
+	//    The assignments and energies are those of the existing clustering,
+	//    as returned by, for instance, KMEANS_03.  They are not updated;
+	//    the caller should run a K-Means routine on the enlarged set of
+	//    centers.
 	//
 	//  Licensing:
 	//
@@ -738,11 +1106,7 @@ double *cluster_variance_compute(int dim_num, int point_num, int cluster_num,
 	//
 	//  Modified:
 	//
-	//    06 October 2009
-	//
-	//  Author:
-	//
-	//    John Burkardt
+	//    17 October 2026
 	//
 	//  Parameters:
 	//
@@ -750,37 +1114,183 @@ double *cluster_variance_compute(int dim_num, int point_num, int cluster_num,
 	//
 	//    Input, int POINT_NUM, the number of data points.
 	//
-	//    Input, int CLUSTER_NUM, the number of clusters.
+	//    Input, int CLUSTER_NUM, the number of existing clusters.
+	//
+	//    Input, int SPLIT_NUM, the number of clusters to add.
+	//    0 <= SPLIT_NUM <= CLUSTER_NUM.
 	//
 	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
 	//
 	//    Input, int CLUSTER[POINT_NUM], the cluster to which each
-	//    data point belongs.
+	//    data point belongs.  These values are 0-based.
 	//
-	//    Input, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the 
-	//    centers associated with the minimal energy clustering.
+	//    Input/output, double CLUSTER_CENTER[DIM_NUM*(CLUSTER_NUM+SPLIT_NUM)],
+	//    the cluster centers.  On input, the first CLUSTER_NUM entries are
+	//    set.  On output, the new centers have been appended.
 	//
-	//    Output, double CLUSTER_VARIANCE_COMPUTE[CLUSTER_NUM], the variance
-	//    associated with each cluster.
+	//    Input, double CLUSTER_ENERGY[CLUSTER_NUM], the energy of 
+	//    the clusters.
 	//
 {
-	int *cluster_population;
-	double *cluster_variance;
+	double *far_energy;
+	int *far_point;
 	int i;
 	int j;
 	int k;
-	double point_variance;
-
-	cluster_population = i4vec_zero_new(cluster_num);
-	cluster_variance = r8vec_zero_new(cluster_num);
-
-	for (j = 0; j < point_num; j++) {
-		k = cluster[j];
+	int k_max;
+	double point_energy;
+	int s;
+	int *split;
+	//
+	//  Check the input.
+	//
+	if (split_num < 0 || cluster_num < split_num) {
+		cout << "\n";
+		cout << "CLUSTER_SPLIT - Fatal error!\n";
+		cout << "  SPLIT_NUM < 0 or CLUSTER_NUM < SPLIT_NUM.\n";
+		exit(1);
+	}
+	//
+	//  Pick the clusters with the highest energy.  SPLIT[K] is the index
+	//  of the new cluster split off from cluster K, or -1.
+	//
+	split = i4vec_negone_new(cluster_num);
+
+	for (s = 0; s < split_num; s++) {
+		k_max = -1;
+		for (k = 0; k < cluster_num; k++) {
+			if (split[k] == -1 &&
+				(k_max == -1 || cluster_energy[k_max] < cluster_energy[k])) {
+				k_max = k;
+			}
+		}
+		split[k_max] = s;
+	}
+	//
+	//  Find the member of each chosen cluster furthest from its center.
+	//
+	far_energy = new double[split_num];
+	far_point = i4vec_negone_new(split_num);
+
+	for (s = 0; s < split_num; s++) {
+		far_energy[s] = -1.0;
+	}
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
+		s = split[k];
+
+		if (s == -1) {
+			continue;
+		}
+
+		point_energy = 0.0;
+		for (i = 0; i < dim_num; i++) {
+			point_energy = point_energy +
+				(point[i + j*dim_num] - cluster_center[i + k*dim_num])
+				* (point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+		}
+
+		if (far_energy[s] < point_energy) {
+			far_energy[s] = point_energy;
+			far_point[s] = j;
+		}
+	}
+	//
+	//  Append the new centers.  A cluster with no members donates a copy
+	//  of its own center, which the K-Means routines will relocate.
+	//
+	for (k = 0; k < cluster_num; k++) {
+		s = split[k];
+
+		if (s == -1) {
+			continue;
+		}
+
+		j = far_point[s];
+		for (i = 0; i < dim_num; i++) {
+			if (j == -1) {
+				cluster_center[i + (cluster_num + s)*dim_num] =
+					cluster_center[i + k*dim_num];
+			} else {
+				cluster_center[i + (cluster_num + s)*dim_num] =
+					point[i + j*dim_num];
+			}
+		}
+	}
+
+	delete[] far_energy;
+	delete[] far_point;
+	delete[] split;
+
+	return;
+}
+//****************************************************************************80
+
+double *cluster_variance_compute(int dim_num, int point_num, int cluster_num,
+	double point[], int cluster[], double cluster_center[])
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   CLUSTER_VARIANCE_COMPUTE computes the variance of the clusters.
+	//
+	//  Discussion:
+	//
+	//    The cluster variance (from the cluster center) is the average of the 
+	//    sum of the squares of the distances of each point in the cluster to the 
+	//    cluster center.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Modified:
+	//
+	//    06 October 2009
+	//
+	//  Author:
+	//
+	//    John Burkardt
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of data points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
+	//
+	//    Input, int CLUSTER[POINT_NUM], the cluster to which each
+	//    data point belongs.
+	//
+	//    Input, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the 
+	//    centers associated with the minimal energy clustering.
+	//
+	//    Output, double CLUSTER_VARIANCE_COMPUTE[CLUSTER_NUM], the variance
+	//    associated with each cluster.
+	//
+{
+	int *cluster_population;
+	double *cluster_variance;
+	int i;
+	int j;
+	int k;
+	double point_variance;
+
+	cluster_population = i4vec_zero_new(cluster_num);
+	cluster_variance = r8vec_zero_new(cluster_num);
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
 
 		point_variance = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_variance = point_variance +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_variance[k] = cluster_variance[k] + point_variance;
 		cluster_population[k] = cluster_population[k] + 1;
@@ -1018,24 +1528,495 @@ void hmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 	//    indicate the index of the nearest cluster center to point X(I), the
 	//    energy can be written as:
 	//
-	//      Energy = Sum ( 1 <= I <= N ) || X(I) - Z(CLUSTER(I)) ||^2
+	//      Energy = Sum ( 1 <= I <= N ) || X(I) - Z(CLUSTER(I)) ||^2
+	//
+	//    where
+	//
+	//      || X - Z ||^2 = Sum ( 1 <= J <= M ) ( X(J) - Z(J) )^2
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Modified:
+	//
+	//    08 October 2011
+	//
+	//  Author:
+	//
+	//    John Burkardt
+	//
+	//  Reference:
+	//
+	//    Wendy Martinez, Angel Martinez,
+	//    Computational Statistics Handbook with MATLAB,
+	//    pages 373-376,
+	//    Chapman and Hall / CRC, 2002.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of data points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, int IT_MAX, the maximum number of iterations.
+	//
+	//    Output, int &IT_NUM, the number of iterations taken.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
+	//
+	//    Input/output, int CLUSTER[POINT_NUM].  On input, the user 
+	//    may specify an initial cluster for each point, or leave all entrie of
+	//    CLUSTER set to 0.  On output, CLUSTER contains the index of the
+	//    cluster to which each data point belongs.
+	//
+	//    Input/output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the 
+	//    centers associated with the minimal energy clustering.
+	//
+	//    Output, int CLUSTER_POPULATION[CLUSTER_NUM],
+	//    the populuation of each cluster.
+	//
+	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy
+	//    associated with each cluster.
+	//
+{
+	double *centroid;
+	bool debug = true;
+	int i;
+	int j;
+	int k;
+	int k2;
+	int missed;
+	double point_energy;
+	double point_energy_min;
+	int swap;
+	//
+	//  Data checks.
+	//
+	if (cluster_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "  CLUSTER_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (dim_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "  DIM_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (point_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "  POINT_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (it_max < 0) {
+		cout << "\n";
+		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "  IT_MAX < 0.\n";
+		exit(1);
+	}
+	//
+	//  On input, legal entries in CLUSTER are preserved, but
+	//  otherwise, each point is assigned to its nearest cluster.
+	//
+	for (j = 0; j < point_num; j++) {
+		if (cluster[j] < 0 || cluster_num <= cluster[j]) {
+			point_energy_min = r8_huge();
+
+			for (k = 0; k < cluster_num; k++) {
+				point_energy = 0.0;
+				for (i = 0; i < dim_num; i++) {
+					point_energy = point_energy +
+						r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+				}
+
+				if (point_energy < point_energy_min) {
+					point_energy_min = point_energy;
+					cluster[j] = k;
+				}
+			}
+		}
+	}
+	it_num = 0;
+
+	while (it_num < it_max) {
+		it_num = it_num + 1;
+		//
+		//  #1:
+		//  Assign each point to the cluster of its nearest center.
+		//
+		swap = 0;
+
+		for (j = 0; j < point_num; j++) {
+			point_energy_min = r8_huge();
+			k = cluster[j];
+
+			for (k2 = 0; k2 < cluster_num; k2++) {
+				point_energy = 0.0;
+				for (i = 0; i < dim_num; i++) {
+					point_energy = point_energy +
+						r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
+				}
+
+				if (point_energy < point_energy_min) {
+					point_energy_min = point_energy;
+					cluster[j] = k2;
+				}
+			}
+
+			if (k != cluster[j]) {
+				swap = swap + 1;
+			}
+		}
+		//
+		//  Terminate if no points were swapped.
+		//
+		if (1 < it_num) {
+			if (swap == 0) {
+				break;
+			}
+		}
+		//
+		//  #2:
+		//  Determine the total energy of the new clustering with current centroids.
+		//
+		r8vec_zero(cluster_num, cluster_energy);
+
+		for (j = 0; j < point_num; j++) {
+			k = cluster[j];
+
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy +
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			}
+			cluster_energy[k] = cluster_energy[k] + point_energy;
+		}
+		//
+		//  #3:
+		//  Determine the centroids of the clusters.
+		//
+		centroid = r8vec_zero_new(dim_num * cluster_num);
+		i4vec_zero(cluster_num, cluster_population);
+
+		for (j = 0; j < point_num; j++) {
+			k = cluster[j];
+			cluster_population[k] = cluster_population[k] + 1;
+			for (i = 0; i < dim_num; i++) {
+				centroid[i + k*dim_num] = centroid[i + k*dim_num] + point[i + j*dim_num];
+			}
+		}
+		//
+		//  Now divide by the population to get the centroid.
+		//  But if a center has no population, pick a point at random.
+		//
+		missed = 0;
+
+		for (k = 0; k < cluster_num; k++) {
+			if (cluster_population[k] != 0) {
+				for (i = 0; i < dim_num; i++) {
+					centroid[i + k*dim_num] = centroid[i + k*dim_num]
+						/ (double)(cluster_population[k]);
+				}
+			} else {
+				for (i = 0; i < dim_num; i++) {
+					centroid[i + k*dim_num] = point[i + missed*dim_num];
+				}
+				missed = missed + 1;
+			}
+		}
+
+		for (k = 0; k < cluster_num; k++) {
+			for (i = 0; i < dim_num; i++) {
+				cluster_center[i + k*dim_num] = centroid[i + k*dim_num];
+			}
+		}
+
+		delete[] centroid;
+		//
+		//  #4:
+		//  Determine the total energy of the current clustering with new centroids.
+		//
+		r8vec_zero(cluster_num, cluster_energy);
+
+		for (j = 0; j < point_num; j++) {
+			k = cluster[j];
+
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy +
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			}
+			cluster_energy[k] = cluster_energy[k] + point_energy;
+		}
+	}
+	return;
+}
+//****************************************************************************80
+
+void hmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
+	int &it_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double cluster_energy[], int *seed)
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   HMEANS_02 applies the H-Means algorithm.
+	//
+	//  Discussion:
+	//
+	//    This is a simple routine to group a set of points into K clusters,
+	//    each with a center point, in such a way that the total cluster 
+	//    energy is minimized.  The total cluster energy is the sum of the
+	//    squares of the distances of each point to the center of its cluster.
+	//
+	//    The algorithm begins with an initial estimate for the cluster centers:
+	//
+	//    1. The points are assigned to the nearest cluster centers.
+	//
+	//    2. The iteration exit ( 1 );s if the total energy has not changed 
+	//        significantly, or we have reached the maximum number of iterations.
+	//
+	//    3. Each cluster center is replaced by the centroid of the points
+	//       in the cluster.
+	//
+	//    4. Return to step 1.
+	//
+	//    The algorithm may fail to find the best solution.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Modified:
+	//
+	//    08 October 2011
+	//
+	//  Author:
+	//
+	//    John Burkardt
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, int IT_MAX, the maximum number of iterations.
+	//
+	//    Output, int IT_NUM, the number of iterations taken.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the coordinates 
+	//    of the points.
+	//
+	//    Input/output, int CLUSTER[POINT_NUM].  On input, the user 
+	//    may specify an initial cluster for each point, or leave all entrie of
+	//    CLUSTER set to 0.  On output, CLUSTER contains the index of the
+	//    cluster to which each data point belongs.
+	//
+	//    Input/output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM],
+	//    the coordinates of the cluster centers.
+	//
+	//    Output, int CLUSTER_POPULATION[CLUSTER_NUM], the number of
+	//    points assigned to each cluster.
+	//
+	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy of 
+	//    the clusters.
+	//
+	//    Input/output, int *SEED, a seed for the random
+	//    number generator.
+	//
+{
+	bool debug = false;
+	int i;
+	int j;
+	int k;
+	int k2;
+	double point_energy;
+	double point_energy_min;
+	int swap;
+	//
+	//  Data checks.
+	//
+	if (cluster_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_02 - Fatal error!\n";
+		cout << "  CLUSTER_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (dim_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_02 - Fatal error!\n";
+		cout << "  DIM_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (point_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_02 - Fatal error!\n";
+		cout << "  POINT_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (it_max < 0) {
+		cout << "\n";
+		cout << "HMEANS_02 - Fatal error!\n";
+		cout << "  IT_MAX < 0.\n";
+		exit(1);
+	}
+	//
+	//  On input, legal entries in CLUSTER are preserved, but
+	//  otherwise, each point is assigned to its nearest cluster.
+	//
+	for (j = 0; j < point_num; j++) {
+		if (cluster[j] < 0 || cluster_num <= cluster[j]) {
+			point_energy_min = r8_huge();
+			for (k = 0; k < cluster_num; k++) {
+				point_energy = 0.0;
+				for (i = 0; i < dim_num; i++) {
+					point_energy = point_energy +
+						r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+				}
+				if (point_energy < point_energy_min) {
+					point_energy_min = point_energy;
+					cluster[j] = k;
+				}
+			}
+		}
+	}
+
+	it_num = 0;
+
+	for (; ; ) {
+		//
+		//  Given centers, assign points to nearest center.
+		//
+		i4vec_zero(cluster_num, cluster_population);
+		r8vec_zero(cluster_num, cluster_energy);
+
+		swap = 0;
+
+		for (j = 0; j < point_num; j++) {
+			point_energy_min = r8_huge();
+			k = cluster[j];
+
+			for (k2 = 0; k2 < cluster_num; k2++) {
+				point_energy = 0.0;
+				for (i = 0; i < dim_num; i++) {
+					point_energy = point_energy +
+						r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
+				}
+
+				if (point_energy < point_energy_min) {
+					point_energy_min = point_energy;
+					cluster[j] = k2;
+				}
+			}
+			if (k != cluster[j]) {
+				swap = swap + 1;
+			}
+			k = cluster[j];
+			cluster_energy[k] = cluster_energy[k] + point_energy_min;
+			cluster_population[k] = cluster_population[k] + 1;
+		}
+
+		if (debug) {
+			cout << "  " << setw(3) << it_num
+				<< "  " << setw(14) << r8vec_sum(cluster_num, cluster_energy) << "\n";
+		}
+
+		if (0 < it_num) {
+			if (swap == 0) {
+				break;
+			}
+		}
+
+		if (it_max <= it_num) {
+			break;
+		}
+
+		it_num = it_num + 1;
+		//
+		//  Given points in cluster, replace center by centroid.
+		//
+		r8vec_zero(dim_num * cluster_num, cluster_center);
+
+		for (j = 0; j < point_num; j++) {
+			k = cluster[j];
+			for (i = 0; i < dim_num; i++) {
+				cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num]
+					+ point[i + j*dim_num];
+			}
+		}
+
+		for (k = 0; k < cluster_num; k++) {
+			if (cluster_population[k] != 0) {
+				for (i = 0; i < dim_num; i++) {
+					cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num] /
+						(double)(cluster_population[k]);
+				}
+			} else {
+				j = i4_uniform(0, point_num - 1, seed);
+				for (i = 0; i < dim_num; i++) {
+					cluster_center[i + k*dim_num] = point[i + j*dim_num];
+				}
+			}
+		}
+	}
+	//
+	//  Compute the energy based on the final value of the cluster centers.
+	//
+	r8vec_zero(cluster_num, cluster_energy);
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
+
+		point_energy = 0.0;
+		for (i = 0; i < dim_num; i++) {
+			point_energy = point_energy +
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+		}
+		cluster_energy[k] = cluster_energy[k] + point_energy;
+	}
+	return;
+}
+//****************************************************************************80
+
+void hmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
+	int &it_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double cluster_energy[], int thread_num)
+
+	//****************************************************************************80
+	//
+	//  Purpose:
 	//
-	//    where
+	//   HMEANS_03 applies the H-Means algorithm of HMEANS_01 on several threads.
 	//
-	//      || X - Z ||^2 = Sum ( 1 <= J <= M ) ( X(J) - Z(J) )^2
+	//  Discussion:
+	//
+	//    The points are split into THREAD_NUM contiguous ranges.  Each thread
+	//    assigns the points of its range to their nearest centers, and sums
+	//    the points and energies of each cluster over its range.  The partial
+	//    sums are then added together in thread order, so for a given
+	//    THREAD_NUM the result is always the same.  With one thread, the sums
+	//    are formed in the same order as HMEANS_01, and the result is
+	//    identical to it.
 	//
 	//  Licensing:
 	//
 	//    This code is distributed under the GNU LGPL license. 
 	//
-	//  Modified:
-	//
-	//    08 October 2011
-	//
-	//  Author:
-	//
-	//    John Burkardt
-	//
 	//  Reference:
 	//
 	//    Wendy Martinez, Angel Martinez,
@@ -1071,99 +2052,121 @@ void hmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy
 	//    associated with each cluster.
 	//
+	//    Input, int THREAD_NUM, the number of threads to use.
+	//
 {
 	double *centroid;
-	bool debug = true;
 	int i;
 	int j;
 	int k;
-	int k2;
 	int missed;
+	double *partial_centroid;
+	double *partial_energy;
+	int *partial_population;
 	double point_energy;
 	double point_energy_min;
 	int swap;
+	int *swaps;
+	int t;
+	vector<thread> threads;
 	//
 	//  Data checks.
 	//
 	if (cluster_num < 1) {
 		cout << "\n";
-		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "HMEANS_03 - Fatal error!\n";
 		cout << "  CLUSTER_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (dim_num < 1) {
 		cout << "\n";
-		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "HMEANS_03 - Fatal error!\n";
 		cout << "  DIM_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (point_num < 1) {
 		cout << "\n";
-		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "HMEANS_03 - Fatal error!\n";
 		cout << "  POINT_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (it_max < 0) {
 		cout << "\n";
-		cout << "HMEANS_01 - Fatal error!\n";
+		cout << "HMEANS_03 - Fatal error!\n";
 		cout << "  IT_MAX < 0.\n";
 		exit(1);
 	}
+
+	if (thread_num < 1) {
+		cout << "\n";
+		cout << "HMEANS_03 - Fatal error!\n";
+		cout << "  THREAD_NUM < 1.\n";
+		exit(1);
+	}
+
+	thread_num = i4_min(thread_num, point_num);
 	//
 	//  On input, legal entries in CLUSTER are preserved, but
 	//  otherwise, each point is assigned to its nearest cluster.
+	//  The first iteration reassigns every point anyway, so this
+	//  only matters when no iterations are taken.
 	//
-	for (j = 0; j < point_num; j++) {
-		if (cluster[j] < 0 || cluster_num <= cluster[j]) {
-			point_energy_min = r8_huge();
+	if (it_max == 0) {
+		for (j = 0; j < point_num; j++) {
+			if (cluster[j] < 0 || cluster_num <= cluster[j]) {
+				point_energy_min = r8_huge();
 
-			for (k = 0; k < cluster_num; k++) {
-				point_energy = 0.0;
-				for (i = 0; i < dim_num; i++) {
-					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
-				}
+				for (k = 0; k < cluster_num; k++) {
+					point_energy = 0.0;
+					for (i = 0; i < dim_num; i++) {
+						point_energy = point_energy +
+							r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+					}
 
-				if (point_energy < point_energy_min) {
-					point_energy_min = point_energy;
-					cluster[j] = k;
+					if (point_energy < point_energy_min) {
+						point_energy_min = point_energy;
+						cluster[j] = k;
+					}
 				}
 			}
 		}
 	}
+
+	partial_centroid = new double[thread_num * dim_num * cluster_num];
+	partial_energy = new double[thread_num * cluster_num];
+	partial_population = new int[thread_num * cluster_num];
+	swaps = new int[thread_num];
+	centroid = new double[dim_num * cluster_num];
+
 	it_num = 0;
 
 	while (it_num < it_max) {
 		it_num = it_num + 1;
 		//
 		//  #1:
-		//  Assign each point to the cluster of its nearest center.
+		//  Assign each point to the cluster of its nearest center, and
+		//  sum the points of each cluster, one range per thread.
 		//
-		swap = 0;
-
-		for (j = 0; j < point_num; j++) {
-			point_energy_min = r8_huge();
-			k = cluster[j];
-
-			for (k2 = 0; k2 < cluster_num; k2++) {
-				point_energy = 0.0;
-				for (i = 0; i < dim_num; i++) {
-					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k2*dim_num], 2);
-				}
-
-				if (point_energy < point_energy_min) {
-					point_energy_min = point_energy;
-					cluster[j] = k2;
-				}
-			}
+		threads.clear();
+		for (t = 1; t < thread_num; t++) {
+			threads.push_back(thread(hmeans_03_assign, dim_num,
+				(t * (long long)point_num) / thread_num,
+				((t + 1) * (long long)point_num) / thread_num, cluster_num, point,
+				cluster, cluster_center, partial_population + t*cluster_num,
+				partial_centroid + t*dim_num*cluster_num, swaps + t));
+		}
+		hmeans_03_assign(dim_num, 0, point_num / thread_num, cluster_num, point,
+			cluster, cluster_center, partial_population, partial_centroid, swaps);
+		for (t = 1; t < thread_num; t++) {
+			threads[t - 1].join();
+		}
 
-			if (k != cluster[j]) {
-				swap = swap + 1;
-			}
+		swap = 0;
+		for (t = 0; t < thread_num; t++) {
+			swap = swap + swaps[t];
 		}
 		//
 		//  Terminate if no points were swapped.
@@ -1175,32 +2178,19 @@ void hmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 		}
 		//
 		//  #2:
-		//  Determine the total energy of the new clustering with current centroids.
-		//
-		r8vec_zero(cluster_num, cluster_energy);
-
-		for (j = 0; j < point_num; j++) {
-			k = cluster[j];
-
-			point_energy = 0.0;
-			for (i = 0; i < dim_num; i++) {
-				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
-			}
-			cluster_energy[k] = cluster_energy[k] + point_energy;
-		}
+		//  Add up the partial sums in thread order to get the centroids.
 		//
-		//  #3:
-		//  Determine the centroids of the clusters.
-		//
-		centroid = r8vec_zero_new(dim_num * cluster_num);
+		r8vec_zero(dim_num * cluster_num, centroid);
 		i4vec_zero(cluster_num, cluster_population);
 
-		for (j = 0; j < point_num; j++) {
-			k = cluster[j];
-			cluster_population[k] = cluster_population[k] + 1;
-			for (i = 0; i < dim_num; i++) {
-				centroid[i + k*dim_num] = centroid[i + k*dim_num] + point[i + j*dim_num];
+		for (t = 0; t < thread_num; t++) {
+			for (k = 0; k < cluster_num; k++) {
+				cluster_population[k] = cluster_population[k]
+					+ partial_population[k + t*cluster_num];
+				for (i = 0; i < dim_num; i++) {
+					centroid[i + k*dim_num] = centroid[i + k*dim_num]
+						+ partial_centroid[i + k*dim_num + t*dim_num*cluster_num];
+				}
 			}
 		}
 		//
@@ -1228,257 +2218,185 @@ void hmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 				cluster_center[i + k*dim_num] = centroid[i + k*dim_num];
 			}
 		}
-
-		delete[] centroid;
 		//
-		//  #4:
+		//  #3:
 		//  Determine the total energy of the current clustering with new centroids.
 		//
-		r8vec_zero(cluster_num, cluster_energy);
+		threads.clear();
+		for (t = 1; t < thread_num; t++) {
+			threads.push_back(thread(hmeans_03_energy, dim_num,
+				(t * (long long)point_num) / thread_num,
+				((t + 1) * (long long)point_num) / thread_num, cluster_num, point,
+				cluster, cluster_center, partial_energy + t*cluster_num));
+		}
+		hmeans_03_energy(dim_num, 0, point_num / thread_num, cluster_num, point,
+			cluster, cluster_center, partial_energy);
+		for (t = 1; t < thread_num; t++) {
+			threads[t - 1].join();
+		}
 
-		for (j = 0; j < point_num; j++) {
-			k = cluster[j];
+		r8vec_zero(cluster_num, cluster_energy);
 
-			point_energy = 0.0;
-			for (i = 0; i < dim_num; i++) {
-				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+		for (t = 0; t < thread_num; t++) {
+			for (k = 0; k < cluster_num; k++) {
+				cluster_energy[k] = cluster_energy[k] + partial_energy[k + t*cluster_num];
 			}
-			cluster_energy[k] = cluster_energy[k] + point_energy;
 		}
 	}
+
+	delete[] centroid;
+	delete[] partial_centroid;
+	delete[] partial_energy;
+	delete[] partial_population;
+	delete[] swaps;
+
 	return;
 }
 //****************************************************************************80
 
-void hmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
-	int &it_num, double point[], int cluster[], double cluster_center[],
-	int cluster_population[], double cluster_energy[], int *seed)
+void hmeans_03_assign(int dim_num, int point_first, int point_last,
+	int cluster_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double centroid[], int *swap)
 
 	//****************************************************************************80
 	//
 	//  Purpose:
 	//
-	//   HMEANS_02 applies the H-Means algorithm.
+	//   HMEANS_03_ASSIGN carries out the assignment step of HMEANS_03 for a range of points.
 	//
 	//  Discussion:
 	//
-	//    This is a simple routine to group a set of points into K clusters,
-	//    each with a center point, in such a way that the total cluster 
-	//    energy is minimized.  The total cluster energy is the sum of the
-	//    squares of the distances of each point to the center of its cluster.
-	//
-	//    The algorithm begins with an initial estimate for the cluster centers:
-	//
-	//    1. The points are assigned to the nearest cluster centers.
-	//
-	//    2. The iteration exit ( 1 );s if the total energy has not changed 
-	//        significantly, or we have reached the maximum number of iterations.
-	//
-	//    3. Each cluster center is replaced by the centroid of the points
-	//       in the cluster.
-	//
-	//    4. Return to step 1.
-	//
-	//    The algorithm may fail to find the best solution.
+	//    Each point in the range is assigned to the cluster of its nearest
+	//    center.  The populations and the unnormalized centroids of the
+	//    clusters are then summed over the range.
 	//
 	//  Licensing:
 	//
 	//    This code is distributed under the GNU LGPL license. 
 	//
-	//  Modified:
-	//
-	//    08 October 2011
-	//
-	//  Author:
-	//
-	//    John Burkardt
-	//
 	//  Parameters:
 	//
 	//    Input, int DIM_NUM, the number of spatial dimensions.
 	//
-	//    Input, int POINT_NUM, the number of points.
+	//    Input, int POINT_FIRST, POINT_LAST, the first point of the range,
+	//    and one past the last.
 	//
 	//    Input, int CLUSTER_NUM, the number of clusters.
 	//
-	//    Input, int IT_MAX, the maximum number of iterations.
-	//
-	//    Output, int IT_NUM, the number of iterations taken.
-	//
-	//    Input, double POINT[DIM_NUM*POINT_NUM], the coordinates 
-	//    of the points.
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
 	//
-	//    Input/output, int CLUSTER[POINT_NUM].  On input, the user 
-	//    may specify an initial cluster for each point, or leave all entrie of
-	//    CLUSTER set to 0.  On output, CLUSTER contains the index of the
-	//    cluster to which each data point belongs.
+	//    Input/output, int CLUSTER[POINT_NUM], the cluster to which each
+	//    data point belongs.  Only the entries in the range are changed.
 	//
-	//    Input/output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM],
-	//    the coordinates of the cluster centers.
+	//    Input, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the centers.
 	//
-	//    Output, int CLUSTER_POPULATION[CLUSTER_NUM], the number of
-	//    points assigned to each cluster.
+	//    Output, int CLUSTER_POPULATION[CLUSTER_NUM], the number of points
+	//    of the range in each cluster.
 	//
-	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy of 
-	//    the clusters.
+	//    Output, double CENTROID[DIM_NUM*CLUSTER_NUM], the sum of the
+	//    points of the range in each cluster.
 	//
-	//    Input/output, int *SEED, a seed for the random
-	//    number generator.
+	//    Output, int *SWAP, the number of points that changed cluster.
 	//
 {
-	bool debug = false;
 	int i;
 	int j;
 	int k;
 	int k2;
 	double point_energy;
 	double point_energy_min;
-	int swap;
-	//
-	//  Data checks.
-	//
-	if (cluster_num < 1) {
-		cout << "\n";
-		cout << "HMEANS_02 - Fatal error!\n";
-		cout << "  CLUSTER_NUM < 1.\n";
-		exit(1);
-	}
-
-	if (dim_num < 1) {
-		cout << "\n";
-		cout << "HMEANS_02 - Fatal error!\n";
-		cout << "  DIM_NUM < 1.\n";
-		exit(1);
-	}
-
-	if (point_num < 1) {
-		cout << "\n";
-		cout << "HMEANS_02 - Fatal error!\n";
-		cout << "  POINT_NUM < 1.\n";
-		exit(1);
-	}
-
-	if (it_max < 0) {
-		cout << "\n";
-		cout << "HMEANS_02 - Fatal error!\n";
-		cout << "  IT_MAX < 0.\n";
-		exit(1);
-	}
-	//
-	//  On input, legal entries in CLUSTER are preserved, but
-	//  otherwise, each point is assigned to its nearest cluster.
-	//
-	for (j = 0; j < point_num; j++) {
-		if (cluster[j] < 0 || cluster_num <= cluster[j]) {
-			point_energy_min = r8_huge();
-			for (k = 0; k < cluster_num; k++) {
-				point_energy = 0.0;
-				for (i = 0; i < dim_num; i++) {
-					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
-				}
-				if (point_energy < point_energy_min) {
-					point_energy_min = point_energy;
-					cluster[j] = k;
-				}
-			}
-		}
-	}
-
-	it_num = 0;
-
-	for (; ; ) {
-		//
-		//  Given centers, assign points to nearest center.
-		//
-		i4vec_zero(cluster_num, cluster_population);
-		r8vec_zero(cluster_num, cluster_energy);
 
-		swap = 0;
-
-		for (j = 0; j < point_num; j++) {
-			point_energy_min = r8_huge();
-			k = cluster[j];
+	*swap = 0;
 
-			for (k2 = 0; k2 < cluster_num; k2++) {
-				point_energy = 0.0;
-				for (i = 0; i < dim_num; i++) {
-					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k2*dim_num], 2);
-				}
+	for (j = point_first; j < point_last; j++) {
+		point_energy_min = r8_huge();
+		k = cluster[j];
 
-				if (point_energy < point_energy_min) {
-					point_energy_min = point_energy;
-					cluster[j] = k2;
-				}
-			}
-			if (k != cluster[j]) {
-				swap = swap + 1;
+		for (k2 = 0; k2 < cluster_num; k2++) {
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy +
+					r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
 			}
-			k = cluster[j];
-			cluster_energy[k] = cluster_energy[k] + point_energy_min;
-			cluster_population[k] = cluster_population[k] + 1;
-		}
-
-		if (debug) {
-			cout << "  " << setw(3) << it_num
-				<< "  " << setw(14) << r8vec_sum(cluster_num, cluster_energy) << "\n";
-		}
 
-		if (0 < it_num) {
-			if (swap == 0) {
-				break;
+			if (point_energy < point_energy_min) {
+				point_energy_min = point_energy;
+				cluster[j] = k2;
 			}
 		}
 
-		if (it_max <= it_num) {
-			break;
+		if (k != cluster[j]) {
+			*swap = *swap + 1;
 		}
+	}
 
-		it_num = it_num + 1;
-		//
-		//  Given points in cluster, replace center by centroid.
-		//
-		r8vec_zero(dim_num * cluster_num, cluster_center);
-
-		for (j = 0; j < point_num; j++) {
-			k = cluster[j];
-			for (i = 0; i < dim_num; i++) {
-				cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num]
-					+ point[i + j*dim_num];
-			}
-		}
+	r8vec_zero(dim_num * cluster_num, centroid);
+	i4vec_zero(cluster_num, cluster_population);
 
-		for (k = 0; k < cluster_num; k++) {
-			if (cluster_population[k] != 0) {
-				for (i = 0; i < dim_num; i++) {
-					cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num] /
-						(double)(cluster_population[k]);
-				}
-			} else {
-				j = i4_uniform(0, point_num - 1, seed);
-				for (i = 0; i < dim_num; i++) {
-					cluster_center[i + k*dim_num] = point[i + j*dim_num];
-				}
-			}
+	for (j = point_first; j < point_last; j++) {
+		k = cluster[j];
+		cluster_population[k] = cluster_population[k] + 1;
+		for (i = 0; i < dim_num; i++) {
+			centroid[i + k*dim_num] = centroid[i + k*dim_num] + point[i + j*dim_num];
 		}
 	}
+
+	return;
+}
+//****************************************************************************80
+
+void hmeans_03_energy(int dim_num, int point_first, int point_last,
+	int cluster_num, double point[], int cluster[], double cluster_center[],
+	double cluster_energy[])
+
+	//****************************************************************************80
 	//
-	//  Compute the energy based on the final value of the cluster centers.
+	//  Purpose:
+	//
+	//   HMEANS_03_ENERGY sums the cluster energies of HMEANS_03 over a range of points.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Parameters:
 	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_FIRST, POINT_LAST, the first point of the range,
+	//    and one past the last.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
+	//
+	//    Input, int CLUSTER[POINT_NUM], the cluster to which each
+	//    data point belongs.
+	//
+	//    Input, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the centers.
+	//
+	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy of the
+	//    points of the range in each cluster.
+	//
+{
+	int i;
+	int j;
+	int k;
+	double point_energy;
+
 	r8vec_zero(cluster_num, cluster_energy);
 
-	for (j = 0; j < point_num; j++) {
+	for (j = point_first; j < point_last; j++) {
 		k = cluster[j];
 
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
+
 	return;
 }
 //****************************************************************************80
@@ -1640,7 +2558,7 @@ void hmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 				point_energy = 0.0;
 				for (i = 0; i < dim_num; i++) {
 					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+						r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 				}
 
 				if (point_energy < point_energy_min) {
@@ -1670,7 +2588,7 @@ void hmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 				point_energy = 0.0;
 				for (i = 0; i < dim_num; i++) {
 					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k2*dim_num], 2);
+						r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
 				}
 
 				if (point_energy < point_energy_min) {
@@ -1700,7 +2618,7 @@ void hmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 			point_energy = 0.0;
 			for (i = 0; i < dim_num; i++) {
 				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k2*dim_num], 2);
+					r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
 			}
 			energy = energy + weight[j] * point_energy;
 		}
@@ -1759,7 +2677,7 @@ void hmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + weight[j] * point_energy;
 	}
@@ -1920,7 +2838,7 @@ void hmeans_w_02(int dim_num, int point_num, int cluster_num, int it_max,
 				point_energy = 0.0;
 				for (i = 0; i < dim_num; i++) {
 					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+						r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 				}
 				if (point_energy < point_energy_min) {
 					point_energy_min = point_energy;
@@ -1949,7 +2867,7 @@ void hmeans_w_02(int dim_num, int point_num, int cluster_num, int it_max,
 				point_energy = 0.0;
 				for (i = 0; i < dim_num; i++) {
 					point_energy = point_energy +
-						pow(point[i + j*dim_num] - cluster_center[i + k2*dim_num], 2);
+						r8_square(point[i + j*dim_num] - cluster_center[i + k2*dim_num]);
 				}
 
 				if (point_energy < point_energy_min) {
@@ -2017,7 +2935,7 @@ void hmeans_w_02(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + weight[j] * point_energy;
 	}
@@ -2599,7 +3517,7 @@ void kmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 			point_energy = 0.0;
 			for (i = 0; i < dim_num; i++) {
 				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 			}
 
 			if (point_energy < point_energy_min) {
@@ -2646,7 +3564,7 @@ void kmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 	for (j = 0; j < point_num; j++) {
 		k = cluster[j];
 		for (i = 0; i < dim_num; i++) {
-			f[j] = f[j] + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+			f[j] = f[j] + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 	}
 	//
@@ -2693,7 +3611,7 @@ void kmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 				if (k != il) {
 					de = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						de = de + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+						de = de + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 					}
 					de = de * (double)cluster_population[k]
 						/ (double)(cluster_population[k] + 1);
@@ -2738,7 +3656,7 @@ void kmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 				if (k == il || k == ir) {
 					f[j2] = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						f[j2] = f[j2] + pow(point[i + j2*dim_num] - cluster_center[i + k*dim_num], 2);
+						f[j2] = f[j2] + r8_square(point[i + j2*dim_num] - cluster_center[i + k*dim_num]);
 					}
 
 					if (1 < cluster_population[k]) {
@@ -2767,7 +3685,7 @@ void kmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
@@ -2903,7 +3821,7 @@ void kmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
 		for (il = 0; il < 2; il++) {
 			dt[il] = 0.0;
 			for (i = 0; i < dim_num; i++) {
-				dt[il] = dt[il] + pow(point[i + j*dim_num] - cluster_center[i + il*dim_num], 2);
+				dt[il] = dt[il] + r8_square(point[i + j*dim_num] - cluster_center[i + il*dim_num]);
 			}
 		}
 
@@ -2918,7 +3836,7 @@ void kmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
 		for (k = 2; k < cluster_num; k++) {
 			db = 0.0;
 			for (i = 0; i < dim_num; i++) {
-				db = db + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				db = db + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 			}
 
 			if (db < dt[0]) {
@@ -3073,7 +3991,7 @@ void kmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
@@ -3211,7 +4129,7 @@ void kmeans_02_optra(int dim_num, int point_num, int cluster_num,
 			if (ncp[l1] != 0) {
 				d[j] = 0.0;
 				for (i = 0; i < dim_num; i++) {
-					d[j] = d[j] + pow(point[i + j*dim_num] - cluster_center[i + l1*dim_num], 2);
+					d[j] = d[j] + r8_square(point[i + j*dim_num] - cluster_center[i + l1*dim_num]);
 				}
 				d[j] = an1[l1] * d[j];
 			}
@@ -3220,7 +4138,7 @@ void kmeans_02_optra(int dim_num, int point_num, int cluster_num,
 			//
 			r2 = 0.0;
 			for (i = 0; i < dim_num; i++) {
-				r2 = r2 + pow(point[i + j*dim_num] - cluster_center[i + l2*dim_num], 2);
+				r2 = r2 + r8_square(point[i + j*dim_num] - cluster_center[i + l2*dim_num]);
 			}
 			r2 = an2[l2] * r2;
 
@@ -3237,7 +4155,7 @@ void kmeans_02_optra(int dim_num, int point_num, int cluster_num,
 
 					dc = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						dc = dc + pow(point[i + j*dim_num] - cluster_center[i + l*dim_num], 2);
+						dc = dc + r8_square(point[i + j*dim_num] - cluster_center[i + l*dim_num]);
 					}
 
 					if (dc < rr) {
@@ -3430,7 +4348,7 @@ void kmeans_02_qtran(int dim_num, int point_num, int cluster_num,
 				if (step <= ncp[l1]) {
 					d[j] = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						d[j] = d[j] + pow(point[i + j*dim_num] - cluster_center[i + l1*dim_num], 2);
+						d[j] = d[j] + r8_square(point[i + j*dim_num] - cluster_center[i + l1*dim_num]);
 					}
 					d[j] = an1[l1] * d[j];
 				}
@@ -3443,7 +4361,7 @@ void kmeans_02_qtran(int dim_num, int point_num, int cluster_num,
 
 					dd = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						dd = dd + pow(point[i + j*dim_num] - cluster_center[i + l2*dim_num], 2);
+						dd = dd + r8_square(point[i + j*dim_num] - cluster_center[i + l2*dim_num]);
 					}
 					//
 					//  Update cluster centers, NCP, CLUSTER_POPULATION, ITRAN, AN1 and AN2 
@@ -3475,31 +4393,281 @@ void kmeans_02_qtran(int dim_num, int point_num, int cluster_num,
 						cluster_population[l2] = cluster_population[l2] + 1;
 						an2[l1] = alw / al1;
 
-						if (1.0 < alw) {
-							an1[l1] = alw / (alw - 1.0);
-						} else {
-							an1[l1] = r8_huge();
-						}
-						an1[l2] = alt / al2;
-						an2[l2] = alt / (alt + 1.0);
-						cluster[j] = l2;
-						cluster2[j] = l1;
+						if (1.0 < alw) {
+							an1[l1] = alw / (alw - 1.0);
+						} else {
+							an1[l1] = r8_huge();
+						}
+						an1[l2] = alt / al2;
+						an2[l2] = alt / (alt + 1.0);
+						cluster[j] = l2;
+						cluster2[j] = l1;
+					}
+				}
+			}
+			//
+			//  If no re-allocation took place in the last POINT_NUM steps, return.
+			//
+			if (count == point_num) {
+				return;
+			}
+		}
+	}
+	return;
+}
+//****************************************************************************80
+
+void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
+	int &it_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double cluster_energy[])
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   KMEANS_03 applies the K-Means algorithm.
+	//
+	//  Discussion:
+	//
+	//    It is possible for a straightforward K-Means algorithm to
+	//    halt at a non-optimal partition of the points.  This routine
+	//    tries to improve the input partition if possible.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Modified:
+	//
+	//    10 October 2011
+	//
+	//  Author:
+	//
+	//    John Burkardt
+	//
+	//  Reference:
+	//
+	//    Wendy Martinez, Angel Martinez,
+	//    Computational Statistics Handbook with MATLAB,
+	//    pages 373-376,
+	//    Chapman and Hall / CRC, 2002.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int POINT_NUM, the number of data points.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, int IT_MAX, the maximum number of iterations.
+	//
+	//    Output, int IT_NUM, the number of iterations taken.
+	//
+	//    Input, double POINT[DIM_NUM*POINT_NUM], the data points.
+	//
+	//    Output, int CLUSTER[POINT_NUM], the cluster to which
+	//    each point belongs.
+	//
+	//    Input/output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the 
+	//    centers associated with the clustering.  On output, these may 
+	//    have been altered.
+	//
+	//    Output, int CLUSTER_POPULATION[CLUSTER_NUM], the number
+	//    of points in each cluster.
+	//
+	//    Output, double CLUSTER_ENERGY[CLUSTER_NUM], the energy of 
+	//    the clusters.
+	//
+{
+	int ci;
+	int cj;
+	bool debug = true;
+	double *distsq;
+	int i;
+	int j;
+	int k;
+	double point_energy;
+	double point_energy_min;
+	int swap;
+	//
+	//  Check the input.
+	//
+	if (cluster_num < 1) {
+		cout << "\n";
+		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "  CLUSTER_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (dim_num < 1) {
+		cout << "\n";
+		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "  DIM_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (point_num < 1) {
+		cout << "\n";
+		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "  POINT_NUM < 1.\n";
+		exit(1);
+	}
+
+	if (it_max < 0) {
+		cout << "\n";
+		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "  IT_MAX < 0.\n";
+		exit(1);
+	}
+	//
+	//  Assign each point to the nearest cluster center.
+	//
+	for (j = 0; j < point_num; j++) {
+		point_energy_min = r8_huge();
+		cluster[j] = -1;
+
+		for (k = 0; k < cluster_num; k++) {
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy +
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			}
+
+			if (point_energy < point_energy_min) {
+				point_energy_min = point_energy;
+				cluster[j] = k;
+			}
+		}
+	}
+	//
+	//  Determine the cluster populations.
+	//
+	i4vec_zero(cluster_num, cluster_population);
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
+		cluster_population[k] = cluster_population[k] + 1;
+	}
+	//
+	//  Average the points in each cluster to get a new cluster center.
+	//
+	r8vec_zero(dim_num * cluster_num, cluster_center);
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
+		for (i = 0; i < dim_num; i++) {
+			cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num]
+				+ point[i + j*dim_num];
+		}
+	}
+
+	for (k = 0; k < cluster_num; k++) {
+		for (i = 0; i < dim_num; i++) {
+			cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num]
+				/ (double)(cluster_population[k]);
+		}
+	}
+	//
+	//  Carry out the iteration.
+	//
+	it_num = 0;
+	distsq = new double[cluster_num];
+
+	while (it_num < it_max) {
+		it_num = it_num + 1;
+
+		swap = 0;
+
+		for (j = 0; j < point_num; j++) {
+			ci = cluster[j];
+
+			if (cluster_population[ci] <= 1) {
+				continue;
+			}
+
+			for (cj = 0; cj < cluster_num; cj++) {
+				if (cj == ci) {
+					distsq[cj] = 0.0;
+					for (i = 0; i < dim_num; i++) {
+						distsq[cj] = distsq[cj]
+							+ r8_square(point[i + j*dim_num] - cluster_center[i + cj*dim_num]);
+					}
+					distsq[cj] = distsq[cj] * (double)(cluster_population[cj])
+						/ (double)(cluster_population[cj] - 1);
+				} else if (cluster_population[cj] == 0) {
+					for (i = 0; i < dim_num; i++) {
+						cluster_center[i + cj*dim_num] = point[i + j*dim_num];
 					}
+					distsq[cj] = 0.0;
+				} else {
+					distsq[cj] = 0.0;
+					for (i = 0; i < dim_num; i++) {
+						distsq[cj] = distsq[cj]
+							+ r8_square(point[i + j*dim_num] - cluster_center[i + cj*dim_num]);
+					}
+					distsq[cj] = distsq[cj] * (double)(cluster_population[cj])
+						/ (double)(cluster_population[cj] + 1);
 				}
 			}
 			//
-			//  If no re-allocation took place in the last POINT_NUM steps, return.
+			//  Find the index of the minimum value of DISTSQ.
 			//
-			if (count == point_num) {
-				return;
+			k = r8vec_min_index(cluster_num, distsq);
+			//
+			//  If that is not the cluster to which point I now belongs, move it there.
+			//
+			if (k == ci) {
+				continue;
+			}
+
+			cj = k;
+
+			for (i = 0; i < dim_num; i++) {
+				cluster_center[i + ci*dim_num] = ((double)(cluster_population[ci])
+					* cluster_center[i + ci*dim_num] - point[i + j*dim_num])
+					/ (double)(cluster_population[ci] - 1);
+
+				cluster_center[i + cj*dim_num] = ((double)(cluster_population[cj])
+					* cluster_center[i + cj*dim_num] + point[i + j*dim_num])
+					/ (double)(cluster_population[cj] + 1);
 			}
+			cluster_population[ci] = cluster_population[ci] - 1;
+			cluster_population[cj] = cluster_population[cj] + 1;
+
+			cluster[j] = cj;
+			swap = swap + 1;
+		}
+		//
+		//  Exit if no reassignments were made during this iteration.
+		//
+		if (swap == 0) {
+			break;
+		}
+	}
+	//
+	//  Compute the cluster energies.
+	//
+	r8vec_zero(cluster_num, cluster_energy);
+
+	for (j = 0; j < point_num; j++) {
+		k = cluster[j];
+
+		point_energy = 0.0;
+		for (i = 0; i < dim_num; i++) {
+			point_energy = point_energy +
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
+		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
+
+	delete[] distsq;
+
 	return;
 }
 //****************************************************************************80
 
-void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
+void kmeans_04(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], int cluster[], double cluster_center[],
 	int cluster_population[], double cluster_energy[])
 
@@ -3507,27 +4675,48 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 	//
 	//  Purpose:
 	//
-	//   KMEANS_03 applies the K-Means algorithm.
+	//   KMEANS_04 applies the K-Means algorithm of KMEANS_03, skipping points that cannot move.
 	//
 	//  Discussion:
 	//
-	//    It is possible for a straightforward K-Means algorithm to
-	//    halt at a non-optimal partition of the points.  This routine
-	//    tries to improve the input partition if possible.
+	//    This routine makes exactly the same reassignments as KMEANS_03, in
+	//    the same order, and returns the same clustering.
+	//
+	//    KMEANS_03 compares every point with every cluster center on every
+	//    iteration.  This routine splits the centers into groups of about
+	//    ten consecutive centers and, following the Yinyang K-Means variant
+	//    of Elkan and Hamerly's bounds, keeps a lower bound on the distance
+	//    from each point to every center of each group other than its own.
+	//    Each center records the total distance it has moved, with a
+	//    snapshot taken at the start of each of the last HISTORY_NUM
+	//    iterations, so the furthest any center of a group has moved since
+	//    a bound was computed is known.  By the triangle inequality, the
+	//    bound less that distance is still a lower bound.  If even that,
+	//    scaled by the smallest cluster population factor, exceeds the cost
+	//    of the point staying where it is, the point cannot move to any
+	//    center of the group, and the group is not examined.
+	//
+	//    Ties, and anything within a small relative margin of a tie, are
+	//    always examined, so rounding in the bounds cannot change the
+	//    result.  While any cluster is empty, or if a point has not been
+	//    examined for HISTORY_NUM iterations, every center is examined.
 	//
 	//  Licensing:
 	//
 	//    This code is distributed under the GNU LGPL license. 
 	//
-	//  Modified:
-	//
-	//    10 October 2011
-	//
-	//  Author:
+	//  Reference:
 	//
-	//    John Burkardt
+	//    Yufei Ding, Yue Zhao, Xipeng Shen, Madanlal Musuvathi, Todd Mytkowicz,
+	//    Yinyang K-Means: A Drop-In Replacement of the Classic K-Means
+	//    with Consistent Speedup,
+	//    Proceedings of the 32nd International Conference on Machine Learning,
+	//    pages 579-587, 2015.
 	//
-	//  Reference:
+	//    Greg Hamerly,
+	//    Making k-means even faster,
+	//    Proceedings of the 2010 SIAM International Conference on Data Mining,
+	//    pages 130-140.
 	//
 	//    Wendy Martinez, Angel Martinez,
 	//    Computational Statistics Handbook with MATLAB,
@@ -3562,43 +4751,69 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 	//    the clusters.
 	//
 {
+	double bound;
 	int ci;
 	int cj;
-	bool debug = true;
 	double *distsq;
+	double *drift;
+	double *drift_history;
+	double *drift_max;
+	double *drift_pass;
+	int empty_num;
+	int g;
+	int *group;
+	int *group_first;
+	int group_num;
+	int history;
+	int history_num = 8;
 	int i;
 	int j;
 	int k;
+	int l;
+	double *lower;
+	int *nearest;
+	double *nearest_distsq;
+	double old_center;
 	double point_energy;
 	double point_energy_min;
+	int population_min;
+	bool reset;
+	bool scan_all;
+	double *second_distsq;
+	int *seen;
+	bool *skip;
+	double stay_cost;
+	double stay_distsq;
+	int skip_num;
+	double step;
 	int swap;
 	//
 	//  Check the input.
 	//
 	if (cluster_num < 1) {
 		cout << "\n";
-		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "KMEANS_04 - Fatal error!\n";
 		cout << "  CLUSTER_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (dim_num < 1) {
 		cout << "\n";
-		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "KMEANS_04 - Fatal error!\n";
 		cout << "  DIM_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (point_num < 1) {
 		cout << "\n";
-		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "KMEANS_04 - Fatal error!\n";
 		cout << "  POINT_NUM < 1.\n";
 		exit(1);
 	}
 
 	if (it_max < 0) {
 		cout << "\n";
-		cout << "KMEANS_03 - Fatal error!\n";
+		cout << "KMEANS_04 - Fatal error!\n";
 		cout << "  IT_MAX < 0.\n";
 		exit(1);
 	}
@@ -3613,7 +4828,7 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 			point_energy = 0.0;
 			for (i = 0; i < dim_num; i++) {
 				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 			}
 
 			if (point_energy < point_energy_min) {
@@ -3651,15 +4866,71 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 		}
 	}
 	//
-	//  Carry out the iteration.
+	//  Split the centers into groups of consecutive centers.
+	//
+	group_num = i4_max(1, cluster_num / 10);
+	group = new int[cluster_num];
+	group_first = new int[group_num + 1];
+	for (g = 0; g <= group_num; g++) {
+		group_first[g] = (g * cluster_num) / group_num;
+	}
+	for (g = 0; g < group_num; g++) {
+		for (k = group_first[g]; k < group_first[g + 1]; k++) {
+			group[k] = g;
+		}
+	}
+	//
+	//  No bounds are known yet, so every point is examined on the first pass.
 	//
 	it_num = 0;
 	distsq = new double[cluster_num];
+	skip = new bool[group_num];
+	nearest = new int[group_num];
+	nearest_distsq = new double[group_num];
+	second_distsq = new double[group_num];
+	lower = r8vec_zero_new(point_num * group_num);
+	seen = i4vec_zero_new(point_num);
+	drift = r8vec_zero_new(cluster_num);
+	drift_history = r8vec_zero_new(history_num * cluster_num);
+	drift_max = r8vec_zero_new(history_num * group_num);
+	drift_pass = new double[group_num];
 
 	while (it_num < it_max) {
 		it_num = it_num + 1;
 
 		swap = 0;
+		//
+		//  Snapshot how far each center has moved, and find the furthest any
+		//  center of each group has moved since the start of each of the
+		//  last iterations.
+		//
+		history = it_num % history_num;
+		for (k = 0; k < cluster_num; k++) {
+			drift_history[k + history*cluster_num] = drift[k];
+		}
+		for (l = i4_max(1, it_num - history_num + 1); l <= it_num; l++) {
+			for (g = 0; g < group_num; g++) {
+				drift_max[g + (l % history_num)*group_num] = 0.0;
+				for (k = group_first[g]; k < group_first[g + 1]; k++) {
+					drift_max[g + (l % history_num)*group_num] = r8_max(drift_max[g + (l % history_num)*group_num],
+						drift[k] - drift_history[k + (l % history_num)*cluster_num]);
+				}
+			}
+		}
+		r8vec_zero(group_num, drift_pass);
+		//
+		//  Find the smallest nonempty population, which bounds the factor
+		//  applied to the cost of moving to any other cluster.
+		//
+		empty_num = 0;
+		population_min = point_num;
+		for (k = 0; k < cluster_num; k++) {
+			if (cluster_population[k] == 0) {
+				empty_num = empty_num + 1;
+			} else if (cluster_population[k] < population_min) {
+				population_min = cluster_population[k];
+			}
+		}
 
 		for (j = 0; j < point_num; j++) {
 			ci = cluster[j];
@@ -3668,35 +4939,117 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 				continue;
 			}
 
-			for (cj = 0; cj < cluster_num; cj++) {
-				if (cj == ci) {
-					distsq[cj] = 0.0;
-					for (i = 0; i < dim_num; i++) {
-						distsq[cj] = distsq[cj]
-							+ pow(point[i + j*dim_num] - cluster_center[i + cj*dim_num], 2);
+			stay_distsq = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				stay_distsq = stay_distsq
+					+ r8_square(point[i + j*dim_num] - cluster_center[i + ci*dim_num]);
+			}
+			stay_cost = stay_distsq * (double)(cluster_population[ci])
+				/ (double)(cluster_population[ci] - 1);
+			//
+			//  Skip the groups in which no cluster can be cheaper, bringing
+			//  their bounds up to date.  A point that has never been examined
+			//  has no bounds, and no drift has been recorded for SEEN = 0.
+			//
+			scan_all = (0 < empty_num || seen[j] == 0 || history_num <= it_num - seen[j]);
+			skip_num = 0;
+
+			for (g = 0; g < group_num; g++) {
+				skip[g] = false;
+				if (!scan_all) {
+					bound = lower[g + j*group_num]
+						- drift_max[g + (seen[j] % history_num)*group_num] - drift_pass[g];
+					if (0.0 < bound && stay_cost * (1.0 + 1.0E-10)
+						< bound * bound * (double)(population_min) / (double)(population_min + 1)) {
+						skip[g] = true;
+						skip_num = skip_num + 1;
+						lower[g + j*group_num] = bound;
 					}
-					distsq[cj] = distsq[cj] * (double)(cluster_population[cj])
-						/ (double)(cluster_population[cj] - 1);
-				} else if (cluster_population[cj] == 0) {
-					for (i = 0; i < dim_num; i++) {
-						cluster_center[i + cj*dim_num] = point[i + j*dim_num];
+				}
+			}
+			seen[j] = it_num;
+
+			if (skip_num == group_num) {
+				continue;
+			}
+			//
+			//  Examine the clusters of the other groups as KMEANS_03 does,
+			//  also noting the two smallest distances in each group for the
+			//  new bounds.  Clusters in skipped groups cost more than
+			//  staying, so they cannot be the minimum.
+			//
+			reset = false;
+
+			for (g = 0; g < group_num; g++) {
+				if (skip[g]) {
+					for (cj = group_first[g]; cj < group_first[g + 1]; cj++) {
+						distsq[cj] = r8_huge();
 					}
-					distsq[cj] = 0.0;
-				} else {
-					distsq[cj] = 0.0;
-					for (i = 0; i < dim_num; i++) {
-						distsq[cj] = distsq[cj]
-							+ pow(point[i + j*dim_num] - cluster_center[i + cj*dim_num], 2);
+					if (g == group[ci]) {
+						distsq[ci] = stay_cost;
+					}
+					continue;
+				}
+
+				nearest[g] = -1;
+				nearest_distsq[g] = r8_huge();
+				second_distsq[g] = r8_huge();
+
+				for (cj = group_first[g]; cj < group_first[g + 1]; cj++) {
+					if (cj == ci) {
+						distsq[cj] = stay_cost;
+						point_energy = stay_distsq;
+					} else if (cluster_population[cj] == 0) {
+						for (i = 0; i < dim_num; i++) {
+							cluster_center[i + cj*dim_num] = point[i + j*dim_num];
+						}
+						distsq[cj] = 0.0;
+						point_energy = 0.0;
+						reset = true;
+					} else {
+						point_energy = 0.0;
+						for (i = 0; i < dim_num; i++) {
+							point_energy = point_energy
+								+ r8_square(point[i + j*dim_num] - cluster_center[i + cj*dim_num]);
+						}
+						distsq[cj] = point_energy * (double)(cluster_population[cj])
+							/ (double)(cluster_population[cj] + 1);
+					}
+
+					if (point_energy < nearest_distsq[g]) {
+						second_distsq[g] = nearest_distsq[g];
+						nearest_distsq[g] = point_energy;
+						nearest[g] = cj;
+					} else if (point_energy < second_distsq[g]) {
+						second_distsq[g] = point_energy;
 					}
-					distsq[cj] = distsq[cj] * (double)(cluster_population[cj])
-						/ (double)(cluster_population[cj] + 1);
 				}
 			}
 			//
+			//  A center that jumped to this point invalidates every other bound.
+			//
+			if (reset) {
+				r8vec_zero(point_num * group_num, lower);
+			}
+			//
 			//  Find the index of the minimum value of DISTSQ.
 			//
 			k = r8vec_min_index(cluster_num, distsq);
 			//
+			//  Bound the distance to each examined group, other than the cluster
+			//  the point is about to belong to.
+			//
+			for (g = 0; g < group_num; g++) {
+				if (skip[g]) {
+					continue;
+				}
+				if (nearest[g] == k) {
+					lower[g + j*group_num] = sqrt(second_distsq[g]);
+				} else {
+					lower[g + j*group_num] = sqrt(nearest_distsq[g]);
+				}
+			}
+			//
 			//  If that is not the cluster to which point I now belongs, move it there.
 			//
 			if (k == ci) {
@@ -3704,18 +5057,41 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 			}
 
 			cj = k;
+			//
+			//  The old cluster joins the bound of its group.
+			//
+			g = group[ci];
+			lower[g + j*group_num] = r8_min(lower[g + j*group_num], sqrt(stay_distsq));
 
+			step = 0.0;
 			for (i = 0; i < dim_num; i++) {
+				old_center = cluster_center[i + ci*dim_num];
 				cluster_center[i + ci*dim_num] = ((double)(cluster_population[ci])
 					* cluster_center[i + ci*dim_num] - point[i + j*dim_num])
 					/ (double)(cluster_population[ci] - 1);
+				step = step + r8_square(cluster_center[i + ci*dim_num] - old_center);
+			}
+			drift[ci] = drift[ci] + sqrt(step);
+			drift_pass[g] = r8_max(drift_pass[g], drift[ci] - drift_history[ci + history*cluster_num]);
 
+			step = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				old_center = cluster_center[i + cj*dim_num];
 				cluster_center[i + cj*dim_num] = ((double)(cluster_population[cj])
 					* cluster_center[i + cj*dim_num] + point[i + j*dim_num])
 					/ (double)(cluster_population[cj] + 1);
+				step = step + r8_square(cluster_center[i + cj*dim_num] - old_center);
+			}
+			drift[cj] = drift[cj] + sqrt(step);
+			g = group[cj];
+			drift_pass[g] = r8_max(drift_pass[g], drift[cj] - drift_history[cj + history*cluster_num]);
+
+			if (cluster_population[cj] == 0) {
+				empty_num = empty_num - 1;
 			}
 			cluster_population[ci] = cluster_population[ci] - 1;
 			cluster_population[cj] = cluster_population[cj] + 1;
+			population_min = i4_min(population_min, i4_min(cluster_population[ci], cluster_population[cj]));
 
 			cluster[j] = cj;
 			swap = swap + 1;
@@ -3738,17 +5114,133 @@ void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + point_energy;
 	}
 
 	delete[] distsq;
+	delete[] drift;
+	delete[] drift_history;
+	delete[] drift_max;
+	delete[] drift_pass;
+	delete[] group;
+	delete[] group_first;
+	delete[] lower;
+	delete[] nearest;
+	delete[] nearest_distsq;
+	delete[] second_distsq;
+	delete[] seen;
+	delete[] skip;
 
 	return;
 }
 //****************************************************************************80
 
+double kmeans_mini_batch(int dim_num, int batch_num, int cluster_num,
+	double batch[], int batch_cluster[], double cluster_center[],
+	int cluster_count[])
+
+	//****************************************************************************80
+	//
+	//  Purpose:
+	//
+	//   KMEANS_MINI_BATCH updates the cluster centers from one mini-batch of points.
+	//
+	//  Discussion:
+	//
+	//    Each point of the batch is first assigned to its nearest center.
+	//    Each point then pulls its center towards it, with a learning rate
+	//    of one over the number of points that center has been given over
+	//    every batch so far.  Each center is therefore the running mean of
+	//    the points it has been given, and its learning rate falls as it
+	//    settles.
+	//
+	//    The routine only sees one batch at a time, so the points can be
+	//    drawn from a data set of any size without holding it in memory.
+	//
+	//  Licensing:
+	//
+	//    This code is distributed under the GNU LGPL license. 
+	//
+	//  Reference:
+	//
+	//    David Sculley,
+	//    Web-Scale K-Means Clustering,
+	//    Proceedings of the 19th International Conference on World Wide Web,
+	//    pages 1177-1178, 2010.
+	//
+	//  Parameters:
+	//
+	//    Input, int DIM_NUM, the number of spatial dimensions.
+	//
+	//    Input, int BATCH_NUM, the number of points in the batch.
+	//
+	//    Input, int CLUSTER_NUM, the number of clusters.
+	//
+	//    Input, double BATCH[DIM_NUM*BATCH_NUM], the points of the batch.
+	//
+	//    Workspace, int BATCH_CLUSTER[BATCH_NUM].
+	//
+	//    Input/output, double CLUSTER_CENTER[DIM_NUM*CLUSTER_NUM], the
+	//    cluster centers.
+	//
+	//    Input/output, int CLUSTER_COUNT[CLUSTER_NUM], the number of points
+	//    each center has been given.  Set to zero before the first batch.
+	//
+	//    Output, double KMEANS_MINI_BATCH, the sum over the batch of the
+	//    squared distance each update moved its center.
+	//
+{
+	double eta;
+	int i;
+	int j;
+	int k;
+	double movement;
+	double point_energy;
+	double point_energy_min;
+	double step;
+	//
+	//  Assign each point of the batch to the nearest cluster center.
+	//
+	for (j = 0; j < batch_num; j++) {
+		point_energy_min = r8_huge();
+		batch_cluster[j] = -1;
+
+		for (k = 0; k < cluster_num; k++) {
+			point_energy = 0.0;
+			for (i = 0; i < dim_num; i++) {
+				point_energy = point_energy +
+					r8_square(batch[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			}
+
+			if (point_energy < point_energy_min) {
+				point_energy_min = point_energy;
+				batch_cluster[j] = k;
+			}
+		}
+	}
+	//
+	//  Move each center towards its points, by less as it is given more.
+	//
+	movement = 0.0;
+
+	for (j = 0; j < batch_num; j++) {
+		k = batch_cluster[j];
+		cluster_count[k] = cluster_count[k] + 1;
+		eta = 1.0 / (double)(cluster_count[k]);
+
+		for (i = 0; i < dim_num; i++) {
+			step = eta * (batch[i + j*dim_num] - cluster_center[i + k*dim_num]);
+			cluster_center[i + k*dim_num] = cluster_center[i + k*dim_num] + step;
+			movement = movement + step * step;
+		}
+	}
+
+	return movement;
+}
+//****************************************************************************80
+
 void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], double weight[], int cluster[],
 	double cluster_center[], int cluster_population[], double cluster_energy[])
@@ -3906,7 +5398,7 @@ void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 			point_energy = 0.0;
 			for (i = 0; i < dim_num; i++) {
 				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 			}
 
 			if (point_energy < point_energy_min) {
@@ -3955,7 +5447,7 @@ void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 	for (j = 0; j < point_num; j++) {
 		k = cluster[j];
 		for (i = 0; i < dim_num; i++) {
-			f[j] = f[j] + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+			f[j] = f[j] + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 	}
 	//
@@ -4001,7 +5493,7 @@ void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 				if (k != il) {
 					de = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						de = de + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2)
+						de = de + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num])
 							* cluster_weight[k] / (cluster_weight[k] + weight[j]);
 					}
 
@@ -4051,7 +5543,7 @@ void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 				if (k == il || k == ir) {
 					f[j] = 0.0;
 					for (i = 0; i < dim_num; i++) {
-						f[j] = f[j] + pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+						f[j] = f[j] + r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 					}
 					if (weight[j] < cluster_weight[k]) {
 						f[j] = f[j] * cluster_weight[k] / (cluster_weight[k] - weight[j]);
@@ -4078,7 +5570,7 @@ void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + weight[j] * point_energy;
 	}
@@ -4245,7 +5737,7 @@ void kmeans_w_03(int dim_num, int point_num, int cluster_num, int it_max,
 			point_energy = 0.0;
 			for (i = 0; i < dim_num; i++) {
 				point_energy = point_energy +
-					pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+					r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 			}
 
 			if (point_energy < point_energy_min) {
@@ -4309,7 +5801,7 @@ void kmeans_w_03(int dim_num, int point_num, int cluster_num, int it_max,
 					distsq[cj] = 0.0;
 					for (i = 0; i < dim_num; i++) {
 						distsq[cj] = distsq[cj]
-							+ pow(point[i + j*dim_num] - cluster_center[i + cj*dim_num], 2);
+							+ r8_square(point[i + j*dim_num] - cluster_center[i + cj*dim_num]);
 					}
 					distsq[cj] = distsq[cj] * cluster_weight[cj]
 						/ (cluster_weight[cj] - weight[j]);
@@ -4322,7 +5814,7 @@ void kmeans_w_03(int dim_num, int point_num, int cluster_num, int it_max,
 					distsq[cj] = 0.0;
 					for (i = 0; i < dim_num; i++) {
 						distsq[cj] = distsq[cj]
-							+ pow(point[i + j*dim_num] - cluster_center[i + cj*dim_num], 2);
+							+ r8_square(point[i + j*dim_num] - cluster_center[i + cj*dim_num]);
 					}
 					distsq[cj] = distsq[cj] * cluster_weight[cj]
 						/ (cluster_weight[cj] + weight[j]);
@@ -4380,7 +5872,7 @@ void kmeans_w_03(int dim_num, int point_num, int cluster_num, int it_max,
 		point_energy = 0.0;
 		for (i = 0; i < dim_num; i++) {
 			point_energy = point_energy +
-				pow(point[i + j*dim_num] - cluster_center[i + k*dim_num], 2);
+				r8_square(point[i + j*dim_num] - cluster_center[i + k*dim_num]);
 		}
 		cluster_energy[k] = cluster_energy[k] + weight[j] * point_energy;
 	}
@@ -4559,6 +6051,34 @@ double r8_min(double x, double y)
 }
 //****************************************************************************80
 
+double r8_square(double x)
+
+//****************************************************************************80
+//
+//  Purpose:
+//
+//    R8_SQUARE returns the square of an R8.
+//
+//  Discussion:
+//
+//    The distance loops used to call POW(X,2), which some compilers
+//    leave as a library call.  A multiplication is exact and inlines.
+//
+//  Licensing:
+//
+//    This code is distributed under the GNU LGPL license.
+//
+//  Parameters:
+//
+//    Input, double X, the value to square.
+//
+//    Output, double R8_SQUARE, X * X.
+//
+{
+	return x * x;
+}
+//****************************************************************************80
+
 double r8_uniform_01(int *seed)
 
 //****************************************************************************80
@@ -15,8 +15,17 @@ double *cluster_initialize_4(int dim_num, int point_num, int cluster_num,
 	double point[], int *seed);
 double *cluster_initialize_5(int dim_num, int point_num, int cluster_num,
 	double point[], int *seed);
+double *cluster_initialize_6(int dim_num, int point_num, int cluster_num,
+	double point[], int *seed);
+double *cluster_initialize_7(int dim_num, int point_num, int cluster_num,
+	double point[], int *seed);
+double *cluster_initialize_w_6(int dim_num, int point_num, int cluster_num,
+	double point[], double weight[], int *seed);
 void cluster_print_summary(int point_num, int cluster_num,
 	int cluster_population[], double cluster_energy[], double cluster_variance[]);
+void cluster_split(int dim_num, int point_num, int cluster_num, int split_num,
+	double point[], int cluster[], double cluster_center[],
+	double cluster_energy[]);
 double *cluster_variance_compute(int dim_num, int point_num, int cluster_num,
 	double point[], int cluster[], double cluster_center[]);
 int file_column_count(std::string filename);
@@ -27,6 +36,15 @@ void hmeans_01(int dim_num, int point_num, int cluster_num, int it_max,
 void hmeans_02(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], int cluster[], double cluster_center[],
 	int cluster_population[], double cluster_energy[], int *seed);
+void hmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
+	int &it_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double cluster_energy[], int thread_num);
+void hmeans_03_assign(int dim_num, int point_first, int point_last,
+	int cluster_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double centroid[], int *swap);
+void hmeans_03_energy(int dim_num, int point_first, int point_last,
+	int cluster_num, double point[], int cluster[], double cluster_center[],
+	double cluster_energy[]);
 void hmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], double weight[], int cluster[],
 	double cluster_center[], int cluster_population[], double cluster_energy[]);
@@ -60,6 +78,12 @@ void kmeans_02_qtran(int dim_num, int point_num, int cluster_num,
 void kmeans_03(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], int cluster[], double cluster_center[],
 	int cluster_population[], double cluster_energy[]);
+void kmeans_04(int dim_num, int point_num, int cluster_num, int it_max,
+	int &it_num, double point[], int cluster[], double cluster_center[],
+	int cluster_population[], double cluster_energy[]);
+double kmeans_mini_batch(int dim_num, int batch_num, int cluster_num,
+	double batch[], int batch_cluster[], double cluster_center[],
+	int cluster_count[]);
 void kmeans_w_01(int dim_num, int point_num, int cluster_num, int it_max,
 	int &it_num, double point[], double weight[], int cluster[],
 	double cluster_center[], int cluster_population[], double cluster_energy[]);
@@ -70,6 +94,7 @@ int r4_nint(float x);
 double r8_huge();
 double r8_max(double x, double y);
 double r8_min(double x, double y);
+double r8_square(double x);
 double r8_uniform_01(int *seed);
 double *r8mat_data_read(std::string input_filename, int m, int n);
 void r8mat_header_read(std::string input_filename, int *m, int *n);
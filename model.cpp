@@ -0,0 +1,390 @@
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "io.h"
+#include "model.h"
+#include "network.h"
+
+using namespace std;
+
+// The model file format. Bump the version whenever the layout changes.
+#define MODEL_MAGIC	  "RBFMODL"
+#define MODEL_VERSION 1
+
+// The prediction table file format. Bump the version whenever the layout changes.
+#define TABLE_MAGIC	  "RBFTABL"
+#define TABLE_VERSION 1
+
+/*
+ * The header at the start of a model file. See saveModel.
+ *
+ * Members:
+ * char magic[8]					- MODEL_MAGIC, null terminated.
+ * uint32_t version					- MODEL_VERSION.
+ * uint32_t neuronCount				- The number of neurons in the network.
+ * double width						- The width of each RBF neuron.
+ * double normalizationConstants[3]	- The constants the training inputs were normalized with.
+ * uint64_t checksum				- The checksum of the centers followed by the weights.
+ */
+struct ModelHeader {
+	char	 magic[8];
+	uint32_t version;
+	uint32_t neuronCount;
+	double	 width;
+	double	 normalizationConstants[3];
+	uint64_t checksum;
+};
+
+/*
+ * The header at the start of a prediction table file. See savePredictionTable.
+ *
+ * Members:
+ * char magic[8]		 - TABLE_MAGIC, null terminated.
+ * uint32_t version		 - TABLE_VERSION.
+ * uint32_t precision	 - The TablePrecision of the values.
+ * int32_t valueBegin[3] - The smallest dayOfYear, hour and dayOfWeek in the table.
+ * int32_t valueCount[3] - The number of dayOfYears, hours and dayOfWeeks in the table.
+ * double offset		 - The prediction a quantized value of 0 stands for.
+ * double scale			 - The step between quantized values.
+ * uint64_t checksum	 - The checksum of the values.
+ */
+struct TableHeader {
+	char	 magic[8];
+	uint32_t version;
+	uint32_t precision;
+	int32_t	 valueBegin[3];
+	int32_t	 valueCount[3];
+	double	 offset;
+	double	 scale;
+	uint64_t checksum;
+};
+
+/*
+ * Saves a trained network as a model file. Returns false if the file can't be written.
+ *
+ * The file is a header holding the magic "RBFMODL", a format version, the neuron count, the width,
+ * the normalization constants and a 64-bit FNV-1a checksum, followed by the neuronCount x 3 centers
+ * and the neuronCount weights. Values are written in the machine's native byte order.
+ *
+ * Parameters:
+ * char *filename						- The name of the model file to write, replacing any previous one.
+ * const double *normalizationConstants	- The constants the training inputs were normalized with, length 3.
+ * const double *centers				- A matrix of centers, size neuronCount x 3. Stride 3.
+ * const double *weights				- The weight array for the network, length neuronCount.
+ * int neuronCount						- The number of neurons in the network.
+ * double width							- The width of each RBF neuron.
+ */
+bool saveModel(char *filename, const double *normalizationConstants, const double *centers, const double *weights, int neuronCount, double width) {
+	ModelHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, MODEL_MAGIC);
+	header.version	   = MODEL_VERSION;
+	header.neuronCount = neuronCount;
+	header.width	   = width;
+	header.checksum	   = checksum(checksum(14695981039346656037ull, centers, (size_t) neuronCount * 3), weights, neuronCount);
+	memcpy(header.normalizationConstants, normalizationConstants, sizeof(header.normalizationConstants));
+
+	FILE *file = fopen(filename, "wb");
+	bool written = file != NULL
+		&& fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(centers, sizeof(double) * 3, neuronCount, file) == (size_t) neuronCount
+		&& fwrite(weights, sizeof(double), neuronCount, file) == (size_t) neuronCount;
+	if (file != NULL && fclose(file) != 0) {
+		written = false;
+	}
+	return written;
+}
+
+/*
+ * Loads a model file written by saveModel and builds the grid it predicts with. Returns false,
+ * leaving the model unchanged, if the file is missing, truncated, has a different version or fails
+ * its checksum.
+ *
+ * Parameters:
+ * char *filename - The name of the model file.
+ * double cutoff  - The cutoff of the grid, see NeuronGrid. MODEL_CUTOFF keeps every prediction within
+ *					a few parts in 10^8 of max|w| of the dense output.
+ * Model &model	  - The model to fill. Release it with freeModel.
+ */
+bool loadModel(char *filename, double cutoff, Model &model) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	ModelHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0
+		&& header.version == MODEL_VERSION
+		&& header.neuronCount > 0 && header.neuronCount <= (1u << 24)
+		&& header.width > 0;
+	if (!valid) {
+		fclose(file);
+		return false;
+	}
+
+	int		neuronCount = header.neuronCount;
+	double *centers		= (double*) malloc(sizeof(double) * neuronCount * 3);
+	double *weights		= (double*) malloc(sizeof(double) * neuronCount);
+	valid = fread(centers, sizeof(double) * 3, neuronCount, file) == (size_t) neuronCount
+		&& fread(weights, sizeof(double), neuronCount, file) == (size_t) neuronCount
+		&& checksum(checksum(14695981039346656037ull, centers, (size_t) neuronCount * 3), weights, neuronCount) == header.checksum;
+	fclose(file);
+	if (!valid) {
+		free(centers);
+		free(weights);
+		return false;
+	}
+
+	model.neuronCount = neuronCount;
+	model.width		  = header.width;
+	model.centers	  = centers;
+	model.weights	  = weights;
+	memcpy(model.normalizationConstants, header.normalizationConstants, sizeof(model.normalizationConstants));
+
+	buildNeuronGrid(centers, neuronCount, header.width, cutoff, model.grid);
+	model.entryWeights = (double*) malloc(sizeof(double) * model.grid.entryCount);
+	weightsToGrid(model.grid, weights, model.entryWeights);
+	return true;
+}
+
+/*
+ * Releases the memory held by a model.
+ *
+ * Parameters:
+ * Model &model - The model to release.
+ */
+void freeModel(Model &model) {
+	freeNeuronGrid(model.grid);
+	free(model.centers);
+	free(model.weights);
+	free(model.entryWeights);
+	model.centers	   = NULL;
+	model.weights	   = NULL;
+	model.entryWeights = NULL;
+}
+
+/*
+ * Predicts the demand for a single hour. Nothing is allocated, so this can be called inline from
+ * latency sensitive code.
+ *
+ * Parameters:
+ * const Model &model - The model to predict with.
+ * int dayOfYear	  - The day of the year, as in the data files.
+ * int hour			  - The hour of the day.
+ * int dayOfWeek	  - The day of the week.
+ */
+double predictModel(const Model &model, int dayOfYear, int hour, int dayOfWeek) {
+	// Normalize the input exactly as the data files were when the model was trained.
+	double input[] = { dayOfYear / model.normalizationConstants[0], hour / model.normalizationConstants[1], dayOfWeek / model.normalizationConstants[2] };
+
+	double activationSum = 0, weightedSum = 0;
+	gridForward(model.grid, input, model.weights, model.entryWeights, activationSum, weightedSum);
+	return weightedSum / activationSum;
+}
+
+/*
+ * Returns the number of bytes the values of a prediction table take, rounded up to a whole number of
+ * 8-byte words so they can be checksummed like doubles.
+ *
+ * Parameters:
+ * TablePrecision precision - How the predictions are stored.
+ * const int *valueCount	- The number of values along each dimension, length 3.
+ */
+static size_t tableBytes(TablePrecision precision, const int *valueCount) {
+	size_t count = (size_t) valueCount[0] * valueCount[1] * valueCount[2];
+	size_t bytes = count * (precision == TABLE_QUANTIZED ? sizeof(uint16_t) : sizeof(double));
+	return (bytes + 7) / 8 * 8;
+}
+
+/*
+ * Evaluates a model for every input in the calendar domain and stores the predictions in a table.
+ * The network is evaluated densely, looking the activations up in ActivationTables. Returns the
+ * largest difference between a stored prediction and the network's.
+ *
+ * Parameters:
+ * const Model &model		- The model to compile.
+ * TablePrecision precision - How the predictions are stored.
+ * PredictionTable &table	- The table to fill. Release it with freePredictionTable.
+ */
+double compilePredictionTable(const Model &model, TablePrecision precision, PredictionTable &table) {
+	const int valueBegin[] = TABLE_VALUE_BEGIN, valueCount[] = TABLE_VALUE_COUNT;
+	int count = valueCount[0] * valueCount[1] * valueCount[2];
+
+	// List every input in the table's order, normalized as the data files are.
+	double *input		= (double*) malloc(sizeof(double) * count * 3);
+	double *predictions = (double*) malloc(sizeof(double) * count);
+	int index = 0;
+	for (int x = 0; x < valueCount[0]; x++) {
+		for (int y = 0; y < valueCount[1]; y++) {
+			for (int z = 0; z < valueCount[2]; z++, index++) {
+				input[index * 3]	 = (valueBegin[0] + x) / model.normalizationConstants[0];
+				input[index * 3 + 1] = (valueBegin[1] + y) / model.normalizationConstants[1];
+				input[index * 3 + 2] = (valueBegin[2] + z) / model.normalizationConstants[2];
+			}
+		}
+	}
+
+	ActivationTables tables;
+	ActivationMatrix activations;
+	buildActivationTables(model.centers, model.neuronCount, model.width, model.normalizationConstants, tables);
+	allocateActivationMatrix(activations, ACTIVATIONS_RECOMPUTE, ACTIVATIONS_SAMPLE_MAJOR, count, model.neuronCount);
+	activations.tables = &tables;
+	getOutput(input, count, model.neuronCount, model.centers, model.weights, model.width, activations, predictions);
+	freeActivationMatrix(activations);
+	freeActivationTables(tables);
+
+	table.precision = precision;
+	table.offset	= 0;
+	table.scale		= 0;
+	table.values	= calloc(tableBytes(precision, valueCount), 1);
+	memcpy(table.valueBegin, valueBegin, sizeof(table.valueBegin));
+	memcpy(table.valueCount, valueCount, sizeof(table.valueCount));
+
+	double maxError = 0;
+	if (precision == TABLE_QUANTIZED) {
+		// Spread the 16-bit values evenly over the range of the predictions.
+		double lowest = predictions[0], highest = predictions[0];
+		for (int i = 1; i < count; i++) {
+			lowest	= fmin(lowest, predictions[i]);
+			highest = fmax(highest, predictions[i]);
+		}
+		table.offset = lowest;
+		table.scale	 = (highest - lowest) / 65535;
+
+		uint16_t *values = (uint16_t*) table.values;
+		for (int i = 0; i < count; i++) {
+			values[i] = table.scale > 0 ? (uint16_t) lround((predictions[i] - lowest) / table.scale) : 0;
+			maxError  = fmax(maxError, fabs(table.offset + table.scale * values[i] - predictions[i]));
+		}
+	} else {
+		memcpy(table.values, predictions, sizeof(double) * count);
+	}
+
+	free(input);
+	free(predictions);
+	return maxError;
+}
+
+/*
+ * Saves a prediction table. Returns false if the file can't be written.
+ *
+ * The file is a header holding the magic "RBFTABL", a format version, the precision, the domain, the
+ * quantization and a 64-bit FNV-1a checksum of the values as 8-byte words, followed by the values.
+ * Values are written in the machine's native byte order.
+ *
+ * Parameters:
+ * char *filename				 - The name of the table file to write, replacing any previous one.
+ * const PredictionTable &table	 - The table to save.
+ */
+bool savePredictionTable(char *filename, const PredictionTable &table) {
+	size_t bytes = tableBytes(table.precision, table.valueCount);
+
+	TableHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, TABLE_MAGIC);
+	header.version	 = TABLE_VERSION;
+	header.precision = table.precision;
+	header.offset	 = table.offset;
+	header.scale	 = table.scale;
+	header.checksum	 = checksum(14695981039346656037ull, (const double*) table.values, bytes / 8);
+	for (int i = 0; i < 3; i++) {
+		header.valueBegin[i] = table.valueBegin[i];
+		header.valueCount[i] = table.valueCount[i];
+	}
+
+	FILE *file = fopen(filename, "wb");
+	bool written = file != NULL
+		&& fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(table.values, 1, bytes, file) == bytes;
+	if (file != NULL && fclose(file) != 0) {
+		written = false;
+	}
+	return written;
+}
+
+/*
+ * Loads a table file written by savePredictionTable. Returns false, leaving the table unchanged, if
+ * the file is missing, truncated, has a different version or fails its checksum.
+ *
+ * Parameters:
+ * char *filename		  - The name of the table file.
+ * PredictionTable &table - The table to fill. Release it with freePredictionTable.
+ */
+bool loadPredictionTable(char *filename, PredictionTable &table) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	TableHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) == 0
+		&& header.version == TABLE_VERSION
+		&& (header.precision == TABLE_DOUBLE || header.precision == TABLE_QUANTIZED);
+	for (int i = 0; valid && i < 3; i++) {
+		valid = header.valueCount[i] > 0 && header.valueCount[i] <= (1 << 10);
+	}
+	if (!valid) {
+		fclose(file);
+		return false;
+	}
+
+	int	   valueCount[] = { header.valueCount[0], header.valueCount[1], header.valueCount[2] };
+	size_t bytes		= tableBytes((TablePrecision) header.precision, valueCount);
+	void  *values		= malloc(bytes);
+	valid = fread(values, 1, bytes, file) == bytes
+		&& checksum(14695981039346656037ull, (const double*) values, bytes / 8) == header.checksum;
+	fclose(file);
+	if (!valid) {
+		free(values);
+		return false;
+	}
+
+	table.precision = (TablePrecision) header.precision;
+	table.offset	= header.offset;
+	table.scale		= header.scale;
+	table.values	= values;
+	for (int i = 0; i < 3; i++) {
+		table.valueBegin[i] = header.valueBegin[i];
+		table.valueCount[i] = header.valueCount[i];
+	}
+	return true;
+}
+
+/*
+ * Releases the memory held by a prediction table.
+ *
+ * Parameters:
+ * PredictionTable &table - The table to release.
+ */
+void freePredictionTable(PredictionTable &table) {
+	free(table.values);
+	table.values = NULL;
+}
+
+/*
+ * Looks up the prediction for a single hour. Returns NaN if the hour is outside the table, so the
+ * caller can fall back to predictModel.
+ *
+ * Parameters:
+ * const PredictionTable &table - The table to predict with.
+ * int dayOfYear				- The day of the year, as in the data files.
+ * int hour						- The hour of the day.
+ * int dayOfWeek				- The day of the week.
+ */
+double predictTable(const PredictionTable &table, int dayOfYear, int hour, int dayOfWeek) {
+	// Negative offsets wrap around to large unsigned ones, so one comparison checks both ends.
+	unsigned x = (unsigned) dayOfYear - table.valueBegin[0], y = (unsigned) hour - table.valueBegin[1], z = (unsigned) dayOfWeek - table.valueBegin[2];
+	if (x >= (unsigned) table.valueCount[0] || y >= (unsigned) table.valueCount[1] || z >= (unsigned) table.valueCount[2]) {
+		return NAN;
+	}
+
+	size_t index = ((size_t) x * table.valueCount[1] + y) * table.valueCount[2] + z;
+	if (table.precision == TABLE_QUANTIZED) {
+		return table.offset + table.scale * ((const uint16_t*) table.values)[index];
+	}
+	return ((const double*) table.values)[index];
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "grid.h"
+#include "tables.h"
+
+// The cutoff, in widths, of the grid a loaded model predicts with. See NeuronGrid.
+#define MODEL_CUTOFF 6
+
+/*
+ * How the predictions in a PredictionTable are stored.
+ *
+ * TABLE_DOUBLE	   - 8 bytes per prediction, exactly as the network gives them.
+ * TABLE_QUANTIZED - 2 bytes per prediction, spread evenly between the smallest and largest prediction.
+ *					 Within (largest - smallest) / 131070 of the network, and small enough to stay in L2.
+ */
+enum TablePrecision {
+	TABLE_DOUBLE,
+	TABLE_QUANTIZED
+};
+
+/*
+ * A trained network loaded for prediction. The centers are bucketed into a grid when the model is
+ * loaded, so each prediction only evaluates the neurons near its input, and needs no memory of its
+ * own. A loaded model is only read by predictModel, so it can be shared between threads.
+ *
+ * Members:
+ * int neuronCount					 - The number of neurons in the network.
+ * double width						 - The width of each RBF neuron.
+ * double normalizationConstants[3]	 - The constants the training inputs were normalized with.
+ * double *centers					 - A matrix of centers, size neuronCount x 3. Stride 3.
+ * double *weights					 - The weight array for the network, length neuronCount.
+ * NeuronGrid grid					 - The centers bucketed into a grid.
+ * double *entryWeights				 - The weights in the order of the grid's entries, see weightsToGrid.
+ */
+struct Model {
+	int			neuronCount;
+	double		width;
+	double		normalizationConstants[3];
+	double	   *centers;
+	double	   *weights;
+	NeuronGrid	grid;
+	double	   *entryWeights;
+};
+
+/*
+ * The prediction of a model for every input it can be asked about, which are the integer calendar
+ * values tabulated by ActivationTables, so a prediction is a single indexed load whatever the number
+ * of neurons. A table is only read by predictTable, so it can be shared between threads.
+ *
+ * Members:
+ * TablePrecision precision	- How the predictions are stored.
+ * int valueBegin[3]		- The smallest dayOfYear, hour and dayOfWeek in the table.
+ * int valueCount[3]		- The number of dayOfYears, hours and dayOfWeeks in the table.
+ * double offset			- The prediction a quantized value of 0 stands for. Only used by TABLE_QUANTIZED.
+ * double scale				- The step between quantized values. Only used by TABLE_QUANTIZED.
+ * void *values				- The predictions, with the dayOfWeek varying fastest and the dayOfYear
+ *							  slowest. Room for a multiple of 8 bytes, see savePredictionTable.
+ */
+struct PredictionTable {
+	TablePrecision precision;
+	int			   valueBegin[3];
+	int			   valueCount[3];
+	double		   offset;
+	double		   scale;
+	void		  *values;
+};
+
+/*
+ * Saves a trained network as a model file. Returns false if the file can't be written.
+ *
+ * The file is a header holding the magic "RBFMODL", a format version, the neuron count, the width,
+ * the normalization constants and a 64-bit FNV-1a checksum, followed by the neuronCount x 3 centers
+ * and the neuronCount weights. Values are written in the machine's native byte order.
+ *
+ * Parameters:
+ * char *filename						- The name of the model file to write, replacing any previous one.
+ * const double *normalizationConstants	- The constants the training inputs were normalized with, length 3.
+ * const double *centers				- A matrix of centers, size neuronCount x 3. Stride 3.
+ * const double *weights				- The weight array for the network, length neuronCount.
+ * int neuronCount						- The number of neurons in the network.
+ * double width							- The width of each RBF neuron.
+ */
+bool saveModel(char *filename, const double *normalizationConstants, const double *centers, const double *weights, int neuronCount, double width);
+
+/*
+ * Loads a model file written by saveModel and builds the grid it predicts with. Returns false,
+ * leaving the model unchanged, if the file is missing, truncated, has a different version or fails
+ * its checksum.
+ *
+ * Parameters:
+ * char *filename - The name of the model file.
+ * double cutoff  - The cutoff of the grid, see NeuronGrid. MODEL_CUTOFF keeps every prediction within
+ *					a few parts in 10^8 of max|w| of the dense output.
+ * Model &model	  - The model to fill. Release it with freeModel.
+ */
+bool loadModel(char *filename, double cutoff, Model &model);
+
+/*
+ * Releases the memory held by a model.
+ *
+ * Parameters:
+ * Model &model - The model to release.
+ */
+void freeModel(Model &model);
+
+/*
+ * Predicts the demand for a single hour. Nothing is allocated, so this can be called inline from
+ * latency sensitive code.
+ *
+ * Parameters:
+ * const Model &model - The model to predict with.
+ * int dayOfYear	  - The day of the year, as in the data files.
+ * int hour			  - The hour of the day.
+ * int dayOfWeek	  - The day of the week.
+ */
+double predictModel(const Model &model, int dayOfYear, int hour, int dayOfWeek);
+
+/*
+ * Evaluates a model for every input in the calendar domain and stores the predictions in a table.
+ * The network is evaluated densely, looking the activations up in ActivationTables. Returns the
+ * largest difference between a stored prediction and the network's.
+ *
+ * Parameters:
+ * const Model &model		- The model to compile.
+ * TablePrecision precision - How the predictions are stored.
+ * PredictionTable &table	- The table to fill. Release it with freePredictionTable.
+ */
+double compilePredictionTable(const Model &model, TablePrecision precision, PredictionTable &table);
+
+/*
+ * Saves a prediction table. Returns false if the file can't be written.
+ *
+ * The file is a header holding the magic "RBFTABL", a format version, the precision, the domain, the
+ * quantization and a 64-bit FNV-1a checksum of the values as 8-byte words, followed by the values.
+ * Values are written in the machine's native byte order.
+ *
+ * Parameters:
+ * char *filename				 - The name of the table file to write, replacing any previous one.
+ * const PredictionTable &table	 - The table to save.
+ */
+bool savePredictionTable(char *filename, const PredictionTable &table);
+
+/*
+ * Loads a table file written by savePredictionTable. Returns false, leaving the table unchanged, if
+ * the file is missing, truncated, has a different version or fails its checksum.
+ *
+ * Parameters:
+ * char *filename		  - The name of the table file.
+ * PredictionTable &table - The table to fill. Release it with freePredictionTable.
+ */
+bool loadPredictionTable(char *filename, PredictionTable &table);
+
+/*
+ * Releases the memory held by a prediction table.
+ *
+ * Parameters:
+ * PredictionTable &table - The table to release.
+ */
+void freePredictionTable(PredictionTable &table);
+
+/*
+ * Looks up the prediction for a single hour. Returns NaN if the hour is outside the table, so the
+ * caller can fall back to predictModel.
+ *
+ * Parameters:
+ * const PredictionTable &table - The table to predict with.
+ * int dayOfYear				- The day of the year, as in the data files.
+ * int hour						- The hour of the day.
+ * int dayOfWeek				- The day of the week.
+ */
+double predictTable(const PredictionTable &table, int dayOfYear, int hour, int dayOfWeek);
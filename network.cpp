@@ -1,9 +1,248 @@
 #include <stdio.h>
 #include <cmath>
 #include <float.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "activation.h"
+#include "network.h"
+
+// The tile sizes of the batched forward pass. A block of 256 neurons is 8KB of centers & weights.
+#define FORWARD_SAMPLE_BLOCK 64
+#define FORWARD_NEURON_BLOCK 256
+
+// The row stride of the tile used to transpose neuron-major activations. Padded so the rows don't all
+// map to the same cache sets.
+#define FORWARD_TILE_STRIDE (FORWARD_NEURON_BLOCK + 8)
+
+// The number of rows of the activation matrix solveWeights accumulates at once.
+#define SOLVE_BLOCK 64
+
+// Normalized activations below this are treated as zero by solveWeights. Their products are far below
+// rounding error, and would otherwise be slow subnormal numbers.
+#define SOLVE_EPSILON 1e-12
 
 using namespace std;
 
+/*
+ * Returns the number of bytes each stored activation takes.
+ *
+ * Parameters:
+ * ActivationStorage storage - How the activations are stored.
+ */
+static size_t activationSize(ActivationStorage storage) {
+	switch (storage) {
+	case ACTIVATIONS_DOUBLE:	return sizeof(double);
+	case ACTIVATIONS_FLOAT:		return sizeof(float);
+	case ACTIVATIONS_BFLOAT16:	return sizeof(uint16_t);
+	default:					return 0;
+	}
+}
+
+/*
+ * Rounds a value to the nearest bfloat16, which is the top 16 bits of the float.
+ *
+ * Parameters:
+ * double value - The value to round. Activations are never NaN.
+ */
+static inline uint16_t toBfloat16(double value) {
+	float single = (float) value;
+	uint32_t bits;
+	memcpy(&bits, &single, sizeof(bits));
+	bits += 0x7FFF + ((bits >> 16) & 1);
+	return (uint16_t) (bits >> 16);
+}
+
+/*
+ * Widens a bfloat16 back to a double.
+ *
+ * Parameters:
+ * uint16_t value - The bfloat16 to widen.
+ */
+static inline double fromBfloat16(uint16_t value) {
+	uint32_t bits = (uint32_t) value << 16;
+	float single;
+	memcpy(&single, &bits, sizeof(single));
+	return single;
+}
+
+/*
+ * Returns the position of an activation in the values of a matrix.
+ *
+ * Parameters:
+ * const ActivationMatrix &activations - The activation matrix.
+ * int dataIndex					   - The sample.
+ * int neuronIndex					   - The neuron.
+ */
+static inline size_t activationOffset(const ActivationMatrix &activations, int dataIndex, int neuronIndex) {
+	if (activations.layout == ACTIVATIONS_NEURON_MAJOR) {
+		return (size_t) neuronIndex * activations.sampleCount + dataIndex;
+	}
+	return (size_t) dataIndex * activations.neuronCount + neuronIndex;
+}
+
+/*
+ * Converts a run of activations to a storage type and writes them to consecutive positions.
+ *
+ * Parameters:
+ * ActivationStorage storage - The storage type to convert to.
+ * const double *source		 - The first activation to store.
+ * int sourceStride			 - The distance between consecutive activations in source.
+ * void *values				 - The values of the matrix to store into.
+ * size_t offset			 - The position in values of the first activation.
+ * int count				 - The number of activations to store.
+ */
+static void storeRun(ActivationStorage storage, const double *source, int sourceStride, void *values, size_t offset, int count) {
+	if (storage == ACTIVATIONS_DOUBLE) {
+		double *destination = (double*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i] = source[i * sourceStride];
+		}
+	} else if (storage == ACTIVATIONS_FLOAT) {
+		float *destination = (float*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i] = (float) source[i * sourceStride];
+		}
+	} else if (storage == ACTIVATIONS_BFLOAT16) {
+		uint16_t *destination = (uint16_t*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i] = toBfloat16(source[i * sourceStride]);
+		}
+	}
+}
+
+/*
+ * Reads a run of consecutive stored activations and widens them to double.
+ *
+ * Parameters:
+ * ActivationStorage storage - The storage type to convert from.
+ * const void *values		 - The values of the matrix to load from.
+ * size_t offset			 - The position in values of the first activation.
+ * int count				 - The number of activations to load.
+ * double *destination		 - Where to write the first activation.
+ * int destinationStride	 - The distance between consecutive activations in destination.
+ */
+static void loadRun(ActivationStorage storage, const void *values, size_t offset, int count, double *destination, int destinationStride) {
+	if (storage == ACTIVATIONS_DOUBLE) {
+		const double *source = (const double*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i * destinationStride] = source[i];
+		}
+	} else if (storage == ACTIVATIONS_FLOAT) {
+		const float *source = (const float*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i * destinationStride] = source[i];
+		}
+	} else if (storage == ACTIVATIONS_BFLOAT16) {
+		const uint16_t *source = (const uint16_t*) values + offset;
+		for (int i = 0; i < count; i++) {
+			destination[i * destinationStride] = fromBfloat16(source[i]);
+		}
+	}
+}
+
+/*
+ * Copies a sample-major tile of activations into a matrix, converting them to its storage type.
+ *
+ * Parameters:
+ * ActivationMatrix &activations - The matrix to store into. Must not be ACTIVATIONS_RECOMPUTE.
+ * const double *tile			 - The activations. tile[0] is sample sampleBegin, neuron neuronBegin.
+ * int tileStride				 - The distance between the rows of the tile.
+ * int sampleBegin				 - The first sample in the tile.
+ * int sampleEnd				 - One past the last sample in the tile.
+ * int neuronBegin				 - The first neuron in the tile.
+ * int neuronEnd				 - One past the last neuron in the tile.
+ */
+static void storeActivations(ActivationMatrix &activations, const double *tile, int tileStride, int sampleBegin, int sampleEnd, int neuronBegin, int neuronEnd) {
+	// Each run is contiguous in the matrix: a column of the tile when neuron-major, a row otherwise.
+	if (activations.layout == ACTIVATIONS_NEURON_MAJOR) {
+		for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+			storeRun(activations.storage, tile + neuronIndex - neuronBegin, tileStride, activations.values,
+				activationOffset(activations, sampleBegin, neuronIndex), sampleEnd - sampleBegin);
+		}
+	} else {
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			storeRun(activations.storage, tile + (dataIndex - sampleBegin) * tileStride, 1, activations.values,
+				activationOffset(activations, dataIndex, neuronBegin), neuronEnd - neuronBegin);
+		}
+	}
+}
+
+/*
+ * Fills a sample-major tile with activations from a matrix, widening them to double, or recomputing
+ * them for ACTIVATIONS_RECOMPUTE.
+ *
+ * Parameters:
+ * const ActivationMatrix &activations - The matrix to load from.
+ * const double *soaCenters			   - The matrix's centers in structure-of-arrays form. Only used
+ *										 for ACTIVATIONS_RECOMPUTE.
+ * int sampleBegin					   - The first sample to load.
+ * int sampleEnd					   - One past the last sample to load.
+ * int neuronBegin					   - The first neuron to load.
+ * int neuronEnd					   - One past the last neuron to load.
+ * double *tile						   - The tile to fill. tile[0] is sample sampleBegin, neuron neuronBegin.
+ * int tileStride					   - The distance between the rows of the tile.
+ */
+static void loadActivations(const ActivationMatrix &activations, const double *soaCenters, int sampleBegin, int sampleEnd, int neuronBegin, int neuronEnd, double *tile, int tileStride) {
+	if (activations.storage == ACTIVATIONS_RECOMPUTE) {
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			const double *input = activations.input + dataIndex * 3;
+			double		 *row	= tile + (dataIndex - sampleBegin) * tileStride;
+			if (!activations.tables || !tableActivations(*activations.tables, input, neuronBegin, neuronEnd, row)) {
+				rbfActivations(input, soaCenters, activations.neuronCount, neuronBegin, neuronEnd, activations.width, row);
+			}
+		}
+	} else if (activations.layout == ACTIVATIONS_NEURON_MAJOR) {
+		for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+			loadRun(activations.storage, activations.values, activationOffset(activations, sampleBegin, neuronIndex),
+				sampleEnd - sampleBegin, tile + neuronIndex - neuronBegin, tileStride);
+		}
+	} else {
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			loadRun(activations.storage, activations.values, activationOffset(activations, dataIndex, neuronBegin),
+				neuronEnd - neuronBegin, tile + (dataIndex - sampleBegin) * tileStride, 1);
+		}
+	}
+}
+
+/*
+ * Allocates an activation matrix big enough for maxSampleCount samples and maxNeuronCount neurons.
+ *
+ * Parameters:
+ * ActivationMatrix &activations - The matrix to allocate. Release it with freeActivationMatrix.
+ * ActivationStorage storage	 - How each value is stored.
+ * ActivationLayout layout		 - How the values are laid out.
+ * int maxSampleCount			 - The largest number of samples the matrix will hold.
+ * int maxNeuronCount			 - The largest number of neurons the matrix will hold.
+ */
+void allocateActivationMatrix(ActivationMatrix &activations, ActivationStorage storage, ActivationLayout layout, int maxSampleCount, int maxNeuronCount) {
+	activations.values		= storage == ACTIVATIONS_RECOMPUTE ? NULL : malloc(activationSize(storage) * maxSampleCount * maxNeuronCount);
+	activations.storage		= storage;
+	activations.layout		= layout;
+	activations.sampleCount = 0;
+	activations.neuronCount = 0;
+	activations.input		= NULL;
+	activations.centers		= NULL;
+	activations.width		= 0;
+	activations.activationSums = storage == ACTIVATIONS_RECOMPUTE ? NULL : (double*) malloc(sizeof(double) * maxSampleCount);
+	activations.tables		   = NULL;
+}
+
+/*
+ * Releases the memory held by an activation matrix.
+ *
+ * Parameters:
+ * ActivationMatrix &activations - The matrix to release.
+ */
+void freeActivationMatrix(ActivationMatrix &activations) {
+	free(activations.values);
+	free(activations.activationSums);
+	activations.values		   = NULL;
+	activations.activationSums = NULL;
+}
+
 /*
  * Calculates the sum of a single-dimension array.
  *
@@ -14,7 +253,18 @@ using namespace std;
 double sum(double *vector, int size);
 
 /*
- * Calculates a root-mean-squared error for the given target & output.
+ * Calculates the dot product of two single-dimension arrays.
+ *
+ * Parameters:
+ * const double *a - The first array.
+ * const double *b - The second array.
+ * int size		   - The size of the two arrays.
+ */
+double dot(const double *a, const double *b, int size);
+
+/*
+ * Calculates a root-mean-squared error for the given target & output. The squares are summed in
+ * double, as a float sum loses digits over a data set this size.
  *
  * Parameters:
  * double *target - The array of target values.
@@ -22,11 +272,12 @@ double sum(double *vector, int size);
  * int size		  - The size of the two arrays.
  */
 float calculateError(double *target, double *output, int size) {
-	float rms = 0.0f;
+	double squaredError = 0;
 	for (int dataIndex = 0; dataIndex < size; dataIndex++) {
-		rms += pow(target[dataIndex] - output[dataIndex], 2);
-	}	
-	return sqrt(rms / size);
+		double residual = target[dataIndex] - output[dataIndex];
+		squaredError += residual * residual;
+	}
+	return (float) sqrt(squaredError / size);
 }
 
 /*
@@ -43,19 +294,14 @@ float calculateError(double *target, double *output, int size) {
  */
 double getOutput(int dataIndex, double *input, int neuronCount, double *centers, double *weights, double width, double *outputValues, double *activationValues) {
 	double activationSum = 0, activationValue;
+	double scale = -1.0 / (2 * width * width);
 	for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
-		// Get the center values for the neuron.
+		// Find the squared distance of the input from the neuron center.
 		int index = neuronIndex * 3;
-		double neuronCenter[] = { centers[index], centers[index + 1], centers[index + 2] };
-
-		// Find the squared difference of the input compared to the neuron centers.
-		double squareDiffs[] = { pow(neuronCenter[0] - input[0], 2), pow(neuronCenter[1] - input[1], 2), pow(neuronCenter[2] - input[2], 2) };
+		double diffs[] = { centers[index] - input[0], centers[index + 1] - input[1], centers[index + 2] - input[2] };
 
-		// Calculate the activation value for the neuron by multiplying together the activation value for each dimension.
-		activationValue = 1;
-		for (int i = 0; i < 3; i++) {
-			activationValue *= exp(-squareDiffs[i] / (2 * pow(width, 2)));
-		}
+		// The activation is the product of a gaussian in each dimension, which is a single exp of the total distance.
+		activationValue = exp((diffs[0] * diffs[0] + diffs[1] * diffs[1] + diffs[2] * diffs[2]) * scale);
 
 		// Store the activation and output value for this neuron and increase the total activation sum.
 		activationSum += activationValues[dataIndex * neuronCount + neuronIndex] = activationValue;
@@ -69,43 +315,458 @@ double getOutput(int dataIndex, double *input, int neuronCount, double *centers,
 /*
  * Calculates the output of the network for an input data matrix.
  *
+ * The samples are processed in tiles of FORWARD_SAMPLE_BLOCK samples against FORWARD_NEURON_BLOCK
+ * neurons, so that the block of centers & weights stays in L1 while every sample in the tile uses it.
+ * The activation sums and weighted outputs are accumulated per sample rather than written out and re-summed.
+ *
  * Parameters:
- * double *input			- An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
- * int inputCount			- The number of input data points.
- * int neuronCount			- The number of RBF neurons in the network.
- * double *centers			- An matrix of centers, size neuronCount x 3. Stride 3.
- * double *weights			- An array of weights, size neuronCount.
- * double width				- The width of each RBF neuron.
- * double *outputValues		- An array to hold a partial sum for the output. Re-use for performance.
- * double *activationValues - An array to hold a partial sum for the output. Re-use for performance.
- * double *output			- A preallocated array to hold the result. Length is inputCount.
+ * double *input				 - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount				 - The number of input data points.
+ * int neuronCount				 - The number of RBF neurons in the network.
+ * double *centers				 - An matrix of centers, size neuronCount x 3. Stride 3.
+ * double *weights				 - An array of weights, size neuronCount.
+ * double width					 - The width of each RBF neuron.
+ * ActivationMatrix &activations - A preallocated matrix to hold the activation values, in its own layout
+ *								   & storage. The input, centers & width are recorded for recomputing them.
+ * double *output				 - A preallocated array to hold the result. Length is inputCount.
+ */
+void getOutput(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, ActivationMatrix &activations, double *output) {
+	getOutputError(input, inputCount, neuronCount, centers, weights, width, activations, NULL, output, NULL);
+}
+
+/*
+ * Calculates the output of the network for an input data matrix like getOutput, and in the same pass
+ * the residual target - output of each point and the sum of their squares, so neither the error nor
+ * the weight update has to read the output back. The squares are summed in double. Returns the sum of
+ * the squared residuals.
+ *
+ * Parameters:
+ * double *input				 - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount				 - The number of input data points.
+ * int neuronCount				 - The number of RBF neurons in the network.
+ * double *centers				 - An matrix of centers, size neuronCount x 3. Stride 3.
+ * double *weights				 - An array of weights, size neuronCount.
+ * double width					 - The width of each RBF neuron.
+ * ActivationMatrix &activations - A preallocated matrix to hold the activation values, see getOutput.
+ * const double *target			 - The target array, length inputCount.
+ * double *output				 - A preallocated array to hold the result. Length is inputCount.
+ * double *residuals			 - A preallocated array to hold the residual of each point, ready for train.
+ *								   Length is inputCount. NULL if only the error is needed.
  */
-void getOutput(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, double *outputValues, double *activationValues, double *output) {
+double getOutputError(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, ActivationMatrix &activations, const double *target, double *output, double *residuals) {
+	activations.sampleCount = inputCount;
+	activations.neuronCount = neuronCount;
+	activations.input		= input;
+	activations.centers		= centers;
+	activations.width		= width;
+
+	// Lay the centers out so the activation kernel can evaluate several neurons at once.
+	double *soaCenters = (double*) malloc(sizeof(double) * neuronCount * 3);
+	centersToSoA(centers, neuronCount, soaCenters);
+
+	// Sample-major doubles are written straight into the matrix. Anything else is gathered a tile at a
+	// time and then converted & stored in the matrix's own order, or dropped if it's to be recomputed.
+	double *tile = NULL;
+	if (activations.storage != ACTIVATIONS_DOUBLE || activations.layout != ACTIVATIONS_SAMPLE_MAJOR) {
+		tile = (double*) malloc(sizeof(double) * FORWARD_SAMPLE_BLOCK * FORWARD_TILE_STRIDE);
+	}
+
+	double activationSums[FORWARD_SAMPLE_BLOCK], weightedSums[FORWARD_SAMPLE_BLOCK];
+	double squaredError = 0;
+	for (int sampleBegin = 0; sampleBegin < inputCount; sampleBegin += FORWARD_SAMPLE_BLOCK) {
+		int sampleEnd = sampleBegin + FORWARD_SAMPLE_BLOCK < inputCount ? sampleBegin + FORWARD_SAMPLE_BLOCK : inputCount;
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			activationSums[dataIndex - sampleBegin] = weightedSums[dataIndex - sampleBegin] = 0;
+		}
+
+		// Sweep each block of neurons over every sample in the tile.
+		for (int neuronBegin = 0; neuronBegin < neuronCount; neuronBegin += FORWARD_NEURON_BLOCK) {
+			int neuronEnd = neuronBegin + FORWARD_NEURON_BLOCK < neuronCount ? neuronBegin + FORWARD_NEURON_BLOCK : neuronCount;
+			for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+				double *destination = tile ? tile + (dataIndex - sampleBegin) * FORWARD_TILE_STRIDE
+										   : (double*) activations.values + (size_t) dataIndex * neuronCount + neuronBegin;
+				double &activationSum = activationSums[dataIndex - sampleBegin], &weightedSum = weightedSums[dataIndex - sampleBegin];
+				if (!activations.tables || !tableForward(*activations.tables, input + dataIndex * 3, neuronBegin, neuronEnd, weights, destination, activationSum, weightedSum)) {
+					rbfForward(input + dataIndex * 3, soaCenters, neuronCount, neuronBegin, neuronEnd, width, weights, destination, activationSum, weightedSum);
+				}
+			}
+
+			if (tile && activations.storage != ACTIVATIONS_RECOMPUTE) {
+				storeActivations(activations, tile, FORWARD_TILE_STRIDE, sampleBegin, sampleEnd, neuronBegin, neuronEnd);
+			}
+		}
+
+		// Calculate the normalized network output for each sample in the tile, and its residual while it's at hand.
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			output[dataIndex] = weightedSums[dataIndex - sampleBegin] / activationSums[dataIndex - sampleBegin];
+			if (activations.activationSums) {
+				activations.activationSums[dataIndex] = activationSums[dataIndex - sampleBegin];
+			}
+			if (target) {
+				double residual = target[dataIndex] - output[dataIndex];
+				squaredError += residual * residual;
+				if (residuals) {
+					residuals[dataIndex] = residual;
+				}
+			}
+		}
+	}
+
+	free(soaCenters);
+	free(tile);
+	return squaredError;
+}
+
+/*
+ * Calculates the output, residuals & squared error of the network like getOutputError, but from the
+ * activations getOutput last stored in the matrix instead of from the input & centers. The activations
+ * only depend on the input, centers & width, so while gradient descent is only changing the weights
+ * every epoch after the first is a product of the stored matrix with the weights, and no distance or
+ * exponential is evaluated again. Only ACTIVATIONS_DOUBLE gives exactly the output of getOutputError,
+ * as the narrower storage types round each activation. Returns the sum of the squared residuals.
+ *
+ * Parameters:
+ * const ActivationMatrix &activations - The matrix getOutput last filled. Not ACTIVATIONS_RECOMPUTE.
+ * const double *weights			   - An array of weights, size neuronCount.
+ * const double *target				   - The target array, length sampleCount.
+ * double *output					   - A preallocated array to hold the result. Length is sampleCount.
+ * double *residuals				   - A preallocated array to hold the residual of each point, ready for
+ *										 train. Length is sampleCount. NULL if only the error is needed.
+ */
+double getStoredOutputError(const ActivationMatrix &activations, const double *weights, const double *target, double *output, double *residuals) {
+	int sampleCount = activations.sampleCount, neuronCount = activations.neuronCount;
+	const double *values = (const double*) activations.values;
+
+	if (activations.storage == ACTIVATIONS_DOUBLE && activations.layout == ACTIVATIONS_SAMPLE_MAJOR) {
+		// Each weighted sum is a dot product with a contiguous row.
+		for (int dataIndex = 0; dataIndex < sampleCount; dataIndex++) {
+			output[dataIndex] = dot(values + (size_t) dataIndex * neuronCount, weights, neuronCount);
+		}
+	} else if (activations.storage == ACTIVATIONS_DOUBLE) {
+		// Add each neuron's contiguous column to the weighted sums in turn.
+		memset(output, 0, sizeof(double) * sampleCount);
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			const double *column = values + (size_t) neuronIndex * sampleCount;
+			double		  weight = weights[neuronIndex];
+			for (int dataIndex = 0; dataIndex < sampleCount; dataIndex++) {
+				output[dataIndex] += weight * column[dataIndex];
+			}
+		}
+	} else {
+		// Widen the narrower types a tile at a time.
+		double *tile = (double*) malloc(sizeof(double) * FORWARD_SAMPLE_BLOCK * FORWARD_TILE_STRIDE);
+		for (int sampleBegin = 0; sampleBegin < sampleCount; sampleBegin += FORWARD_SAMPLE_BLOCK) {
+			int sampleEnd = sampleBegin + FORWARD_SAMPLE_BLOCK < sampleCount ? sampleBegin + FORWARD_SAMPLE_BLOCK : sampleCount;
+			for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+				output[dataIndex] = 0;
+			}
+			for (int neuronBegin = 0; neuronBegin < neuronCount; neuronBegin += FORWARD_NEURON_BLOCK) {
+				int neuronEnd = neuronBegin + FORWARD_NEURON_BLOCK < neuronCount ? neuronBegin + FORWARD_NEURON_BLOCK : neuronCount;
+				loadActivations(activations, NULL, sampleBegin, sampleEnd, neuronBegin, neuronEnd, tile, FORWARD_TILE_STRIDE);
+				for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+					output[dataIndex] += dot(tile + (dataIndex - sampleBegin) * FORWARD_TILE_STRIDE, weights + neuronBegin, neuronEnd - neuronBegin);
+				}
+			}
+		}
+		free(tile);
+	}
+
+	// Normalize the weighted sums, and calculate the residuals & error.
+	double squaredError = 0;
+	for (int dataIndex = 0; dataIndex < sampleCount; dataIndex++) {
+		output[dataIndex] /= activations.activationSums[dataIndex];
+		if (target) {
+			double residual = target[dataIndex] - output[dataIndex];
+			squaredError += residual * residual;
+			if (residuals) {
+				residuals[dataIndex] = residual;
+			}
+		}
+	}
+	return squaredError;
+}
+
+/*
+ * Calculates the output of the network for an input data matrix, evaluating only the neurons listed
+ * for the grid cell each input is in, so every output is within the bound described for NeuronGrid
+ * of the one getOutput gives. Inputs outside the grid are evaluated densely. No activations are
+ * kept. Returns the mean number of neurons evaluated per input.
+ *
+ * Parameters:
+ * double *input		  - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount		  - The number of input data points.
+ * const NeuronGrid &grid - The centers & width of the network, bucketed into a grid.
+ * double *weights		  - An array of weights, size neuronCount.
+ * double *output		  - A preallocated array to hold the result. Length is inputCount.
+ */
+double getOutputSparse(double *input, int inputCount, const NeuronGrid &grid, double *weights, double *output) {
+	double *entryWeights = (double*) malloc(sizeof(double) * grid.entryCount);
+	weightsToGrid(grid, weights, entryWeights);
+
+	double evaluatedCount = 0;
 	for (int dataIndex = 0; dataIndex < inputCount; dataIndex++) {
-		int dIndex = dataIndex * 3;
-		double dataPoint[] = { input[dIndex], input[dIndex + 1], input[dIndex + 2] };
-		output[dataIndex]  = getOutput(dataIndex, dataPoint, neuronCount, centers, weights, width, outputValues, activationValues);
+		double activationSum = 0, weightedSum = 0;
+		evaluatedCount += gridForward(grid, input + dataIndex * 3, weights, entryWeights, activationSum, weightedSum);
+		output[dataIndex] = weightedSum / activationSum;
 	}
+
+	free(entryWeights);
+	return evaluatedCount / inputCount;
+}
+
+/*
+ * Applies the weight update for the neurons neuronBegin to neuronEnd. See train.
+ *
+ * Parameters:
+ * const ActivationMatrix *trainActivations - The activation values for the training data.
+ * const double *soaCenters					- The centers in structure-of-arrays form, for ACTIVATIONS_RECOMPUTE.
+ * double learningRate						- The learning rate of the network.
+ * const double *residuals					- The residual target - output of each training data point.
+ * int neuronBegin							- The first neuron to update.
+ * int neuronEnd							- One past the last neuron to update.
+ * double *weights							- The weight array for the network.
+ */
+static void trainRange(const ActivationMatrix *trainActivations, const double *soaCenters, double learningRate, const double *residuals, int neuronBegin, int neuronEnd, double *weights) {
+	int trainDataCount = trainActivations->sampleCount, neuronCount = trainActivations->neuronCount;
+	const double *values = (const double*) trainActivations->values;
+
+	if (trainActivations->storage == ACTIVATIONS_DOUBLE && trainActivations->layout == ACTIVATIONS_NEURON_MAJOR) {
+		// Each weight's update is a dot product with a contiguous column.
+		for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+			weights[neuronIndex] += learningRate * dot(values + (size_t) neuronIndex * trainDataCount, residuals, trainDataCount);
+		}
+		return;
+	}
+
+	if (trainActivations->storage == ACTIVATIONS_DOUBLE) {
+		// Walk the rows in order, adding each one's contribution to this range of weights.
+		for (int dataIndex = 0; dataIndex < trainDataCount; dataIndex++) {
+			const double *activationRow = values + (size_t) dataIndex * neuronCount;
+			double error = learningRate * residuals[dataIndex];
+			for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+				weights[neuronIndex] += error * activationRow[neuronIndex];
+			}
+		}
+		return;
+	}
+
+	// Widen or recompute a tile of activations at a time, then add its rows' contributions as above.
+	int rangeSize = neuronEnd - neuronBegin;
+	double *tile = (double*) malloc(sizeof(double) * FORWARD_SAMPLE_BLOCK * rangeSize);
+	for (int sampleBegin = 0; sampleBegin < trainDataCount; sampleBegin += FORWARD_SAMPLE_BLOCK) {
+		int sampleEnd = sampleBegin + FORWARD_SAMPLE_BLOCK < trainDataCount ? sampleBegin + FORWARD_SAMPLE_BLOCK : trainDataCount;
+		loadActivations(*trainActivations, soaCenters, sampleBegin, sampleEnd, neuronBegin, neuronEnd, tile, rangeSize);
+		for (int dataIndex = sampleBegin; dataIndex < sampleEnd; dataIndex++) {
+			const double *activationRow = tile + (dataIndex - sampleBegin) * rangeSize - neuronBegin;
+			double error = learningRate * residuals[dataIndex];
+			for (int neuronIndex = neuronBegin; neuronIndex < neuronEnd; neuronIndex++) {
+				weights[neuronIndex] += error * activationRow[neuronIndex];
+			}
+		}
+	}
+	free(tile);
 }
 
 /*
  * Updates the weights of a network based on the difference between network output & target output.
+ * The update is the matrix-vector product weights += learningRate * activations^T * residuals, split
+ * across threadCount threads by neuron range. With ACTIVATIONS_RECOMPUTE, each thread evaluates the
+ * activations for its own neurons again as it goes.
  * 
  * Parameters:
- * double learningRate			 - The learning rate of the network.
- * int trainDataCount			 - The number of training data points.
- * double *trainOutput			 - A preallocated array to hold the output of the network.
- * double *trainActivationValues - A preallocated array to hold a partial sum for training.
- * double *trainTarget			 - The target array.
- * int neuronCount				 - The number of neurons in the network.
- * double *weights				 - The weight array for the network.
+ * double learningRate						- The learning rate of the network.
+ * const double *trainResiduals				- The residual target - output of each training data point, as
+ *											  filled in by getOutputError. Length trainActivations.sampleCount.
+ * const ActivationMatrix &trainActivations - The activation values for the training data, as filled in by getOutputError.
+ * int neuronCount							- The number of neurons in the network.
+ * double *weights							- The weight array for the network.
+ * int threadCount							- The number of threads to update the weights on.
  */
-void train(double learningRate, int trainDataCount, double *trainOutput, double *trainActivationValues, double *trainTarget, int neuronCount, double *weights) {
-	for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
-		for (int dataIndex = 0; dataIndex < trainDataCount; dataIndex++) {
-			weights[neuronIndex] += learningRate * (trainTarget[dataIndex] - trainOutput[dataIndex]) * trainActivationValues[dataIndex * neuronCount + neuronIndex];
+void train(double learningRate, const double *trainResiduals, const ActivationMatrix &trainActivations, int neuronCount, double *weights, int threadCount) {
+	double *soaCenters = NULL;
+	if (trainActivations.storage == ACTIVATIONS_RECOMPUTE) {
+		soaCenters = (double*) malloc(sizeof(double) * neuronCount * 3);
+		centersToSoA(trainActivations.centers, neuronCount, soaCenters);
+	}
+
+	if (threadCount > neuronCount) {
+		threadCount = neuronCount;
+	}
+	if (threadCount <= 1) {
+		trainRange(&trainActivations, soaCenters, learningRate, trainResiduals, 0, neuronCount, weights);
+	} else {
+		// Every thread owns a contiguous range of weights, so no two threads write to the same one.
+		vector<thread> threads;
+		for (int i = 0; i < threadCount; i++) {
+			threads.push_back(thread(trainRange, &trainActivations, soaCenters, learningRate, trainResiduals, neuronCount * i / threadCount, neuronCount * (i + 1) / threadCount, weights));
+		}
+		for (int i = 0; i < threadCount; i++) {
+			threads[i].join();
 		}
 	}
+
+	free(soaCenters);
+}
+
+/*
+ * Factorizes a symmetric positive definite matrix in place into L * L^T, leaving L in the lower triangle.
+ * Returns false if the matrix isn't positive definite.
+ *
+ * Parameters:
+ * double *matrix - The matrix to factorize, size size x size.
+ * int size		  - The number of rows and columns in the matrix.
+ */
+static bool cholesky(double *matrix, int size) {
+	for (int j = 0; j < size; j++) {
+		double *rowJ = matrix + (size_t) j * size;
+		double pivot = rowJ[j];
+		for (int k = 0; k < j; k++) {
+			pivot -= rowJ[k] * rowJ[k];
+		}
+		if (!(pivot > 0)) {
+			return false;
+		}
+		rowJ[j] = sqrt(pivot);
+
+		for (int i = j + 1; i < size; i++) {
+			double *rowI = matrix + (size_t) i * size;
+			double value = rowI[j];
+			for (int k = 0; k < j; k++) {
+				value -= rowI[k] * rowJ[k];
+			}
+			rowI[j] = value / rowJ[j];
+		}
+	}
+	return true;
+}
+
+/*
+ * Calculates the weights of a network directly, rather than by gradient descent. With the centers and
+ * width fixed, the network output is a linear function of the weights over the normalized activations
+ * phi = activation / activationSum, so the weights minimising the training error solve the normal
+ * equations (phi^T phi + ridge * I) w = phi^T target. These are solved with a Cholesky factorization.
+ * Returns false, leaving the weights unchanged, if the system is singular, in which case a larger ridge
+ * is needed. With row weights, each row counts weight times in phi^T phi and its target is the sum of
+ * the targets it stands for, which gives the same system as the rows it was merged from. See DataSet.
+ *
+ * Parameters:
+ * int trainDataCount						- The number of training data points.
+ * const ActivationMatrix &trainActivations - The activation values for the training data, as filled in by getOutput.
+ * double *trainTarget						- The target array.
+ * const double *rowWeights					- The weight of each training data point, or NULL if they're all 1.
+ * int neuronCount							- The number of neurons in the network.
+ * double ridge								- The regularization, relative to the mean of the diagonal of phi^T phi.
+ * double *weights							- The weight array for the network.
+ */
+bool solveWeights(int trainDataCount, const ActivationMatrix &trainActivations, double *trainTarget, const double *rowWeights, int neuronCount, double ridge, double *weights) {
+	double *gram	= (double*) calloc((size_t) neuronCount * neuronCount, sizeof(double));
+	double *rhs		= (double*) calloc(neuronCount, sizeof(double));
+	double *phi		= (double*) malloc(sizeof(double) * neuronCount * SOLVE_BLOCK);
+	double *target	= (double*) malloc(sizeof(double) * SOLVE_BLOCK);
+	double *rowSums = (double*) malloc(sizeof(double) * SOLVE_BLOCK);
+	double *scales	= (double*) malloc(sizeof(double) * SOLVE_BLOCK);
+	double *tile	= (double*) malloc(sizeof(double) * SOLVE_BLOCK * neuronCount);
+	int	   *nonZero = (int*)	malloc(sizeof(int)	  * neuronCount);
+
+	double *soaCenters = NULL;
+	if (trainActivations.storage == ACTIVATIONS_RECOMPUTE) {
+		soaCenters = (double*) malloc(sizeof(double) * neuronCount * 3);
+		centersToSoA(trainActivations.centers, neuronCount, soaCenters);
+	}
+
+	// Accumulate the lower triangle of phi^T phi a block of rows at a time, with the block stored
+	// neuron-major so each entry is a dot product of two contiguous columns. The rows are in date
+	// order, so for narrow neurons a block only touches the neurons near those dates and the rest are skipped.
+	for (int blockBegin = 0; blockBegin < trainDataCount; blockBegin += SOLVE_BLOCK) {
+		int blockSize = blockBegin + SOLVE_BLOCK < trainDataCount ? SOLVE_BLOCK : trainDataCount - blockBegin;
+
+		// Copy the block's activations into neuron-major form, and sum each row.
+		loadActivations(trainActivations, soaCenters, blockBegin, blockBegin + blockSize, 0, neuronCount, tile, neuronCount);
+
+		// A row of weight c is scaled by sqrt(c) in phi and 1 / sqrt(c) in the target, so it adds c times
+		// its activations to phi^T phi and its summed target to phi^T target.
+		for (int row = 0; row < SOLVE_BLOCK; row++) {
+			rowSums[row] = 0;
+			scales[row]	 = row < blockSize && rowWeights != NULL ? sqrt(rowWeights[blockBegin + row]) : 1;
+			target[row]	 = row < blockSize ? trainTarget[blockBegin + row] / scales[row] : 0;
+		}
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			double *column = phi + neuronIndex * SOLVE_BLOCK;
+			for (int row = 0; row < SOLVE_BLOCK; row++) {
+				column[row] = row < blockSize ? tile[row * neuronCount + neuronIndex] : 0;
+				rowSums[row] += column[row];
+			}
+		}
+
+		// Normalize the activations.
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			double *column = phi + neuronIndex * SOLVE_BLOCK;
+			for (int row = 0; row < blockSize; row++) {
+				double value = rowSums[row] > 0 ? column[row] / rowSums[row] : 0;
+				column[row] = value > SOLVE_EPSILON ? value * scales[row] : 0;
+			}
+		}
+
+		int nonZeroCount = 0;
+		for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+			for (int row = 0; row < blockSize; row++) {
+				if (phi[neuronIndex * SOLVE_BLOCK + row] != 0) {
+					nonZero[nonZeroCount++] = neuronIndex;
+					break;
+				}
+			}
+		}
+
+		for (int i = 0; i < nonZeroCount; i++) {
+			double *columnI = phi + nonZero[i] * SOLVE_BLOCK;
+			double *gramRow = gram + (size_t) nonZero[i] * neuronCount;
+			for (int j = 0; j <= i; j++) {
+				gramRow[nonZero[j]] += dot(columnI, phi + nonZero[j] * SOLVE_BLOCK, SOLVE_BLOCK);
+			}
+			rhs[nonZero[i]] += dot(columnI, target, SOLVE_BLOCK);
+		}
+	}
+
+	// Add the ridge to the diagonal, scaled so it doesn't depend on the amount of data.
+	double trace = 0;
+	for (int i = 0; i < neuronCount; i++) {
+		trace += gram[(size_t) i * neuronCount + i];
+	}
+	for (int i = 0; i < neuronCount; i++) {
+		gram[(size_t) i * neuronCount + i] += ridge * trace / neuronCount;
+	}
+
+	bool solved = cholesky(gram, neuronCount);
+	if (solved) {
+		// Forward substitution for L y = rhs, then back substitution for L^T w = y.
+		for (int i = 0; i < neuronCount; i++) {
+			double *gramRow = gram + (size_t) i * neuronCount;
+			for (int k = 0; k < i; k++) {
+				rhs[i] -= gramRow[k] * rhs[k];
+			}
+			rhs[i] /= gramRow[i];
+		}
+		for (int i = neuronCount - 1; i >= 0; i--) {
+			for (int k = i + 1; k < neuronCount; k++) {
+				rhs[i] -= gram[(size_t) k * neuronCount + i] * rhs[k];
+			}
+			rhs[i] /= gram[(size_t) i * neuronCount + i];
+		}
+		for (int i = 0; i < neuronCount; i++) {
+			weights[i] = rhs[i];
+		}
+	}
+
+	free(gram);
+	free(rhs);
+	free(phi);
+	free(target);
+	free(rowSums);
+	free(scales);
+	free(tile);
+	free(nonZero);
+	free(soaCenters);
+	return solved;
 }
 
 /*
@@ -126,6 +787,28 @@ bool converged(float *epochRms, int epoch) {
 			|| epochRms[epoch - 2] < epochRms[epoch]));
 }
 
+/*
+ * Determines whether a network has finished training under a convergence policy, and keeps track of
+ * its best epoch so far, which is the one with the lowest testing error that improved on the best
+ * before it by more than minDelta. With a patience, training stops once that many epochs have passed
+ * since the best epoch. Otherwise converged decides.
+ *
+ * Parameters:
+ * const ConvergencePolicy &policy - The convergence policy.
+ * float *epochRms				   - The matrix holding the training and testing root-mean-squared error. Stride 2.
+ * int epoch					   - The current training epoch.
+ * int &bestEpoch				   - The best epoch so far, or -1 before the first epoch. Updated on return.
+ */
+bool checkConvergence(const ConvergencePolicy &policy, float *epochRms, int epoch, int &bestEpoch) {
+	if (bestEpoch < 0 || epochRms[2 * epoch + 1] < epochRms[2 * bestEpoch + 1] - policy.minDelta) {
+		bestEpoch = epoch;
+	}
+	if (policy.patience <= 0) {
+		return converged(epochRms, epoch);
+	}
+	return epoch - bestEpoch >= policy.patience;
+}
+
 /*
  * Calculates the sum of a single-dimension vector.
  *
@@ -139,4 +822,28 @@ double sum(double *vector, int size) {
 		output += vector[i];
 	}
 	return output;
+}
+
+/*
+ * Calculates the dot product of two single-dimension arrays. Four partial sums are kept so the
+ * multiplications don't wait on each other.
+ *
+ * Parameters:
+ * const double *a - The first array.
+ * const double *b - The second array.
+ * int size		   - The size of the two arrays.
+ */
+double dot(const double *a, const double *b, int size) {
+	double sums[] = { 0, 0, 0, 0 };
+	int i = 0;
+	for (; i + 4 <= size; i += 4) {
+		sums[0] += a[i] * b[i];
+		sums[1] += a[i + 1] * b[i + 1];
+		sums[2] += a[i + 2] * b[i + 2];
+		sums[3] += a[i + 3] * b[i + 3];
+	}
+	for (; i < size; i++) {
+		sums[0] += a[i] * b[i];
+	}
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
 }
\ No newline at end of file
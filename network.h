@@ -1,5 +1,110 @@
+#pragma once
+
+#include "grid.h"
+#include "tables.h"
+
+/*
+ * How an activation matrix is laid out in memory.
+ *
+ * ACTIVATIONS_SAMPLE_MAJOR - The activations of each sample are contiguous, values[dataIndex * neuronCount + neuronIndex].
+ * ACTIVATIONS_NEURON_MAJOR - The activations of each neuron are contiguous, values[neuronIndex * sampleCount + dataIndex].
+ */
+enum ActivationLayout {
+	ACTIVATIONS_SAMPLE_MAJOR,
+	ACTIVATIONS_NEURON_MAJOR
+};
+
+/*
+ * How the values of an activation matrix are stored. Narrower types trade precision in the weight
+ * update for memory, and ACTIVATIONS_RECOMPUTE stores nothing and evaluates the activations again
+ * whenever they are needed.
+ *
+ * ACTIVATIONS_DOUBLE	 - 8 bytes per activation.
+ * ACTIVATIONS_FLOAT	 - 4 bytes per activation, about 7 significant digits.
+ * ACTIVATIONS_BFLOAT16	 - 2 bytes per activation, the top half of a float, about 3 significant digits.
+ * ACTIVATIONS_RECOMPUTE - No storage. The activations are recomputed a tile at a time from the input,
+ *						   centers & width the matrix was last filled with.
+ */
+enum ActivationStorage {
+	ACTIVATIONS_DOUBLE,
+	ACTIVATIONS_FLOAT,
+	ACTIVATIONS_BFLOAT16,
+	ACTIVATIONS_RECOMPUTE
+};
+
+/*
+ * The activation of every neuron for every sample of a data set. getOutput sets the dimensions, so one
+ * buffer can be reused for networks and data sets of different sizes.
+ *
+ * Members:
+ * void *values					  - The activation values, room for at least sampleCount x neuronCount of the
+ *									storage type. NULL for ACTIVATIONS_RECOMPUTE.
+ * ActivationStorage storage	  - How each value is stored.
+ * ActivationLayout layout		  - How the values are laid out.
+ * int sampleCount				  - The number of samples.
+ * int neuronCount				  - The number of neurons.
+ * const double *input			  - The input data the matrix was last filled from.
+ * const double *centers		  - The centers the matrix was last filled from.
+ * double width					  - The width the matrix was last filled with.
+ * double *activationSums		  - The sum of each sample's activations, length sampleCount. NULL for
+ *									ACTIVATIONS_RECOMPUTE. See getStoredOutputError.
+ * const ActivationTables *tables - Tables of the network's activations, which getOutput and the
+ *									recomputed activations look the activations up in whenever the input
+ *									is made of tabulated values. Set by the caller, and NULL by default.
+ */
+struct ActivationMatrix {
+	void			 *values;
+	ActivationStorage storage;
+	ActivationLayout  layout;
+	int				  sampleCount;
+	int				  neuronCount;
+	const double	 *input;
+	const double	 *centers;
+	double			  width;
+	double			 *activationSums;
+	const ActivationTables *tables;
+};
+
+/*
+ * How gradient descent decides that a network has finished training, see checkConvergence. Stopping
+ * sooner trades accuracy for time.
+ *
+ * Members:
+ * int patience		- The number of epochs the testing error may go without improving before training
+ *					  stops. 0 uses converged instead.
+ * double minDelta	- The smallest fall in the testing error that counts as an improvement.
+ * bool restoreBest	- Whether a network is scored with the weights from its epoch with the lowest testing
+ *					  error, rather than the ones it stopped with.
+ */
+struct ConvergencePolicy {
+	int	   patience;
+	double minDelta;
+	bool   restoreBest;
+};
+
+/*
+ * Allocates an activation matrix big enough for maxSampleCount samples and maxNeuronCount neurons.
+ *
+ * Parameters:
+ * ActivationMatrix &activations - The matrix to allocate. Release it with freeActivationMatrix.
+ * ActivationStorage storage	 - How each value is stored.
+ * ActivationLayout layout		 - How the values are laid out.
+ * int maxSampleCount			 - The largest number of samples the matrix will hold.
+ * int maxNeuronCount			 - The largest number of neurons the matrix will hold.
+ */
+void allocateActivationMatrix(ActivationMatrix &activations, ActivationStorage storage, ActivationLayout layout, int maxSampleCount, int maxNeuronCount);
+
 /*
- * Calculates a root-mean-squared error for the given target & output.
+ * Releases the memory held by an activation matrix.
+ *
+ * Parameters:
+ * ActivationMatrix &activations - The matrix to release.
+ */
+void freeActivationMatrix(ActivationMatrix &activations);
+
+/*
+ * Calculates a root-mean-squared error for the given target & output. The squares are summed in
+ * double, as a float sum loses digits over a data set this size.
  *
  * Parameters:
  * double *target - The array of target values.
@@ -25,32 +130,112 @@ double getOutput(int dataIndex, double *input, int neuronCount, double *centers,
 /*
  * Calculates the output of the network for an input data matrix.
  *
+ * The samples are processed in tiles of FORWARD_SAMPLE_BLOCK samples against FORWARD_NEURON_BLOCK
+ * neurons, so that the block of centers & weights stays in L1 while every sample in the tile uses it.
+ * The activation sums and weighted outputs are accumulated per sample rather than written out and re-summed.
+ *
  * Parameters:
- * double *input			- An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
- * int inputCount			- The number of input data points.
- * int neuronCount			- The number of RBF neurons in the network.
- * double *centers			- An matrix of centers, size neuronCount x 3. Stride 3.
- * double *weights			- An array of weights, size neuronCount.
- * double width				- The width of each RBF neuron.
- * double *outputValues		- An array to hold a partial sum for the output. Re-use for performance.
- * double *activationValues - An array to hold a partial sum for the output. Re-use for performance.
- * double *output			- A preallocated array to hold the result. Length is inputCount.
+ * double *input				 - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount				 - The number of input data points.
+ * int neuronCount				 - The number of RBF neurons in the network.
+ * double *centers				 - An matrix of centers, size neuronCount x 3. Stride 3.
+ * double *weights				 - An array of weights, size neuronCount.
+ * double width					 - The width of each RBF neuron.
+ * ActivationMatrix &activations - A preallocated matrix to hold the activation values, in its own layout
+ *								   & storage. The input, centers & width are recorded for recomputing them.
+ * double *output				 - A preallocated array to hold the result. Length is inputCount.
+ */
+void getOutput(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, ActivationMatrix &activations, double *output);
+
+/*
+ * Calculates the output of the network for an input data matrix like getOutput, and in the same pass
+ * the residual target - output of each point and the sum of their squares, so neither the error nor
+ * the weight update has to read the output back. The squares are summed in double. Returns the sum of
+ * the squared residuals.
+ *
+ * Parameters:
+ * double *input				 - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount				 - The number of input data points.
+ * int neuronCount				 - The number of RBF neurons in the network.
+ * double *centers				 - An matrix of centers, size neuronCount x 3. Stride 3.
+ * double *weights				 - An array of weights, size neuronCount.
+ * double width					 - The width of each RBF neuron.
+ * ActivationMatrix &activations - A preallocated matrix to hold the activation values, see getOutput.
+ * const double *target			 - The target array, length inputCount.
+ * double *output				 - A preallocated array to hold the result. Length is inputCount.
+ * double *residuals			 - A preallocated array to hold the residual of each point, ready for train.
+ *								   Length is inputCount. NULL if only the error is needed.
+ */
+double getOutputError(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, ActivationMatrix &activations, const double *target, double *output, double *residuals);
+
+/*
+ * Calculates the output, residuals & squared error of the network like getOutputError, but from the
+ * activations getOutput last stored in the matrix instead of from the input & centers. The activations
+ * only depend on the input, centers & width, so while gradient descent is only changing the weights
+ * every epoch after the first is a product of the stored matrix with the weights, and no distance or
+ * exponential is evaluated again. Only ACTIVATIONS_DOUBLE gives exactly the output of getOutputError,
+ * as the narrower storage types round each activation. Returns the sum of the squared residuals.
+ *
+ * Parameters:
+ * const ActivationMatrix &activations - The matrix getOutput last filled. Not ACTIVATIONS_RECOMPUTE.
+ * const double *weights			   - An array of weights, size neuronCount.
+ * const double *target				   - The target array, length sampleCount.
+ * double *output					   - A preallocated array to hold the result. Length is sampleCount.
+ * double *residuals				   - A preallocated array to hold the residual of each point, ready for
+ *										 train. Length is sampleCount. NULL if only the error is needed.
  */
-void getOutput(double *input, int inputCount, int neuronCount, double *centers, double *weights, double width, double *outputValues, double *activationValues, double *output);
+double getStoredOutputError(const ActivationMatrix &activations, const double *weights, const double *target, double *output, double *residuals);
+
+/*
+ * Calculates the output of the network for an input data matrix, evaluating only the neurons listed
+ * for the grid cell each input is in, so every output is within the bound described for NeuronGrid
+ * of the one getOutput gives. Inputs outside the grid are evaluated densely. No activations are
+ * kept. Returns the mean number of neurons evaluated per input.
+ *
+ * Parameters:
+ * double *input		  - An matrix of inputCount data points, where each point is an array of 3 values. Stride 3.
+ * int inputCount		  - The number of input data points.
+ * const NeuronGrid &grid - The centers & width of the network, bucketed into a grid.
+ * double *weights		  - An array of weights, size neuronCount.
+ * double *output		  - A preallocated array to hold the result. Length is inputCount.
+ */
+double getOutputSparse(double *input, int inputCount, const NeuronGrid &grid, double *weights, double *output);
 
 /*
  * Updates the weights of a network based on the difference between network output & target output.
+ * The update is the matrix-vector product weights += learningRate * activations^T * residuals, split
+ * across threadCount threads by neuron range.
  * 
  * Parameters:
- * double learningRate			 - The learning rate of the network.
- * int trainDataCount			 - The number of training data points.
- * double *trainOutput			 - A preallocated array to hold the output of the network.
- * double *trainActivationValues - A preallocated array to hold a partial sum for training.
- * double *trainTarget			 - The target array.
- * int neuronCount				 - The number of neurons in the network.
- * double *weights				 - The weight array for the network.
+ * double learningRate						- The learning rate of the network.
+ * const double *trainResiduals				- The residual target - output of each training data point, as
+ *											  filled in by getOutputError. Length trainActivations.sampleCount.
+ * const ActivationMatrix &trainActivations - The activation values for the training data, as filled in by getOutputError.
+ * int neuronCount							- The number of neurons in the network.
+ * double *weights							- The weight array for the network.
+ * int threadCount							- The number of threads to update the weights on.
  */
-void train(double learningRate, int trainDataCount, double *trainOutput, double *trainActivationValues, double *trainTarget, int neuronCount, double *weights);
+void train(double learningRate, const double *trainResiduals, const ActivationMatrix &trainActivations, int neuronCount, double *weights, int threadCount);
+
+/*
+ * Calculates the weights of a network directly, rather than by gradient descent. With the centers and
+ * width fixed, the network output is a linear function of the weights over the normalized activations
+ * phi = activation / activationSum, so the weights minimising the training error solve the normal
+ * equations (phi^T phi + ridge * I) w = phi^T target. These are solved with a Cholesky factorization.
+ * Returns false, leaving the weights unchanged, if the system is singular, in which case a larger ridge
+ * is needed. With row weights, each row counts weight times in phi^T phi and its target is the sum of
+ * the targets it stands for, which gives the same system as the rows it was merged from. See DataSet.
+ *
+ * Parameters:
+ * int trainDataCount						- The number of training data points.
+ * const ActivationMatrix &trainActivations - The activation values for the training data, as filled in by getOutput.
+ * double *trainTarget						- The target array.
+ * const double *rowWeights					- The weight of each training data point, or NULL if they're all 1.
+ * int neuronCount							- The number of neurons in the network.
+ * double ridge								- The regularization, relative to the mean of the diagonal of phi^T phi.
+ * double *weights							- The weight array for the network.
+ */
+bool solveWeights(int trainDataCount, const ActivationMatrix &trainActivations, double *trainTarget, const double *rowWeights, int neuronCount, double ridge, double *weights);
 
 /*
  * Determines whether we've converged on a solution by checking if the test error has stopped changing 
@@ -60,4 +245,18 @@ void train(double learningRate, int trainDataCount, double *trainOutput, double
  * double *epochRms - The matrix holding the training and testing root-mean-squared error. Stride 2.
  * int epoch		- The current training epoch.
  */
-bool converged(float *epochRms, int epoch);
\ No newline at end of file
+bool converged(float *epochRms, int epoch);
+
+/*
+ * Determines whether a network has finished training under a convergence policy, and keeps track of
+ * its best epoch so far, which is the one with the lowest testing error that improved on the best
+ * before it by more than minDelta. With a patience, training stops once that many epochs have passed
+ * since the best epoch. Otherwise converged decides.
+ *
+ * Parameters:
+ * const ConvergencePolicy &policy - The convergence policy.
+ * float *epochRms				   - The matrix holding the training and testing root-mean-squared error. Stride 2.
+ * int epoch					   - The current training epoch.
+ * int &bestEpoch				   - The best epoch so far, or -1 before the first epoch. Updated on return.
+ */
+bool checkConvergence(const ConvergencePolicy &policy, float *epochRms, int epoch, int &bestEpoch);
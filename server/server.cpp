@@ -0,0 +1,553 @@
+/*
+ * A long-running predictor that loads a model saved by the sweep once and answers forecast requests
+ * over a Unix domain socket or a local TCP port. Each connection is served by its own thread, which
+ * parses a request and queues it. A single batching thread takes every request waiting in the queue,
+ * evaluates them together with the batched getOutput, and hands each its share of the output. While
+ * one batch is evaluated the next one builds up, so the busier the server, the bigger the batches.
+ *
+ * Requests and responses are single lines of text, so the server can be driven with nc or socat:
+ * forecast <dayOfYear> <hour> <dayOfWeek> <hours>	- Predicts <hours> consecutive hours, starting with
+ *													  the one given. Days wrap to 1 after day 366.
+ * predict <dayOfYear>,<hour>,<dayOfWeek> ...		- Predicts each hour listed.
+ * stats											- Reports the request, prediction and batch counts, the
+ *													  p50 & p99 latency in microseconds and the throughput.
+ * Predictions are answered with "ok" followed by one value per hour, and mistakes with "error" followed
+ * by a message. Hours must be on the calendar, with dayOfYear 1 to 366, hour 0 to 23 and dayOfWeek 1 to 7.
+ *
+ * With a table compiled from the model by compilePredictionTable, each connection thread looks its
+ * hours up in the table itself. The table covers every hour on the calendar, and other hours are
+ * rejected, so every request is answered from the table and nothing is queued for the batching thread.
+ *
+ * Usage:
+ * server/server [--model results/model.bin] [--table results/model.table] [--socket rbf.sock | --port 5000]
+ *
+ * Build:
+ * g++ -O2 -pthread server/server.cpp io.cpp kmeans.cpp network.cpp activation.cpp grid.cpp model.cpp tables.cpp -o server/server
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../model.h"
+#include "../network.h"
+
+// The most hours a single request can ask for. A batch always has room for at least one request.
+#define SERVER_MAX_HOURS	  1024
+#define SERVER_MAX_BATCH	  8192
+#define SERVER_LATENCY_WINDOW 8192
+#define SERVER_LINE_LENGTH	  65536
+#define SERVER_BACKLOG		  64
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * A request queued for the batching thread by a connection thread, which owns its buffers.
+ *
+ * Members:
+ * const double *input				 - The normalized hours to predict, stride 3.
+ * int count						 - The number of hours.
+ * double *output					 - A preallocated array to hold the predictions. Length is count.
+ * bool answered					 - Set by the batching thread once the predictions are in output.
+ * steady_clock::time_point queuedAt - When the request was queued, for its latency.
+ */
+struct ServerRequest {
+	const double			*input;
+	int						 count;
+	double					*output;
+	bool					 answered;
+	steady_clock::time_point queuedAt;
+};
+
+/*
+ * State shared between the connection threads and the batching thread. Everything after the model
+ * is guarded by lock.
+ *
+ * Members:
+ * Model model							- The model predictions are made with. Read-only.
+ * PredictionTable table				- The model's predictions for every hour of the calendar. Read-only.
+ * bool useTable						- Whether the table was loaded.
+ * mutex lock							- Guards the queue and the counters.
+ * condition_variable queued			- Signalled when a request joins the queue.
+ * condition_variable answered			- Signalled when a batch of requests has been answered.
+ * vector<ServerRequest*> queue			- The requests waiting for the next batch, oldest first.
+ * long long requestCount				- The number of requests answered.
+ * long long predictionCount			- The number of hours predicted.
+ * long long batchCount					- The number of batches evaluated.
+ * long long tableCount					- The number of hours looked up in the table rather than batched.
+ * double latencies[]					- The latency of the most recent requests in microseconds, a ring buffer.
+ * int latencyCount						- The number of latencies recorded, up to SERVER_LATENCY_WINDOW.
+ * int latencyNext						- The next slot in the ring buffer.
+ * steady_clock::time_point startedAt	- When the server started, for the throughput.
+ */
+struct Server {
+	Model					 model;
+	PredictionTable			 table;
+	bool					 useTable;
+	mutex					 lock;
+	condition_variable		 queued;
+	condition_variable		 answered;
+	vector<ServerRequest*>	 queue;
+	long long				 requestCount;
+	long long				 predictionCount;
+	long long				 batchCount;
+	long long				 tableCount;
+	double					 latencies[SERVER_LATENCY_WINDOW];
+	int						 latencyCount;
+	int						 latencyNext;
+	steady_clock::time_point startedAt;
+};
+
+/*
+ * Orders latencies from fastest to slowest.
+ */
+static int compareLatencies(const void *a, const void *b) {
+	double latencyA = *(const double*) a, latencyB = *(const double*) b;
+	return latencyA < latencyB ? -1 : latencyA > latencyB ? 1 : 0;
+}
+
+/*
+ * Records the latency of an answered request. Call with the server's lock held.
+ *
+ * Parameters:
+ * Server *server	- The server.
+ * double latency	- The time from the request being parsed to it being answered, in microseconds.
+ */
+static void recordLatency(Server *server, double latency) {
+	server->latencies[server->latencyNext] = latency;
+	server->latencyNext	 = (server->latencyNext + 1) % SERVER_LATENCY_WINDOW;
+	server->latencyCount = server->latencyCount < SERVER_LATENCY_WINDOW ? server->latencyCount + 1 : SERVER_LATENCY_WINDOW;
+}
+
+/*
+ * Evaluates the queued requests in batches for as long as the server runs.
+ *
+ * Parameters:
+ * Server *server - The server.
+ */
+static void batchWorker(Server *server) {
+	const Model &model = server->model;
+	double *input  = (double*) malloc(sizeof(double) * SERVER_MAX_BATCH * 3);
+	double *output = (double*) malloc(sizeof(double) * SERVER_MAX_BATCH);
+	ActivationMatrix activations;
+	allocateActivationMatrix(activations, ACTIVATIONS_RECOMPUTE, ACTIVATIONS_SAMPLE_MAJOR, SERVER_MAX_BATCH, model.neuronCount);
+
+	vector<ServerRequest*> batch;
+	unique_lock<mutex> lock(server->lock);
+	while (true) {
+		while (server->queue.empty()) {
+			server->queued.wait(lock);
+		}
+
+		// Take every waiting request that fits, oldest first.
+		int rowCount = 0, taken = 0;
+		while (taken < (int) server->queue.size() && rowCount + server->queue[taken]->count <= SERVER_MAX_BATCH) {
+			rowCount += server->queue[taken++]->count;
+		}
+		batch.assign(server->queue.begin(), server->queue.begin() + taken);
+		server->queue.erase(server->queue.begin(), server->queue.begin() + taken);
+		lock.unlock();
+
+		// Gather the requests into one input matrix and evaluate them together.
+		int row = 0;
+		for (size_t i = 0; i < batch.size(); i++) {
+			memcpy(input + row * 3, batch[i]->input, sizeof(double) * 3 * batch[i]->count);
+			row += batch[i]->count;
+		}
+		getOutput(input, rowCount, model.neuronCount, model.centers, model.weights, model.width, activations, output);
+
+		row = 0;
+		steady_clock::time_point answeredAt = steady_clock::now();
+		lock.lock();
+		for (size_t i = 0; i < batch.size(); i++) {
+			ServerRequest *request = batch[i];
+			memcpy(request->output, output + row, sizeof(double) * request->count);
+			row += request->count;
+			request->answered = true;
+
+			recordLatency(server, duration<double, micro>(answeredAt - request->queuedAt).count());
+		}
+		server->requestCount	+= batch.size();
+		server->predictionCount += rowCount;
+		server->batchCount++;
+		server->answered.notify_all();
+	}
+}
+
+/*
+ * Queues a request and waits for the batching thread to answer it.
+ *
+ * Parameters:
+ * Server *server		  - The server.
+ * ServerRequest &request - The request, with its input, count & output set.
+ */
+static void predictBatched(Server *server, ServerRequest &request) {
+	unique_lock<mutex> lock(server->lock);
+	request.answered = false;
+	request.queuedAt = steady_clock::now();
+	server->queue.push_back(&request);
+	server->queued.notify_one();
+	while (!request.answered) {
+		server->answered.wait(lock);
+	}
+}
+
+/*
+ * Looks a request's hours up in the server's table. Returns false, leaving the request to be batched,
+ * if any of them is outside the table, which checkHour already rules out.
+ *
+ * Parameters:
+ * Server *server		  - The server.
+ * const int *hours		  - The hours to predict, as dayOfYear, hour & dayOfWeek. Stride 3.
+ * ServerRequest &request - The request, with its count & output set.
+ */
+static bool predictFromTable(Server *server, const int *hours, ServerRequest &request) {
+	steady_clock::time_point startedAt = steady_clock::now();
+	for (int i = 0; i < request.count; i++) {
+		request.output[i] = predictTable(server->table, hours[i * 3], hours[i * 3 + 1], hours[i * 3 + 2]);
+		if (request.output[i] != request.output[i]) {
+			return false;
+		}
+	}
+
+	double latency = duration<double, micro>(steady_clock::now() - startedAt).count();
+	unique_lock<mutex> lock(server->lock);
+	recordLatency(server, latency);
+	server->requestCount++;
+	server->predictionCount += request.count;
+	server->tableCount		+= request.count;
+	return true;
+}
+
+/*
+ * Writes the stats response for the server into a line.
+ *
+ * Parameters:
+ * Server *server - The server.
+ * char *line	  - A preallocated line of SERVER_LINE_LENGTH characters to hold the response.
+ */
+static void formatStats(Server *server, char *line) {
+	double latencies[SERVER_LATENCY_WINDOW];
+	unique_lock<mutex> lock(server->lock);
+	long long requestCount = server->requestCount, predictionCount = server->predictionCount, batchCount = server->batchCount, tableCount = server->tableCount;
+	int latencyCount = server->latencyCount;
+	memcpy(latencies, server->latencies, sizeof(double) * latencyCount);
+	lock.unlock();
+
+	qsort(latencies, latencyCount, sizeof(double), compareLatencies);
+	double p50		= latencyCount > 0 ? latencies[(latencyCount - 1) / 2] : 0;
+	double p99		= latencyCount > 0 ? latencies[(latencyCount - 1) * 99 / 100] : 0;
+	double uptime	= duration<double>(steady_clock::now() - server->startedAt).count();
+	double meanRows = batchCount > 0 ? (double) (predictionCount - tableCount) / batchCount : 0;
+	snprintf(line, SERVER_LINE_LENGTH, "ok requests=%lld predictions=%lld batches=%lld meanBatch=%.1f table=%lld p50=%.1f p99=%.1f requestsPerSecond=%.1f predictionsPerSecond=%.1f\n",
+		requestCount, predictionCount, batchCount, meanRows, tableCount, p50, p99, requestCount / uptime, predictionCount / uptime);
+}
+
+/*
+ * Checks that an hour is on the calendar: day of the year 1 to 366, hour 0 to 23 and day of the week
+ * 1 to 7. Returns false after writing an error response into the line.
+ *
+ * Parameters:
+ * long dayOfYear	- The day of the year.
+ * long hour		- The hour of the day.
+ * long dayOfWeek	- The day of the week.
+ * char *line		- The request. Overwritten with the error response if the hour is out of range.
+ */
+static bool checkHour(long dayOfYear, long hour, long dayOfWeek, char *line) {
+	if (dayOfYear < 1 || dayOfYear > 366) {
+		snprintf(line, SERVER_LINE_LENGTH, "error dayOfYear must be 1 to 366\n");
+		return false;
+	}
+	if (hour < 0 || hour > 23) {
+		snprintf(line, SERVER_LINE_LENGTH, "error hour must be 0 to 23\n");
+		return false;
+	}
+	if (dayOfWeek < 1 || dayOfWeek > 7) {
+		snprintf(line, SERVER_LINE_LENGTH, "error dayOfWeek must be 1 to 7\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Parses a request line into hours. Returns the number of hours, or -1 after writing an error
+ * response into the line.
+ *
+ * Parameters:
+ * const Model &model - The model, whose normalization constants are applied.
+ * char *line		  - The request, without its newline. Overwritten with the error response on failure.
+ * double *input	  - A preallocated matrix to hold the normalized hours, size SERVER_MAX_HOURS x 3.
+ * int *hours		  - A preallocated matrix to hold the hours as given, size SERVER_MAX_HOURS x 3.
+ */
+static int parseRequest(const Model &model, char *line, double *input, int *hours) {
+	const double *constants = model.normalizationConstants;
+	int count = 0;
+	char *end;
+
+	if (strncmp(line, "forecast ", 9) == 0) {
+		long fields[4];
+		const char *position = line + 9;
+		for (int i = 0; i < 4; i++) {
+			fields[i] = strtol(position, &end, 10);
+			if (end == position) {
+				snprintf(line, SERVER_LINE_LENGTH, "error forecast needs dayOfYear hour dayOfWeek hours\n");
+				return -1;
+			}
+			position = end;
+		}
+		if (fields[3] < 1 || fields[3] > SERVER_MAX_HOURS) {
+			snprintf(line, SERVER_LINE_LENGTH, "error hours must be 1 to %d\n", SERVER_MAX_HOURS);
+			return -1;
+		}
+		if (!checkHour(fields[0], fields[1], fields[2], line)) {
+			return -1;
+		}
+
+		// Step an hour at a time, rolling the day of the week and the day of the year on at midnight.
+		long dayOfYear = fields[0], hour = fields[1], dayOfWeek = fields[2];
+		int daysInYear = (int) constants[0];
+		for (count = 0; count < fields[3]; count++) {
+			hours[count * 3]	 = (int) dayOfYear;
+			hours[count * 3 + 1] = (int) hour;
+			hours[count * 3 + 2] = (int) dayOfWeek;
+			input[count * 3]	 = dayOfYear / constants[0];
+			input[count * 3 + 1] = hour		/ constants[1];
+			input[count * 3 + 2] = dayOfWeek / constants[2];
+			if (++hour == 24) {
+				hour	  = 0;
+				dayOfWeek = dayOfWeek % 7 + 1;
+				dayOfYear = dayOfYear % daysInYear + 1;
+			}
+		}
+		return count;
+	}
+
+	if (strncmp(line, "predict ", 8) == 0) {
+		const char *position = line + 8;
+		while (true) {
+			while (*position == ' ') {
+				position++;
+			}
+			if (*position == '\0') {
+				break;
+			}
+			if (count == SERVER_MAX_HOURS) {
+				snprintf(line, SERVER_LINE_LENGTH, "error at most %d hours per request\n", SERVER_MAX_HOURS);
+				return -1;
+			}
+			long fields[3];
+			for (int i = 0; i < 3; i++) {
+				fields[i] = strtol(position, &end, 10);
+				if (end == position || (i < 2 && *end != ',')) {
+					snprintf(line, SERVER_LINE_LENGTH, "error predict needs dayOfYear,hour,dayOfWeek for each hour\n");
+					return -1;
+				}
+				position = i < 2 ? end + 1 : end;
+			}
+			if (!checkHour(fields[0], fields[1], fields[2], line)) {
+				return -1;
+			}
+			for (int i = 0; i < 3; i++) {
+				hours[count * 3 + i] = (int) fields[i];
+				input[count * 3 + i] = fields[i] / constants[i];
+			}
+			count++;
+		}
+		if (count == 0) {
+			snprintf(line, SERVER_LINE_LENGTH, "error predict needs at least one hour\n");
+			return -1;
+		}
+		return count;
+	}
+
+	snprintf(line, SERVER_LINE_LENGTH, "error unknown command, expected forecast, predict or stats\n");
+	return -1;
+}
+
+/*
+ * Writes a whole buffer to a socket. Returns false if the client has gone.
+ *
+ * Parameters:
+ * int client		- The socket.
+ * const char *data - The data to write.
+ * size_t size		- The number of bytes to write.
+ */
+static bool writeAll(int client, const char *data, size_t size) {
+	while (size > 0) {
+		ssize_t written = send(client, data, size, 0);
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+/*
+ * Answers the requests on a connection until the client disconnects.
+ *
+ * Parameters:
+ * Server *server - The server.
+ * int client	  - The connected socket. Closed on return.
+ */
+static void serveConnection(Server *server, int client) {
+	FILE   *stream = fdopen(client, "r");
+	char   *line   = (char*)   malloc(SERVER_LINE_LENGTH);
+	double *input  = (double*) malloc(sizeof(double) * SERVER_MAX_HOURS * 3);
+	double *output = (double*) malloc(sizeof(double) * SERVER_MAX_HOURS);
+	int	   *hours  = (int*)	   malloc(sizeof(int) * SERVER_MAX_HOURS * 3);
+
+	while (stream != NULL && fgets(line, SERVER_LINE_LENGTH, stream) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0') {
+			continue;
+		}
+
+		if (strcmp(line, "stats") == 0) {
+			formatStats(server, line);
+		} else {
+			int count = parseRequest(server->model, line, input, hours);
+			if (count > 0) {
+				ServerRequest request;
+				request.input  = input;
+				request.count  = count;
+				request.output = output;
+				if (!server->useTable || !predictFromTable(server, hours, request)) {
+					predictBatched(server, request);
+				}
+
+				int length = snprintf(line, SERVER_LINE_LENGTH, "ok");
+				for (int i = 0; i < count; i++) {
+					length += snprintf(line + length, SERVER_LINE_LENGTH - length, " %.3f", output[i]);
+				}
+				snprintf(line + length, SERVER_LINE_LENGTH - length, "\n");
+			}
+		}
+		if (!writeAll(client, line, strlen(line))) {
+			break;
+		}
+	}
+
+	if (stream != NULL) {
+		fclose(stream);
+	} else {
+		close(client);
+	}
+	free(line);
+	free(input);
+	free(output);
+	free(hours);
+}
+
+/*
+ * Opens the listening socket, on a Unix domain socket path or a TCP port on the loopback interface.
+ * Returns -1 on failure.
+ *
+ * Parameters:
+ * const char *socketPath - The path of the Unix domain socket, replacing any previous one. NULL uses the port.
+ * int port				  - The TCP port.
+ */
+static int openListener(const char *socketPath, int port) {
+	int listener;
+	if (socketPath != NULL) {
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (strlen(socketPath) >= sizeof(address.sun_path)) {
+			return -1;
+		}
+		strcpy(address.sun_path, socketPath);
+		unlink(socketPath);
+		listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0) {
+			return -1;
+		}
+	} else {
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family		= AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port		= htons(port);
+		int reuse = 1;
+		listener = socket(AF_INET, SOCK_STREAM, 0);
+		if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+			|| bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0) {
+			return -1;
+		}
+	}
+	return listen(listener, SERVER_BACKLOG) == 0 ? listener : -1;
+}
+
+int main(int argc, char *argv[]) {
+	char	   *modelFilename = (char*) "results/model.bin";
+	char	   *tableFilename = NULL;
+	const char *socketPath	  = "rbf.sock";
+	int			port		  = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--model") == 0) {
+			modelFilename = argv[i + 1];
+		} else if (strcmp(argv[i], "--table") == 0) {
+			tableFilename = argv[i + 1];
+		} else if (strcmp(argv[i], "--socket") == 0) {
+			socketPath = argv[i + 1];
+		} else if (strcmp(argv[i], "--port") == 0) {
+			socketPath = NULL;
+			port	   = atoi(argv[i + 1]);
+		} else {
+			printf("Unknown option %s.\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// The server lives as long as the process, so it's never freed.
+	Server *server = new Server();
+	if (!loadModel(modelFilename, MODEL_CUTOFF, server->model)) {
+		printf("Could not load %s.\n", modelFilename);
+		return 1;
+	}
+	server->useTable = tableFilename != NULL;
+	if (server->useTable && !loadPredictionTable(tableFilename, server->table)) {
+		printf("Could not load %s.\n", tableFilename);
+		return 1;
+	}
+	server->startedAt = steady_clock::now();
+
+	int listener = openListener(socketPath, port);
+	if (listener < 0) {
+		printf("Could not listen on %s.\n", socketPath != NULL ? socketPath : "the port");
+		return 1;
+	}
+
+	// A client hanging up mid-response shouldn't take the server with it.
+	signal(SIGPIPE, SIG_IGN);
+	thread(batchWorker, server).detach();
+	if (socketPath != NULL) {
+		printf("Serving %s (%d neurons, width %.2f) on %s.\n", modelFilename, server->model.neuronCount, server->model.width, socketPath);
+	} else {
+		printf("Serving %s (%d neurons, width %.2f) on 127.0.0.1:%d.\n", modelFilename, server->model.neuronCount, server->model.width, port);
+	}
+	fflush(stdout);
+
+	while (true) {
+		int client = accept(listener, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		if (socketPath == NULL) {
+			int noDelay = 1;
+			setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		}
+		thread(serveConnection, server, client).detach();
+	}
+}
@@ -1,161 +1,152 @@
+#include "activation.h"
 #include "kmeans.hpp"
+#include "model.h"
 #include "network.h"
 #include "io.h"
+#include "sweep.h"
 
 #define EPOCH_NUM	  200
 #define LEARNING_RATE 0.02
+#define PATIENCE	  0		// Epochs without the testing error improving by MIN_DELTA before stopping. 0 uses converged.
+#define MIN_DELTA	  0
+#define RESTORE_BEST  false	// Score each network with the weights from its best epoch.
+#define SWEEP_THREADS 0		// 0 uses every available core.
+#define RANDOM_SEED	  10
+#define WARM_START	  true
+#define KMEANS		  kmeans_04	// Or kmeans_03, which gives the same clusters more slowly, or kmeansMiniBatch for very large data sets.
+#define CLUSTER_INITIALIZER INITIALIZE_FIRST_POINTS	// Or INITIALIZE_KMEANS_PLUS_PLUS for fewer iterations and lower energy, see ClusterInitializer.
+#define TRAINING_MODE TRAIN_GRADIENT_DESCENT	// Or TRAIN_LEAST_SQUARES to solve for the weights directly.
+#define RIDGE		  1e-6
+#define ACTIVATION_LAYOUT ACTIVATIONS_SAMPLE_MAJOR	// Or ACTIVATIONS_NEURON_MAJOR.
+#define ACTIVATION_STORAGE ACTIVATIONS_DOUBLE	// Or FLOAT, BFLOAT16 or RECOMPUTE to save memory.
+#define ACTIVATION_TABLES true	// Look the activations up in per-dimension tables over the calendar inputs instead of using exp.
+#define FAST_EXP	  false	// Calculate exp with a shorter polynomial, within 2e-7 of exp. See ActivationPrecision, and test/test for its effect.
+#define TRAIN_THREADS 1		// The sweep already runs a network per core.
+#define HALVING_EPOCHS 0	// Epochs before the first successive halving cut, or 0 to train every configuration fully. Cut configurations are saved as NaN.
+#define HALVING_RATE   3	// Each cut keeps the best third.
+#define SPARSE_CUTOFF  0	// 0 evaluates every neuron. 6 skips neurons contributing under exp(-6^2 / 2) in the testing & validation outputs, faster but approximate.
+#define MODEL_FILENAME "results/model.bin"	// The best configuration is saved here for predictModel.
+#define TABLE_FILENAME "results/model.table"	// And compiled into a table of every prediction here for predictTable.
+#define TABLE_PRECISION TABLE_QUANTIZED	// Or TABLE_DOUBLE for the network's exact predictions.
+#define COMPACT_DATA  true	// Merge rows with identical inputs into weighted data points once the training data is clustered.
+#define CHECKPOINT_FILENAME "results/sweep.checkpoint"	// Progress is saved here and resumed after a crash.
+#define CHECKPOINT_EPOCHS 20	// Each configuration still training is saved every this many epochs, as well as when a round ends.
 
 using namespace std;
 
-int main(int argc, char *argv) {
-	// Define normalization constants: maxDayOfYear, maxHour, maxDay
-	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
-
-	// Seed the random number generator so that experiments are comparible.
-	srand(10);
-
-	// Read in the training data.
-	printf("Loading training data...\n");
-	char   *filename	   = "data/train.csv";
-	int     trainDataCount = getFileSize(filename);
-	double *trainData      = (double*) malloc(sizeof(double) * trainDataCount * 3);
-	double *trainTarget    = (double*) malloc(sizeof(double) * trainDataCount);
-	double *trainOutput	   = (double*) malloc(sizeof(double) * trainDataCount);
-	loadData(filename, normalizationConstants, trainData, trainTarget);
-
-	// Read in the testing data.
-	printf("Loading testing data...\n");
-	        filename	  = "data/test.csv";
-	int     testDataCount = getFileSize(filename);
-	double *testData	  = (double*) malloc(sizeof(double) * testDataCount * 3);
-	double *testTarget    = (double*) malloc(sizeof(double) * testDataCount);
-	double *testOutput	  = (double*) malloc(sizeof(double) * testDataCount);
-	loadData(filename, normalizationConstants, testData, testTarget);
-
-	// Read in the validation data.
-	printf("Loading validation data...\n");
-	filename	  = "data/validation.csv";
-	int     validationtDataCount = getFileSize(filename);
-	double *validationData	     = (double*) malloc(sizeof(double) * validationtDataCount * 3);
-	double *validationTarget     = (double*) malloc(sizeof(double) * validationtDataCount);
-	double *validationOutput     = (double*) malloc(sizeof(double) * validationtDataCount);
-	loadData(filename, normalizationConstants, validationData, validationTarget);
-	
-	/*
-	  Configuration range:
-	  neuronCount 50:10:500      - 46 rows
-	  neuronWidth 0.01:0.01:0.1  - 10 columns
-	  Total trial configurations - 460
-	*/
-
-	// Allocate space for the optimisation results.
-	float *optimisationResults = (float*) malloc(sizeof(float) * 46 * 10);
-
-	// Allocate space for the training error.
-	int    epochCount = EPOCH_NUM;
-	float *epochRms   = (float*) malloc(sizeof(float) * epochCount * 2);
-
-	// Run the optimisation loop.
-	int countIndex = 0;
-	for (int neuronCount = 50; neuronCount <= 500; neuronCount += 10) {
-
-		// Prellocate space for calculating network output.
-		double *weights					   = (double*) malloc(sizeof(double) * neuronCount);
-		double *outputValues			   = (double*) malloc(sizeof(double) * neuronCount);
-		double *clusterCenters			   = (double*) malloc(sizeof(double) * neuronCount * 3);
-		double *testActivationValues	   = (double*) malloc(sizeof(double) * neuronCount * testDataCount);
-		double *trainActivationValues	   = (double*) malloc(sizeof(double) * neuronCount * trainDataCount);
-		double *validationActivationValues = (double*) malloc(sizeof(double) * neuronCount * validationtDataCount);
-
-		// Allocate memory for kmeans.
-		// printf("Allocating memory for kmeans...\n");
-		double *clusterEnergies    = (double*) malloc(sizeof(double) * neuronCount);
-		int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * trainDataCount);
-		int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * neuronCount);
-
-		// Initialise cluster centers to the first few data points.
-		printf("\nRunning k-means algorithm...\n");
-		for (int i = 0; i < neuronCount; i++) {
-			for (int j = 0; j < 3; j++) {
-				clusterCenters[i * 3 + j] = trainData[i * 3 + j];
-			}
-		}
-
-		// Run the kmeans algorithm.
-		int iterationCount = 0;
-		kmeans_03(3, trainDataCount, neuronCount, 500, iterationCount, trainData, clusterAllocations, clusterCenters, clusterPopulations, clusterEnergies);
-		printf("K-means converged in %d iterations.\n", iterationCount);
-
-		// Free the uneeded kmeans variables.
-		free(clusterEnergies);
-		free(clusterAllocations);
-		free(clusterPopulations);
-
-		int widthIndex = 0;
-		for (double neuronWidth = 0.01; neuronWidth <= 0.1; neuronWidth += 0.01) {			
-			// Randomize the weights matrix.
-			randomMatrix(weights, 1, neuronCount, 1);
-
-			// Start the main training loop.
-			for (int epoch = 0; epoch < epochCount; epoch++) {
-				// Get the network's output for the training data set.
-				getOutput(trainData, trainDataCount, neuronCount, clusterCenters, weights, neuronWidth, outputValues, trainActivationValues, trainOutput);
-
-				// Get the network's output for the testing data set.
-				getOutput(testData, testDataCount, neuronCount, clusterCenters, weights, neuronWidth, outputValues, testActivationValues, testOutput);
-
-				// Calculate the network error for the training & testing data set.
-				epochRms[2 * epoch]		= calculateError(trainTarget, trainOutput, trainDataCount);
-				epochRms[2 * epoch + 1] = calculateError(testTarget,  testOutput,  testDataCount);
-
-				// Check if we've converged on a solution.
-				if (converged(epochRms, epoch)) {
-					epochCount = epoch;
-					break;
-				}
+/*
+ * Maps in a data set from its binary file. If the binary file is missing, or the CSV file's size or
+ * modification time has changed since it was converted, the CSV file is parsed instead and saved as
+ * the binary file for next time. Exits if the CSV file is malformed.
+ *
+ * Parameters:
+ * const char *name						- The name of the data set, for progress messages.
+ * char *csvFilename					- The name of the CSV file.
+ * char *binaryFilename					- The name of the binary file.
+ * const double *normalizationConstants	- Constants used to normalize the input data.
+ * DataSet &dataSet						- The data set to fill. Release it with freeDataSet.
+ */
+static void openDataSet(const char *name, char *csvFilename, char *binaryFilename, const double *normalizationConstants, DataSet &dataSet) {
+	printf("Loading %s data...\n", name);
+	if (mapData(binaryFilename, csvFilename, normalizationConstants, dataSet)) {
+		return;
+	}
 
-				// We haven't converged. Keep training the network.
-				train(LEARNING_RATE, trainDataCount, trainOutput, trainActivationValues, trainTarget, neuronCount, weights);
-			}
+	printf("Converting %s to %s...\n", csvFilename, binaryFilename);
+	if (!parseData(csvFilename, normalizationConstants, dataSet)) {
+		exit(1);
+	}
+	if (!saveData(binaryFilename, csvFilename, normalizationConstants, dataSet)) {
+		printf("Could not write %s, the CSV file will be parsed again next time.\n", binaryFilename);
+	}
+}
+
+/*
+ * Compiles a saved model into a table of its prediction for every hour of the calendar, and saves it.
+ *
+ * Parameters:
+ * char *modelFilename		- The model file written by the sweep.
+ * char *tableFilename		- The table file to write.
+ * TablePrecision precision	- How the predictions are stored.
+ */
+static void exportTable(char *modelFilename, char *tableFilename, TablePrecision precision) {
+	Model model;
+	if (!loadModel(modelFilename, MODEL_CUTOFF, model)) {
+		printf("Could not load %s to compile it.\n", modelFilename);
+		return;
+	}
 
-			// The network is trained. Get the output for the validation dataset.
-			getOutput(validationData, validationtDataCount, neuronCount, clusterCenters, weights, neuronWidth, outputValues, testActivationValues, validationOutput);
+	PredictionTable table;
+	double maxError = compilePredictionTable(model, precision, table);
+	if (savePredictionTable(tableFilename, table)) {
+		printf("Compiled %s into %s, within %.4f of the network.\n", modelFilename, tableFilename, maxError);
+	} else {
+		printf("Could not write %s.\n", tableFilename);
+	}
+	freePredictionTable(table);
+	freeModel(model);
+}
 
-			// Calculate the error for the validation dataset.
-			float finalError = calculateError(validationTarget, validationOutput, validationtDataCount);
-			printf("Count %d\tWidth %.2f\tError %.4f\n", neuronCount, neuronWidth, finalError);
+int main(int argc, char *argv[]) {
+	// Define normalization constants: maxDayOfYear, maxHour, maxDay
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
 
-			// Now that we've trained the network, we should save the results.
-			optimisationResults[10 * countIndex + widthIndex] = finalError;
+	// Map in the training, testing & validation data, converting the CSV files the first time through.
+	DataSet train, test, validation;
+	openDataSet("training",	  "data/train.csv",		 "data/train.bin",		normalizationConstants, train);
+	openDataSet("testing",	  "data/test.csv",		 "data/test.bin",		normalizationConstants, test);
+	openDataSet("validation", "data/validation.csv", "data/validation.bin", normalizationConstants, validation);
 
-			// Reset the epoch count incase we converged and changed the value.
-			epochCount = EPOCH_NUM;
-			widthIndex++;
-		}
-		free(weights);
-		free(outputValues);
-		free(clusterCenters);
-		free(testActivationValues);
-		free(trainActivationValues);
-		free(validationActivationValues);
+	// Pick how accurately the network's activations are calculated before any threads start.
+	selectActivationPrecision(FAST_EXP ? PRECISION_FAST : PRECISION_EXACT);
 
-		countIndex++;
-	}
+	// Allocate space for the optimisation results.
+	float *optimisationResults = (float*) malloc(sizeof(float) * SWEEP_COUNT_NUM * SWEEP_WIDTH_NUM);
+
+	// Run every configuration across all of the available cores.
+	SweepSettings settings;
+	settings.countMin		   = SWEEP_COUNT_MIN;
+	settings.countStep		   = SWEEP_COUNT_STEP;
+	settings.countNum		   = SWEEP_COUNT_NUM;
+	settings.widthMin		   = SWEEP_WIDTH_MIN;
+	settings.widthStep		   = SWEEP_WIDTH_STEP;
+	settings.widthNum		   = SWEEP_WIDTH_NUM;
+	settings.epochCount		   = EPOCH_NUM;
+	settings.learningRate	   = LEARNING_RATE;
+	settings.convergence.patience	 = PATIENCE;
+	settings.convergence.minDelta	 = MIN_DELTA;
+	settings.convergence.restoreBest = RESTORE_BEST;
+	settings.threadCount	   = SWEEP_THREADS;
+	settings.seed			   = RANDOM_SEED;	// Seeded so that experiments are comparible.
+	settings.warmStartClusters = WARM_START;
+	settings.kmeans			   = KMEANS;
+	settings.clusterInitializer = CLUSTER_INITIALIZER;
+	settings.trainingMode	   = TRAINING_MODE;
+	settings.ridge			   = RIDGE;
+	settings.activationLayout  = ACTIVATION_LAYOUT;
+	settings.activationStorage = ACTIVATION_STORAGE;
+	settings.activationTables  = ACTIVATION_TABLES;
+	settings.trainThreads	   = TRAIN_THREADS;
+	settings.halvingEpochs	   = HALVING_EPOCHS;
+	settings.halvingRate	   = HALVING_RATE;
+	settings.sparseCutoff	   = SPARSE_CUTOFF;
+	settings.compactData	   = COMPACT_DATA;
+	settings.modelFilename	   = (char*) MODEL_FILENAME;
+	settings.normalizationConstants = normalizationConstants;
+	settings.checkpointFilename = (char*) CHECKPOINT_FILENAME;
+	settings.checkpointEpochs	= CHECKPOINT_EPOCHS;
+	runSweep(settings, train, test, validation, optimisationResults);
 
 	// Output the optimisation results to a file so that we can plot graphs in another program!
-	matrixToFile("results/optimizationResults.txt", optimisationResults, 46, 10);
+	matrixToFile("results/optimizationResults.txt", optimisationResults, SWEEP_COUNT_NUM, SWEEP_WIDTH_NUM);
+
+	// Compile the best network into a table, so predictions don't depend on the number of neurons.
+	exportTable((char*) MODEL_FILENAME, (char*) TABLE_FILENAME, TABLE_PRECISION);
 
 	// Free the allocated memory.
 	free(optimisationResults);
-	free(trainTarget);
-	free(trainOutput);
-	free(testTarget);
-	free(testOutput);
-	free(validationTarget);
-	free(validationOutput);
-	free(validationData);
-	free(trainData);
-	free(testData);
-	free(epochRms);
+	freeDataSet(train);
+	freeDataSet(test);
+	freeDataSet(validation);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,1105 @@
+#include <stdio.h>
+#include <cmath>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "clusters.h"
+#include "model.h"
+#include "network.h"
+#include "sweep.h"
+
+// The checkpoint file format. Bump the version whenever the layout changes so old checkpoints are ignored.
+#define CHECKPOINT_MAGIC   "RBFCKPT"
+#define CHECKPOINT_VERSION 2
+
+using namespace std;
+
+/*
+ * The progress of a single configuration. Training can stop after any epoch and carry on from the
+ * same point later, so the sweep can cut configurations between rounds.
+ *
+ * Members:
+ * double *weights	   - The weight array for the network.
+ * double *bestWeights - The weights as they were at the best epoch, for ConvergencePolicy.restoreBest.
+ * float *epochRms	   - The training and testing error per epoch. Stride 2. A configuration solved
+ *						 by least squares has no epochs, and keeps the testing error of its solution
+ *						 in epochRms[1] for cutQueue.
+ * int epoch		   - The number of epochs run so far.
+ * int bestEpoch	   - The best epoch so far, see checkConvergence. -1 before the first epoch.
+ * bool started		   - Whether the weights have been initialised.
+ * bool finished	   - Whether training has converged, run out of epochs or been solved directly.
+ */
+struct SweepTrial {
+	double *weights;
+	double *bestWeights;
+	float  *epochRms;
+	int		epoch;
+	int		bestEpoch;
+	bool	started;
+	bool	finished;
+};
+
+/*
+ * The header at the start of a checkpoint file. The cluster centers for each neuronCount follow it,
+ * then a CheckpointTrial for each configuration.
+ *
+ * Members:
+ * char magic[8]			 - CHECKPOINT_MAGIC, null terminated.
+ * uint32_t version			 - CHECKPOINT_VERSION.
+ * uint32_t trialCount		 - The number of configurations in the sweep.
+ * uint64_t key				 - A checksum of the settings and data the sweep depends on, see checkpointKey.
+ * uint32_t clustersSaved	 - Whether the cluster centers have been saved.
+ * uint32_t reserved		 - Zero.
+ * uint64_t clustersChecksum - The checksum of the cluster centers.
+ */
+struct CheckpointHeader {
+	char	 magic[8];
+	uint32_t version;
+	uint32_t trialCount;
+	uint64_t key;
+	uint32_t clustersSaved;
+	uint32_t reserved;
+	uint64_t clustersChecksum;
+};
+
+/*
+ * The progress of one configuration in a checkpoint file, followed by its weights, its best weights
+ * and its epochRms.
+ *
+ * Members:
+ * int32_t epoch	 - The number of epochs run so far.
+ * int32_t bestEpoch - The best epoch so far.
+ * uint32_t started	 - Whether the configuration has been started. Slots that haven't are never read.
+ * uint32_t finished - Whether training has finished.
+ * uint64_t checksum - The checksum of the weights, best weights and epochRms that follow.
+ */
+struct CheckpointTrial {
+	int32_t	 epoch;
+	int32_t	 bestEpoch;
+	uint32_t started;
+	uint32_t finished;
+	uint64_t checksum;
+};
+
+/*
+ * An open checkpoint file. Every configuration has a slot of its own at a fixed offset, which is
+ * rewritten whenever the configuration finishes a round, and every checkpointEpochs epochs as it trains.
+ *
+ * Members:
+ * FILE *file				- The checkpoint file, or NULL if it couldn't be opened.
+ * mutex lock				- Serializes the writes of the worker threads.
+ * CheckpointHeader header	- The header as last written.
+ * bool resumed				- Whether the file was left by an earlier run of the same sweep.
+ * long long clustersOffset	- The position of the cluster centers in the file.
+ * long long *trialOffsets	- The position of each configuration's slot in the file.
+ */
+struct SweepCheckpoint {
+	FILE			*file;
+	mutex			 lock;
+	CheckpointHeader header;
+	bool			 resumed;
+	long long		 clustersOffset;
+	long long		*trialOffsets;
+};
+
+/*
+ * State shared between the sweep's worker threads.
+ *
+ * Members:
+ * const SweepSettings *settings - The options for the sweep.
+ * const DataSet *train			 - The training data set.
+ * const DataSet *test			 - The testing data set.
+ * const DataSet *validation	 - The validation data set.
+ * const ClusterCache *clusters	 - The cluster centers for each neuronCount. Shared read-only.
+ * float *optimisationResults	 - The validation error of each configuration.
+ * SweepTrial *trials			 - The progress of each configuration.
+ * SweepCheckpoint *checkpoint	 - The checkpoint file progress is saved to, or NULL.
+ * int *queue					 - The configurations to be run by the current round.
+ * int queueCount				 - The number of configurations in the queue.
+ * int epochTarget				 - The number of epochs to train each configuration in the queue up to.
+ * atomic<int> nextIndex		 - The next piece of work to be claimed from the queue.
+ */
+struct SweepState {
+	const SweepSettings *settings;
+	const DataSet		*train;
+	const DataSet		*test;
+	const DataSet		*validation;
+	const ClusterCache	*clusters;
+	float				*optimisationResults;
+	SweepTrial			*trials;
+	SweepCheckpoint		*checkpoint;
+	int					*queue;
+	int					 queueCount;
+	int					 epochTarget;
+	atomic<int>			 nextIndex;
+};
+
+/*
+ * The scratch buffers owned by a single worker thread. Sized for the largest neuronCount in the
+ * grid so they can be reused for every configuration the worker runs.
+ *
+ * Members:
+ * ActivationMatrix trainActivations - The activation values for the training data set.
+ * ActivationMatrix testActivations	 - The activation matrix for the testing or validation data set. Never stored.
+ * double *trainOutput				 - The network output for the training data set.
+ * double *trainResiduals			 - The residual target - output of each training data point.
+ * double *testOutput				 - The network output for the testing data set.
+ * double *validationOutput			 - The network output for the validation data set.
+ */
+struct SweepWorker {
+	ActivationMatrix trainActivations;
+	ActivationMatrix testActivations;
+	double			*trainOutput;
+	double			*trainResiduals;
+	double			*testOutput;
+	double			*validationOutput;
+};
+
+/*
+ * Ranks a configuration by its latest testing error, for cutting the sweep between rounds.
+ *
+ * Members:
+ * float testError - The configuration's latest testing error.
+ * int trialIndex  - The position of the configuration in the grid.
+ */
+struct SweepRank {
+	float testError;
+	int	  trialIndex;
+};
+
+/*
+ * Returns the neuronCount for the given row of the grid.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * int countIndex				 - The row of the grid.
+ */
+static int sweepCount(const SweepSettings &settings, int countIndex) {
+	return settings.countMin + countIndex * settings.countStep;
+}
+
+/*
+ * Returns the neuronWidth for the given column of the grid.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * int widthIndex				 - The column of the grid.
+ */
+static double sweepWidth(const SweepSettings &settings, int widthIndex) {
+	return settings.widthMin + widthIndex * settings.widthStep;
+}
+
+/*
+ * Derives the random number generator seed for a single configuration by hashing the base seed
+ * with the configuration's position in the grid. The result is in the range accepted by r8_uniform_01.
+ *
+ * Parameters:
+ * int seed		  - The base seed for the sweep.
+ * int trialIndex - The position of the configuration in the grid.
+ */
+static int trialSeed(int seed, int trialIndex) {
+	unsigned int hash = (unsigned int) seed * 2654435761u ^ (unsigned int) (trialIndex + 1) * 2246822519u;
+	hash ^= hash >> 15;
+	hash *= 2246822519u;
+	hash ^= hash >> 13;
+	hash *= 3266489917u;
+	hash ^= hash >> 16;
+	return (int) (hash % 2147483646u) + 1;
+}
+
+/*
+ * Returns a checksum of the settings and data a sweep's results depend on, so a checkpoint is only
+ * resumed by the sweep that wrote it. The k-means routine isn't included, so delete the checkpoint
+ * after changing it.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const DataSet &train			 - The training data set.
+ * const DataSet &test			 - The testing data set.
+ */
+static uint64_t checkpointKey(const SweepSettings &settings, const DataSet &train, const DataSet &test) {
+	const double values[] = {
+		(double) settings.countMin, (double) settings.countStep, (double) settings.countNum,
+		settings.widthMin, settings.widthStep, (double) settings.widthNum,
+		(double) settings.epochCount, settings.learningRate, (double) settings.convergence.patience,
+		settings.convergence.minDelta, (double) settings.convergence.restoreBest, (double) settings.seed,
+		(double) settings.warmStartClusters, (double) settings.clusterInitializer, (double) settings.trainingMode,
+		settings.ridge, (double) settings.activationLayout, (double) settings.activationStorage, (double) settings.activationTables,
+		(double) settings.halvingEpochs, (double) settings.halvingRate, settings.sparseCutoff, (double) settings.compactData,
+		(double) train.count, (double) test.count
+	};
+	uint64_t key = checksum(14695981039346656037ull, values, sizeof(values) / sizeof(values[0]));
+	key = checksum(key, train.input, (size_t) train.count * 3);
+	key = checksum(key, train.target, train.count);
+	key = checksum(key, test.input, (size_t) test.count * 3);
+	key = checksum(key, test.target, test.count);
+
+	// Compacted data sets also depend on their weights.
+	if (train.weight != NULL) {
+		key = checksum(key, train.weight, train.count);
+	}
+	if (test.weight != NULL) {
+		key = checksum(key, test.weight, test.count);
+	}
+	return key;
+}
+
+/*
+ * Writes a block of data at an offset in a checkpoint file. Returns false on failure.
+ *
+ * Parameters:
+ * FILE *file		- The checkpoint file.
+ * long long offset	- The position to write at.
+ * const void *data	- The data to write.
+ * size_t size		- The number of bytes to write.
+ */
+static bool writeCheckpointBlock(FILE *file, long long offset, const void *data, size_t size) {
+	return fseek(file, (long) offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+}
+
+/*
+ * Reads a block of data from an offset in a checkpoint file. Returns false on failure.
+ *
+ * Parameters:
+ * FILE *file		- The checkpoint file.
+ * long long offset	- The position to read from.
+ * void *data		- A preallocated buffer to hold the data.
+ * size_t size		- The number of bytes to read.
+ */
+static bool readCheckpointBlock(FILE *file, long long offset, void *data, size_t size) {
+	return fseek(file, (long) offset, SEEK_SET) == 0 && fread(data, 1, size, file) == size;
+}
+
+/*
+ * Returns the checksum of a configuration's weights, best weights and epochRms.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const SweepTrial &trial		 - The configuration.
+ * int neuronCount				 - The number of neurons in the configuration's network.
+ */
+static uint64_t trialChecksum(const SweepSettings &settings, const SweepTrial &trial, int neuronCount) {
+	uint64_t hash = checksum(14695981039346656037ull, trial.weights, neuronCount);
+	hash = checksum(hash, trial.bestWeights, neuronCount);
+
+	return checksumBytes(hash, trial.epochRms, sizeof(float) * settings.epochCount * 2);
+}
+
+/*
+ * Opens the sweep's checkpoint file. If it was written by an earlier run of the same sweep it is
+ * kept to be resumed from, otherwise it is started afresh.
+ *
+ * Parameters:
+ * SweepState *state			- The state shared between the workers.
+ * SweepCheckpoint &checkpoint	- The checkpoint to open. Release it with closeCheckpoint.
+ */
+static void openCheckpoint(SweepState *state, SweepCheckpoint &checkpoint) {
+	const SweepSettings &settings = *state->settings;
+	int trialCount = settings.countNum * settings.widthNum;
+
+	// Lay out the centers of every neuronCount, then a slot for every configuration.
+	long long offset = sizeof(CheckpointHeader);
+	checkpoint.clustersOffset = offset;
+	for (int countIndex = 0; countIndex < settings.countNum; countIndex++) {
+		offset += sizeof(double) * sweepCount(settings, countIndex) * 3;
+	}
+	checkpoint.trialOffsets = (long long*) malloc(sizeof(long long) * trialCount);
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		checkpoint.trialOffsets[trialIndex] = offset;
+		offset += sizeof(CheckpointTrial) + sizeof(double) * sweepCount(settings, trialIndex / settings.widthNum) * 2 + sizeof(float) * settings.epochCount * 2;
+	}
+
+	uint64_t key = checkpointKey(settings, *state->train, *state->test);
+	CheckpointHeader &header = checkpoint.header;
+	checkpoint.file	   = fopen(settings.checkpointFilename, "r+b");
+	checkpoint.resumed = checkpoint.file != NULL
+		&& fread(&header, sizeof(header), 1, checkpoint.file) == 1
+		&& memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0
+		&& header.version == CHECKPOINT_VERSION
+		&& header.trialCount == (uint32_t) trialCount
+		&& header.key == key;
+	if (checkpoint.resumed) {
+		return;
+	}
+
+	if (checkpoint.file != NULL) {
+		fclose(checkpoint.file);
+	}
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, CHECKPOINT_MAGIC);
+	header.version	  = CHECKPOINT_VERSION;
+	header.trialCount = trialCount;
+	header.key		  = key;
+	checkpoint.file	  = fopen(settings.checkpointFilename, "w+b");
+	if (checkpoint.file == NULL || !writeCheckpointBlock(checkpoint.file, 0, &header, sizeof(header)) || fflush(checkpoint.file) != 0) {
+		printf("Could not write %s, the sweep can't be resumed.\n", settings.checkpointFilename);
+		if (checkpoint.file != NULL) {
+			fclose(checkpoint.file);
+		}
+		checkpoint.file = NULL;
+	}
+}
+
+/*
+ * Closes the sweep's checkpoint file, removing it once the sweep is complete.
+ *
+ * Parameters:
+ * SweepState *state			- The state shared between the workers.
+ * SweepCheckpoint &checkpoint	- The checkpoint to close.
+ */
+static void closeCheckpoint(SweepState *state, SweepCheckpoint &checkpoint) {
+	if (checkpoint.file != NULL) {
+		fclose(checkpoint.file);
+		remove(state->settings->checkpointFilename);
+	}
+	free(checkpoint.trialOffsets);
+}
+
+/*
+ * Fills a cluster cache from the centers saved in a resumed checkpoint. Returns false, leaving the
+ * cache unallocated, if they weren't saved or fail their checksum.
+ *
+ * Parameters:
+ * SweepState *state	- The state shared between the workers.
+ * ClusterCache &cache	- The cache to fill. Release it with freeClusterCache.
+ */
+static bool readCheckpointClusters(SweepState *state, ClusterCache &cache) {
+	const SweepSettings &settings	= *state->settings;
+	SweepCheckpoint		&checkpoint = *state->checkpoint;
+	if (checkpoint.file == NULL || !checkpoint.resumed || !checkpoint.header.clustersSaved) {
+		return false;
+	}
+
+	cache.countNum		 = settings.countNum;
+	cache.neuronCounts	 = (int*)	  malloc(sizeof(int)	 * settings.countNum);
+	cache.centers		 = (double**) malloc(sizeof(double*) * settings.countNum);
+	cache.iterationCount = (int*)	  calloc(settings.countNum, sizeof(int));
+
+	bool	 valid	= true;
+	uint64_t hash	= 14695981039346656037ull;
+	long long offset = checkpoint.clustersOffset;
+	for (int countIndex = 0; countIndex < settings.countNum; countIndex++) {
+		int neuronCount = sweepCount(settings, countIndex);
+		cache.neuronCounts[countIndex] = neuronCount;
+		cache.centers[countIndex]	   = (double*) malloc(sizeof(double) * neuronCount * 3);
+		valid  = valid && readCheckpointBlock(checkpoint.file, offset, cache.centers[countIndex], sizeof(double) * neuronCount * 3);
+		hash   = checksum(hash, cache.centers[countIndex], (size_t) neuronCount * 3);
+		offset += sizeof(double) * neuronCount * 3;
+	}
+	if (!valid || hash != checkpoint.header.clustersChecksum) {
+		freeClusterCache(cache);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Saves the cluster centers to the checkpoint, so a resumed sweep doesn't cluster the data again.
+ *
+ * Parameters:
+ * SweepState *state		 - The state shared between the workers.
+ * const ClusterCache &cache - The cluster centers for each neuronCount.
+ */
+static void writeCheckpointClusters(SweepState *state, const ClusterCache &cache) {
+	SweepCheckpoint &checkpoint = *state->checkpoint;
+	if (checkpoint.file == NULL) {
+		return;
+	}
+
+	bool	 written = true;
+	uint64_t hash	 = 14695981039346656037ull;
+	long long offset = checkpoint.clustersOffset;
+	for (int countIndex = 0; countIndex < cache.countNum; countIndex++) {
+		size_t size = sizeof(double) * cache.neuronCounts[countIndex] * 3;
+		written = written && writeCheckpointBlock(checkpoint.file, offset, cache.centers[countIndex], size);
+		hash	= checksum(hash, cache.centers[countIndex], (size_t) cache.neuronCounts[countIndex] * 3);
+		offset += size;
+	}
+
+	// The header only claims the centers once they are all written.
+	checkpoint.header.clustersSaved	   = written;
+	checkpoint.header.clustersChecksum = hash;
+	if (!written || !writeCheckpointBlock(checkpoint.file, 0, &checkpoint.header, sizeof(checkpoint.header)) || fflush(checkpoint.file) != 0) {
+		printf("Could not write the cluster centers to %s.\n", state->settings->checkpointFilename);
+	}
+}
+
+/*
+ * Restores the progress of every configuration saved in a resumed checkpoint. Configurations whose
+ * slot was never written or fails its checksum start again. Returns the number restored.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers, with every trial allocated.
+ */
+static int readCheckpointTrials(SweepState *state) {
+	const SweepSettings &settings	= *state->settings;
+	SweepCheckpoint		&checkpoint = *state->checkpoint;
+	if (checkpoint.file == NULL || !checkpoint.resumed) {
+		return 0;
+	}
+
+	int restoredCount = 0, trialCount = settings.countNum * settings.widthNum;
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		SweepTrial &trial		= state->trials[trialIndex];
+		int			neuronCount = sweepCount(settings, trialIndex / settings.widthNum);
+		long long	offset		= checkpoint.trialOffsets[trialIndex];
+
+		CheckpointTrial record;
+		bool valid = readCheckpointBlock(checkpoint.file, offset, &record, sizeof(record))
+			&& record.started
+			&& record.epoch >= 0 && record.epoch <= settings.epochCount
+			&& readCheckpointBlock(checkpoint.file, offset + sizeof(record), trial.weights, sizeof(double) * neuronCount)
+			&& readCheckpointBlock(checkpoint.file, offset + sizeof(record) + sizeof(double) * neuronCount, trial.bestWeights, sizeof(double) * neuronCount)
+			&& readCheckpointBlock(checkpoint.file, offset + sizeof(record) + sizeof(double) * neuronCount * 2, trial.epochRms, sizeof(float) * settings.epochCount * 2)
+			&& trialChecksum(settings, trial, neuronCount) == record.checksum;
+		if (valid) {
+			trial.epoch		= record.epoch;
+			trial.bestEpoch = record.bestEpoch;
+			trial.started	= true;
+			trial.finished	= record.finished != 0;
+			restoredCount++;
+		}
+	}
+	return restoredCount;
+}
+
+/*
+ * Saves the progress of a configuration to its slot in the checkpoint.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers.
+ * int trialIndex	 - The position of the configuration in the grid.
+ */
+static void writeCheckpointTrial(SweepState *state, int trialIndex) {
+	const SweepSettings &settings	= *state->settings;
+	SweepCheckpoint		&checkpoint = *state->checkpoint;
+	const SweepTrial	&trial		= state->trials[trialIndex];
+	if (checkpoint.file == NULL) {
+		return;
+	}
+
+	int neuronCount = sweepCount(settings, trialIndex / settings.widthNum);
+	CheckpointTrial record;
+	memset(&record, 0, sizeof(record));
+	record.epoch	 = trial.epoch;
+	record.bestEpoch = trial.bestEpoch;
+	record.started	 = trial.started;
+	record.finished	 = trial.finished;
+	record.checksum	 = trialChecksum(settings, trial, neuronCount);
+
+	// Each slot is written in one go, so a sweep stopped part way through at worst loses the slot it was writing.
+	lock_guard<mutex> lock(checkpoint.lock);
+	long long offset = checkpoint.trialOffsets[trialIndex];
+	bool written = writeCheckpointBlock(checkpoint.file, offset, &record, sizeof(record))
+		&& fwrite(trial.weights, sizeof(double), neuronCount, checkpoint.file) == (size_t) neuronCount
+		&& fwrite(trial.bestWeights, sizeof(double), neuronCount, checkpoint.file) == (size_t) neuronCount
+		&& fwrite(trial.epochRms, sizeof(float), settings.epochCount * 2, checkpoint.file) == (size_t) settings.epochCount * 2
+		&& fflush(checkpoint.file) == 0;
+	if (!written) {
+		printf("Could not write to %s.\n", settings.checkpointFilename);
+	}
+}
+
+/*
+ * Returns the weights a configuration is scored with, which are its best ones under
+ * ConvergencePolicy.restoreBest, and the ones it stopped with otherwise.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * SweepTrial &trial			 - The configuration.
+ */
+static double *scoredWeights(const SweepSettings &settings, SweepTrial &trial) {
+	return settings.convergence.restoreBest && trial.bestEpoch >= 0 ? trial.bestWeights : trial.weights;
+}
+
+/*
+ * Turns the residuals of a compacted data set into the sum of the residuals of the rows each data
+ * point stands for, which are the residuals the weight update needs, and returns the squared error
+ * over those rows. See DataSet.
+ *
+ * Parameters:
+ * const DataSet &dataSet - The data set, which must have weights.
+ * const double *output	  - The network's output for each data point.
+ * double *residuals	  - A preallocated array to hold the summed residuals, or NULL if they aren't needed.
+ */
+static double weightedSquaredError(const DataSet &dataSet, const double *output, double *residuals) {
+	double squaredError = dataSet.targetSpread;
+	for (int dataIndex = 0; dataIndex < dataSet.count; dataIndex++) {
+		double residual = dataSet.target[dataIndex] - dataSet.weight[dataIndex] * output[dataIndex];
+		if (residuals != NULL) {
+			residuals[dataIndex] = residual;
+		}
+		squaredError += residual * residual / dataSet.weight[dataIndex];
+	}
+	return squaredError;
+}
+
+/*
+ * Calculates the output of a network for the testing or validation data set and returns its
+ * root-mean-squared error. With a sparseCutoff, only the neurons near each input are evaluated. The
+ * training data set always uses getOutputError, as the weight update needs every activation.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const DataSet &dataSet		 - The data set to evaluate.
+ * const NeuronGrid &grid		 - The network's centers bucketed into a grid. Only used with a sparseCutoff.
+ * SweepWorker &worker			 - The buffers owned by the calling worker.
+ * int neuronCount				 - The number of neurons in the network.
+ * double *clusterCenters		 - The centers of the network.
+ * double *weights				 - The weights of the network.
+ * double neuronWidth			 - The width of each neuron.
+ * double *output				 - A preallocated array to hold the result.
+ */
+static float evaluateOutput(const SweepSettings &settings, const DataSet &dataSet, const NeuronGrid &grid, SweepWorker &worker, int neuronCount, double *clusterCenters, double *weights, double neuronWidth, double *output) {
+	double squaredError;
+	if (settings.sparseCutoff > 0) {
+		getOutputSparse(dataSet.input, dataSet.count, grid, weights, output);
+		if (dataSet.weight == NULL) {
+			return calculateError(dataSet.target, output, dataSet.count);
+		}
+		squaredError = weightedSquaredError(dataSet, output, NULL);
+	} else {
+		squaredError = getOutputError(dataSet.input, dataSet.count, neuronCount, clusterCenters, weights, neuronWidth, worker.testActivations, dataSet.target, output, NULL);
+		if (dataSet.weight != NULL) {
+			squaredError = weightedSquaredError(dataSet, output, NULL);
+		}
+	}
+	return (float) sqrt(squaredError / dataSet.rowCount);
+}
+
+/*
+ * Trains a network by gradient descent until it converges, runs out of epochs or reaches epochEnd.
+ * Calling this again with a later epochEnd carries on exactly where it stopped.
+ *
+ * Parameters:
+ * SweepState *state	  - The state shared between the workers.
+ * SweepWorker &worker	  - The buffers owned by the calling worker.
+ * SweepTrial &trial	  - The configuration's progress. The weights must be initialised.
+ * int neuronCount		  - The number of neurons in the network.
+ * double *clusterCenters - The centers of the network.
+ * double neuronWidth	  - The width of each neuron.
+ * int epochEnd			  - The number of epochs to stop after.
+ * int trialIndex		  - The position of the configuration in the grid, for saving its progress.
+ */
+static void trainGradientDescent(SweepState *state, SweepWorker &worker, SweepTrial &trial, int neuronCount, double *clusterCenters, double neuronWidth, int epochEnd, int trialIndex) {
+	const SweepSettings &settings = *state->settings;
+	const DataSet		&trainSet = *state->train;
+	const DataSet		&testSet  = *state->test;
+
+	NeuronGrid grid;
+	if (settings.sparseCutoff > 0) {
+		buildNeuronGrid(clusterCenters, neuronCount, neuronWidth, settings.sparseCutoff, grid);
+	}
+
+	// The worker's training activations are shared with its other trials, so they're filled on the first
+	// epoch of each round. Later epochs only change the weights, and reuse the stored activations if
+	// they're kept in double, which gives exactly the output of recomputing them. The narrower types
+	// would round the output, and ACTIVATIONS_RECOMPUTE keeps none, so those are filled every epoch.
+	bool reuseActivations = settings.activationStorage == ACTIVATIONS_DOUBLE;
+	bool activationsFilled = false;
+
+	while (trial.epoch < epochEnd) {
+		int epoch = trial.epoch++;
+
+		// Get the network's output, residuals & error for the training data set in one pass.
+		double trainSquaredError;
+		if (activationsFilled && reuseActivations) {
+			trainSquaredError = getStoredOutputError(worker.trainActivations, trial.weights, trainSet.target, worker.trainOutput, worker.trainResiduals);
+		} else {
+			trainSquaredError = getOutputError(trainSet.input, trainSet.count, neuronCount, clusterCenters, trial.weights, neuronWidth,
+				worker.trainActivations, trainSet.target, worker.trainOutput, worker.trainResiduals);
+			activationsFilled = true;
+		}
+		if (trainSet.weight != NULL) {
+			trainSquaredError = weightedSquaredError(trainSet, worker.trainOutput, worker.trainResiduals);
+		}
+		trial.epochRms[2 * epoch] = (float) sqrt(trainSquaredError / trainSet.rowCount);
+
+		// Get the network's output & error for the testing data set.
+		trial.epochRms[2 * epoch + 1] = evaluateOutput(settings, testSet, grid, worker, neuronCount, clusterCenters, trial.weights, neuronWidth, worker.testOutput);
+
+		// Check if we've converged on a solution, keeping the best weights so far.
+		bool stop = checkConvergence(settings.convergence, trial.epochRms, epoch, trial.bestEpoch);
+		if (settings.convergence.restoreBest && trial.bestEpoch == epoch) {
+			memcpy(trial.bestWeights, trial.weights, sizeof(double) * neuronCount);
+		}
+		if (stop) {
+			trial.finished = true;
+			break;
+		}
+
+		// We haven't converged. Keep training the network.
+		train(settings.learningRate, worker.trainResiduals, worker.trainActivations, neuronCount, trial.weights, settings.trainThreads);
+
+		// A round can be the whole sweep, so save the progress part way through it as well. The weights
+		// are those of the next epoch, just as if the round had ended here.
+		if (state->checkpoint != NULL && settings.checkpointEpochs > 0 && trial.epoch % settings.checkpointEpochs == 0 && trial.epoch < epochEnd) {
+			writeCheckpointTrial(state, trialIndex);
+		}
+	}
+	trial.finished = trial.finished || trial.epoch == settings.epochCount;
+
+	if (settings.sparseCutoff > 0) {
+		freeNeuronGrid(grid);
+	}
+}
+
+/*
+ * Returns the testing error of a network solved by least squares, which successive halving ranks it by.
+ *
+ * Parameters:
+ * SweepState *state	  - The state shared between the workers.
+ * SweepWorker &worker	  - The buffers owned by the calling worker.
+ * int neuronCount		  - The number of neurons in the network.
+ * double *clusterCenters - The centers of the network.
+ * double *weights		  - The weights of the network.
+ * double neuronWidth	  - The width of each neuron.
+ */
+static float solvedTestError(SweepState *state, SweepWorker &worker, int neuronCount, double *clusterCenters, double *weights, double neuronWidth) {
+	const SweepSettings &settings = *state->settings;
+	NeuronGrid grid;
+	if (settings.sparseCutoff > 0) {
+		buildNeuronGrid(clusterCenters, neuronCount, neuronWidth, settings.sparseCutoff, grid);
+	}
+	float testError = evaluateOutput(settings, *state->test, grid, worker, neuronCount, clusterCenters, weights, neuronWidth, worker.testOutput);
+	if (settings.sparseCutoff > 0) {
+		freeNeuronGrid(grid);
+	}
+	return testError;
+}
+
+/*
+ * Trains a network for a single configuration up to the current round's epoch target.
+ *
+ * Parameters:
+ * SweepState *state	- The state shared between the workers.
+ * SweepWorker &worker	- The buffers owned by the calling worker.
+ * int trialIndex		- The position of the configuration in the grid.
+ */
+static void runTrial(SweepState *state, SweepWorker &worker, int trialIndex) {
+	const SweepSettings &settings = *state->settings;
+	const DataSet		&trainSet = *state->train;
+	SweepTrial			&trial	  = state->trials[trialIndex];
+
+	int     countIndex	   = trialIndex / settings.widthNum;
+	int     neuronCount	   = sweepCount(settings, countIndex);
+	double  neuronWidth	   = sweepWidth(settings, trialIndex % settings.widthNum);
+	double *clusterCenters = state->clusters->centers[countIndex];
+
+	// Every pass over the data this round looks the activations up in the same tables.
+	ActivationTables tables;
+	if (settings.activationTables) {
+		buildActivationTables(clusterCenters, neuronCount, neuronWidth, settings.normalizationConstants, tables);
+		worker.trainActivations.tables = worker.testActivations.tables = &tables;
+	}
+
+	if (!trial.started) {
+		trial.started = true;
+
+		// Randomize the weights matrix.
+		int seed = trialSeed(settings.seed, trialIndex);
+		randomMatrix(trial.weights, 1, neuronCount, 1, &seed);
+
+		if (settings.trainingMode == TRAIN_LEAST_SQUARES) {
+			// The activations don't depend on the weights, so a single pass gives the solver everything it needs.
+			getOutput(trainSet.input, trainSet.count, neuronCount, clusterCenters, trial.weights, neuronWidth, worker.trainActivations, worker.trainOutput);
+			trial.finished = solveWeights(trainSet.count, worker.trainActivations, trainSet.target, trainSet.weight, neuronCount, settings.ridge, trial.weights);
+			if (!trial.finished) {
+				printf("Count %d\tWidth %.2f\tLeast squares system is singular, using gradient descent.\n", neuronCount, neuronWidth);
+			} else {
+				trial.epochRms[1] = solvedTestError(state, worker, neuronCount, clusterCenters, trial.weights, neuronWidth);
+			}
+		}
+	}
+
+	if (!trial.finished) {
+		trainGradientDescent(state, worker, trial, neuronCount, clusterCenters, neuronWidth, state->epochTarget, trialIndex);
+	}
+
+	if (settings.activationTables) {
+		worker.trainActivations.tables = worker.testActivations.tables = NULL;
+		freeActivationTables(tables);
+	}
+
+	if (state->checkpoint != NULL) {
+		writeCheckpointTrial(state, trialIndex);
+	}
+}
+
+/*
+ * Scores a trained network on the validation data set and returns its error.
+ *
+ * Parameters:
+ * SweepState *state	- The state shared between the workers.
+ * SweepWorker &worker	- The buffers owned by the calling worker.
+ * int trialIndex		- The position of the configuration in the grid.
+ */
+static float validateTrial(SweepState *state, SweepWorker &worker, int trialIndex) {
+	const SweepSettings &settings	   = *state->settings;
+	const DataSet		&validationSet = *state->validation;
+	SweepTrial			&trial		   = state->trials[trialIndex];
+
+	int     countIndex	   = trialIndex / settings.widthNum;
+	int     neuronCount	   = sweepCount(settings, countIndex);
+	double  neuronWidth	   = sweepWidth(settings, trialIndex % settings.widthNum);
+	double *clusterCenters = state->clusters->centers[countIndex];
+
+	// The network is trained. Get the output & error for the validation dataset.
+	NeuronGrid		 grid;
+	ActivationTables tables;
+	if (settings.sparseCutoff > 0) {
+		buildNeuronGrid(clusterCenters, neuronCount, neuronWidth, settings.sparseCutoff, grid);
+	} else if (settings.activationTables) {
+		buildActivationTables(clusterCenters, neuronCount, neuronWidth, settings.normalizationConstants, tables);
+		worker.testActivations.tables = &tables;
+	}
+	float finalError = evaluateOutput(settings, validationSet, grid, worker, neuronCount, clusterCenters, scoredWeights(settings, trial), neuronWidth, worker.validationOutput);
+	if (settings.sparseCutoff > 0) {
+		freeNeuronGrid(grid);
+	} else if (settings.activationTables) {
+		worker.testActivations.tables = NULL;
+		freeActivationTables(tables);
+	}
+	if (trial.finished) {
+		printf("Count %d\tWidth %.2f\tError %.4f\n", neuronCount, neuronWidth, finalError);
+	} else {
+		printf("Count %d\tWidth %.2f\tError %.4f\tCut after %d epochs\n", neuronCount, neuronWidth, finalError, trial.epoch);
+	}
+	return finalError;
+}
+
+/*
+ * Allocates the buffers for a worker thread.
+ *
+ * Parameters:
+ * SweepState *state	- The state shared between the workers.
+ * SweepWorker &worker	- The buffers to allocate.
+ */
+static void allocateWorker(SweepState *state, SweepWorker &worker) {
+	const DataSet &trainSet		 = *state->train;
+	const DataSet &testSet		 = *state->test;
+	const DataSet &validationSet = *state->validation;
+
+	// Prellocate space for calculating network output, big enough for the largest network.
+	int maxNeuronCount = sweepCount(*state->settings, state->settings->countNum - 1);
+	int maxEvalCount   = testSet.count > validationSet.count ? testSet.count : validationSet.count;
+
+	worker.trainOutput		= (double*) malloc(sizeof(double) * trainSet.count);
+	worker.trainResiduals	= (double*) malloc(sizeof(double) * trainSet.count);
+	worker.testOutput		= (double*) malloc(sizeof(double) * testSet.count);
+	worker.validationOutput = (double*) malloc(sizeof(double) * validationSet.count);
+
+	// Only train and solveWeights read the activations back, so the testing & validation ones aren't kept.
+	allocateActivationMatrix(worker.trainActivations, state->settings->activationStorage, state->settings->activationLayout, trainSet.count, maxNeuronCount);
+	allocateActivationMatrix(worker.testActivations, ACTIVATIONS_RECOMPUTE, state->settings->activationLayout, maxEvalCount, maxNeuronCount);
+}
+
+/*
+ * Releases the buffers of a worker thread.
+ *
+ * Parameters:
+ * SweepWorker &worker - The buffers to release.
+ */
+static void freeWorker(SweepWorker &worker) {
+	freeActivationMatrix(worker.trainActivations);
+	freeActivationMatrix(worker.testActivations);
+	free(worker.trainOutput);
+	free(worker.trainResiduals);
+	free(worker.testOutput);
+	free(worker.validationOutput);
+}
+
+/*
+ * Trains the configurations claimed from the queue until the queue is empty.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers.
+ */
+static void trainWorker(SweepState *state) {
+	SweepWorker worker;
+	allocateWorker(state, worker);
+
+	int queueIndex;
+	while ((queueIndex = state->nextIndex++) < state->queueCount) {
+		runTrial(state, worker, state->queue[queueIndex]);
+	}
+
+	freeWorker(worker);
+}
+
+/*
+ * Scores the configurations claimed from the queue until the queue is empty.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers.
+ */
+static void validateWorker(SweepState *state) {
+	SweepWorker worker;
+	allocateWorker(state, worker);
+
+	int queueIndex;
+	while ((queueIndex = state->nextIndex++) < state->queueCount) {
+		// Each configuration has its own slot, so the results don't depend on the order they finish in.
+		// Configurations cut by successive halving only reached part of their training, so their errors
+		// are printed but recorded as NaN rather than alongside those of the finished ones.
+		int	  trialIndex = state->queue[queueIndex];
+		float error		 = validateTrial(state, worker, trialIndex);
+		state->optimisationResults[trialIndex] = state->trials[trialIndex].finished ? error : NAN;
+	}
+
+	freeWorker(worker);
+}
+
+/*
+ * Orders configurations by increasing testing error, breaking ties by position in the grid so the
+ * cut doesn't depend on the order they were trained in.
+ */
+static int compareRanks(const void *a, const void *b) {
+	const SweepRank *rankA = (const SweepRank*) a, *rankB = (const SweepRank*) b;
+	if (rankA->testError != rankB->testError) {
+		return rankA->testError < rankB->testError ? -1 : 1;
+	}
+	return rankA->trialIndex - rankB->trialIndex;
+}
+
+/*
+ * Cuts the configurations in the queue after a round of successive halving. Only the best
+ * 1 / halvingRate of them by testing error at the round's epoch target survive, and of those, only
+ * the ones still training are left in the queue. A resumed sweep replays its rounds with some
+ * configurations already further on, so they are judged as they were at the end of the round.
+ * Configurations solved by least squares are judged by the testing error of their solution.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers.
+ */
+static void cutQueue(SweepState *state) {
+	int rate = state->settings->halvingRate;
+	SweepRank *ranks = (SweepRank*) malloc(sizeof(SweepRank) * state->queueCount);
+	for (int i = 0; i < state->queueCount; i++) {
+		const SweepTrial &trial = state->trials[state->queue[i]];
+		int epoch = trial.epoch < state->epochTarget ? trial.epoch : state->epochTarget;
+		ranks[i].testError	= trial.epochRms[epoch > 0 ? 2 * (epoch - 1) + 1 : 1];
+		ranks[i].trialIndex = state->queue[i];
+	}
+	qsort(ranks, state->queueCount, sizeof(SweepRank), compareRanks);
+
+	int survivorCount = (state->queueCount + rate - 1) / rate;
+	state->queueCount = 0;
+	for (int i = 0; i < survivorCount; i++) {
+		const SweepTrial &trial = state->trials[ranks[i].trialIndex];
+		if (!trial.finished || trial.epoch > state->epochTarget) {
+			state->queue[state->queueCount++] = ranks[i].trialIndex;
+		}
+	}
+	free(ranks);
+}
+
+/*
+ * Starts threadCount threads running the worker function and waits for them all to finish.
+ *
+ * Parameters:
+ * int threadCount	 - The number of threads to start.
+ * void (*worker)	 - The function each thread runs.
+ * SweepState *state - The state shared between the workers. Its queue is reset before starting.
+ */
+static void runWorkers(int threadCount, void (*worker)(SweepState*), SweepState *state) {
+	state->nextIndex = 0;
+
+	vector<thread> threads;
+	for (int i = 0; i < threadCount; i++) {
+		threads.push_back(thread(worker, state));
+	}
+	for (int i = 0; i < threadCount; i++) {
+		threads[i].join();
+	}
+}
+
+/*
+ * Saves the finished configuration with the lowest validation error as a model file.
+ *
+ * Parameters:
+ * SweepState *state - The state shared between the workers, once every configuration is validated.
+ */
+static void saveBestModel(SweepState *state) {
+	const SweepSettings &settings = *state->settings;
+
+	int trialCount = settings.countNum * settings.widthNum, bestIndex = -1;
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		float error = state->optimisationResults[trialIndex];
+		if (!isnan(error) && (bestIndex < 0 || error < state->optimisationResults[bestIndex])) {
+			bestIndex = trialIndex;
+		}
+	}
+	if (bestIndex < 0) {
+		printf("\nNo configuration finished training, so no model was saved.\n");
+		return;
+	}
+
+	int	   countIndex  = bestIndex / settings.widthNum;
+	int	   neuronCount = sweepCount(settings, countIndex);
+	double neuronWidth = sweepWidth(settings, bestIndex % settings.widthNum);
+	if (saveModel(settings.modelFilename, settings.normalizationConstants, state->clusters->centers[countIndex], scoredWeights(settings, state->trials[bestIndex]), neuronCount, neuronWidth)) {
+		printf("\nSaved Count %d\tWidth %.2f\tError %.4f to %s.\n", neuronCount, neuronWidth, state->optimisationResults[bestIndex], settings.modelFilename);
+	} else {
+		printf("\nCould not write %s.\n", settings.modelFilename);
+	}
+}
+
+/*
+ * Compacts a data set for the sweep if settings.compactData is set, and reports how many rows were
+ * merged. Returns the compacted copy, or the data set itself if there was nothing to merge.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const char *name				 - The name of the data set, for progress messages.
+ * const DataSet &dataSet		 - The data set to compact.
+ * DataSet &compact				 - The data set to fill with the compacted copy. Release it with freeDataSet
+ *								   if it's returned.
+ */
+static const DataSet *compactSweepData(const SweepSettings &settings, const char *name, const DataSet &dataSet, DataSet &compact) {
+	int merged = settings.compactData ? compactDataSet(dataSet, compact) : 0;
+	if (merged == 0) {
+		return &dataSet;
+	}
+	printf("Merged %d repeated %s rows, leaving %d of %d.\n", merged, name, compact.count, compact.rowCount);
+	return &compact;
+}
+
+/*
+ * Trains one network for every neuronCount x neuronWidth configuration in the grid and records the
+ * validation error of each. Configurations are independent, so they are handed out to worker threads
+ * from a shared queue. Every worker owns its own output and activation buffers.
+ *
+ * With successive halving, every configuration is first trained for halvingEpochs epochs. Only the
+ * best 1 / halvingRate of them by testing error carry on, for halvingRate times as many epochs, and
+ * so on until the survivors are trained to completion. The configurations that were cut are scored
+ * with the weights they had reached, but their validation error is recorded as NaN.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const DataSet &train			 - The data set used to train each network.
+ * const DataSet &test			 - The data set used to decide when training has converged.
+ * const DataSet &validation	 - The data set used to score each trained network.
+ * float *optimisationResults	 - A preallocated matrix to hold the validation error of each
+ *								   configuration, size countNum x widthNum. NaN for those cut by
+ *								   successive halving.
+ */
+void runSweep(const SweepSettings &settings, const DataSet &train, const DataSet &test, const DataSet &validation, float *optimisationResults) {
+	int threadCount = settings.threadCount;
+	if (threadCount <= 0) {
+		threadCount = thread::hardware_concurrency();
+	}
+	if (threadCount <= 0) {
+		threadCount = 1;
+	}
+
+	SweepState state;
+	state.settings			  = &settings;
+	state.train				  = &train;
+	state.test				  = &test;
+	state.validation		  = &validation;
+	state.optimisationResults = optimisationResults;
+
+	SweepCheckpoint checkpoint;
+	state.checkpoint = NULL;
+	if (settings.checkpointFilename != NULL) {
+		openCheckpoint(&state, checkpoint);
+		state.checkpoint = &checkpoint;
+	}
+
+	// Cluster the training data once per neuronCount. Every width trial shares the centers.
+	ClusterCache clusters;
+	if (state.checkpoint != NULL && readCheckpointClusters(&state, clusters)) {
+		printf("\nResuming from %s.\n", settings.checkpointFilename);
+	} else {
+		printf("\nRunning k-means algorithm...\n");
+		buildClusterCache(train, settings.countMin, settings.countStep, settings.countNum, settings.warmStartClusters, threadCount, settings.kmeans, settings.clusterInitializer, settings.seed, clusters);
+		if (state.checkpoint != NULL) {
+			writeCheckpointClusters(&state, clusters);
+		}
+	}
+	state.clusters = &clusters;
+
+	// The clusters come from the rows as they are, so the centers don't change, and only then are
+	// the rows with identical inputs merged, as their output only needs calculating once.
+	DataSet compactTrain, compactTest, compactValidation;
+	state.train		 = compactSweepData(settings, "training",	train,		compactTrain);
+	state.test		 = compactSweepData(settings, "testing",	test,		compactTest);
+	state.validation = compactSweepData(settings, "validation", validation, compactValidation);
+
+	// Every configuration starts in the queue.
+	int trialCount = settings.countNum * settings.widthNum;
+	state.trials	 = (SweepTrial*) malloc(sizeof(SweepTrial) * trialCount);
+	state.queue		 = (int*)		 malloc(sizeof(int)		   * trialCount);
+	state.queueCount = trialCount;
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		SweepTrial &trial = state.trials[trialIndex];
+		trial.weights	  = (double*) malloc(sizeof(double) * sweepCount(settings, trialIndex / settings.widthNum));
+		trial.bestWeights = (double*) calloc(sweepCount(settings, trialIndex / settings.widthNum), sizeof(double));
+		trial.epochRms	  = (float*)  calloc(settings.epochCount * 2, sizeof(float));
+		trial.epoch		  = 0;
+		trial.bestEpoch	  = -1;
+		trial.started	  = false;
+		trial.finished	  = false;
+		state.queue[trialIndex] = trialIndex;
+	}
+	if (state.checkpoint != NULL) {
+		int restoredCount = readCheckpointTrials(&state);
+		if (restoredCount > 0) {
+			printf("Restored %d of %d configurations.\n", restoredCount, trialCount);
+		}
+	}
+
+	// Train the configurations in rounds, cutting the worst after each one. Without successive
+	// halving there is a single round that trains every configuration to completion.
+	bool halving	 = settings.halvingEpochs > 0 && settings.halvingRate > 1;
+	int	 epochTarget = halving ? settings.halvingEpochs : settings.epochCount;
+	while (state.queueCount > 0) {
+		state.epochTarget = epochTarget < settings.epochCount ? epochTarget : settings.epochCount;
+		printf("\nTraining %d configurations to %d epochs on %d threads...\n", state.queueCount, state.epochTarget, threadCount);
+		runWorkers(threadCount < state.queueCount ? threadCount : state.queueCount, trainWorker, &state);
+		if (state.epochTarget == settings.epochCount) {
+			break;
+		}
+		cutQueue(&state);
+		epochTarget *= settings.halvingRate;
+	}
+
+	// Score every configuration.
+	printf("\nValidating %d configurations...\n", trialCount);
+	state.queueCount = trialCount;
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		state.queue[trialIndex] = trialIndex;
+	}
+	runWorkers(threadCount < trialCount ? threadCount : trialCount, validateWorker, &state);
+
+	if (settings.modelFilename != NULL) {
+		saveBestModel(&state);
+	}
+
+	if (state.checkpoint != NULL) {
+		closeCheckpoint(&state, checkpoint);
+	}
+
+	for (int trialIndex = 0; trialIndex < trialCount; trialIndex++) {
+		free(state.trials[trialIndex].weights);
+		free(state.trials[trialIndex].bestWeights);
+		free(state.trials[trialIndex].epochRms);
+	}
+	free(state.trials);
+	free(state.queue);
+	freeClusterCache(clusters);
+	if (state.train != &train) {
+		freeDataSet(compactTrain);
+	}
+	if (state.test != &test) {
+		freeDataSet(compactTest);
+	}
+	if (state.validation != &validation) {
+		freeDataSet(compactValidation);
+	}
+}
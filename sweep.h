@@ -0,0 +1,150 @@
+#pragma once
+
+#include "clusters.h"
+#include "io.h"
+#include "network.h"
+
+/*
+  Default configuration range, see SweepSettings:
+  neuronCount 50:10:500      - 46 rows
+  neuronWidth 0.01:0.01:0.1  - 10 columns
+  Total trial configurations - 460
+*/
+#ifndef SWEEP_COUNT_MIN
+#define SWEEP_COUNT_MIN	  50
+#endif
+#ifndef SWEEP_COUNT_STEP
+#define SWEEP_COUNT_STEP  10
+#endif
+#ifndef SWEEP_COUNT_NUM
+#define SWEEP_COUNT_NUM	  46
+#endif
+#ifndef SWEEP_WIDTH_MIN
+#define SWEEP_WIDTH_MIN	  0.01
+#endif
+#ifndef SWEEP_WIDTH_STEP
+#define SWEEP_WIDTH_STEP  0.01
+#endif
+#ifndef SWEEP_WIDTH_NUM
+#define SWEEP_WIDTH_NUM	  10
+#endif
+
+/*
+ * How the output weights of each network are trained.
+ *
+ * TRAIN_GRADIENT_DESCENT - Gradient descent for up to epochCount epochs, see train.
+ * TRAIN_LEAST_SQUARES	  - A direct least squares solve in one pass, see solveWeights.
+ */
+enum TrainingMode {
+	TRAIN_GRADIENT_DESCENT,
+	TRAIN_LEAST_SQUARES
+};
+
+/*
+ * Options controlling how the hyperparameter sweep is run.
+ *
+ * Members:
+ * int countMin							 - The smallest neuronCount in the grid.
+ * int countStep						 - The step between neuronCounts.
+ * int countNum							 - The number of neuronCounts, which is the number of rows in the grid.
+ * double widthMin						 - The smallest neuronWidth in the grid.
+ * double widthStep						 - The step between neuronWidths.
+ * int widthNum							 - The number of neuronWidths, which is the number of columns in the grid.
+ * int epochCount						 - The maximum number of training epochs per configuration.
+ * double learningRate					 - The learning rate of the network.
+ * ConvergencePolicy convergence		 - How gradient descent decides a configuration has finished training.
+ * int threadCount						 - The number of worker threads. 0 uses every available core.
+ * int seed								 - The base seed. Each configuration derives its own seed from this and its
+ *										   position in the grid, so results don't depend on the thread count.
+ * bool warmStartClusters				 - Whether each neuronCount's clustering starts from the previous count's
+ *										   solution. See buildClusterCache.
+ * KMeansRoutine kmeans					 - The k-means routine used to cluster the training data.
+ * ClusterInitializer clusterInitializer - How the cluster centers are seeded, from seed.
+ * TrainingMode trainingMode			 - How the output weights are trained.
+ * double ridge							 - The regularization used by TRAIN_LEAST_SQUARES.
+ * ActivationLayout activationLayout	 - How each worker stores its activation matrices. Neuron-major makes
+ *										   each weight update a contiguous dot product per neuron.
+ * ActivationStorage activationStorage	 - How each worker stores its training activations. The narrower
+ *										   types and ACTIVATIONS_RECOMPUTE let more workers fit in memory.
+ * bool activationTables				 - Whether the activations are looked up in ActivationTables over the
+ *										   integer calendar inputs instead of evaluated with exp. Needs the
+ *										   normalizationConstants.
+ * int trainThreads						 - The number of threads each weight update is split across.
+ * int halvingEpochs					 - The number of epochs every configuration trains for before the first cut
+ *										   of successive halving. 0 trains every configuration to completion.
+ * int halvingRate						 - Each cut keeps the best 1 / halvingRate of the configurations and
+ *										   multiplies the epochs the survivors train for by halvingRate.
+ * double sparseCutoff					 - The cutoff, in widths, of the grid the testing and validation outputs
+ *										   are evaluated with, see NeuronGrid. 0 evaluates every neuron. The
+ *										   testing and validation errors decide convergence, the successive
+ *										   halving cuts and the model that's saved, so with a cutoff they
+ *										   follow the grid's approximation, and close configurations may be
+ *										   ranked differently than by their exact errors.
+ * bool compactData						 - Whether the rows of each data set with identical inputs are merged
+ *										   into weighted data points once the training data is clustered, so
+ *										   their output is only calculated once. See compactDataSet.
+ * char *modelFilename					 - The model file the configuration with the lowest validation error is
+ *										   saved to, see saveModel. NULL doesn't save it.
+ * const double *normalizationConstants	 - The constants the data sets were normalized with, saved in the model.
+ * char *checkpointFilename				 - The file the progress of the sweep is saved to as it goes, and resumed
+ *										   from if it's there. Removed once the sweep completes. NULL doesn't save it.
+ * int checkpointEpochs					 - The number of epochs between saves of a configuration that's still
+ *										   training. 0 only saves it at the end of each round.
+ */
+struct SweepSettings {
+	int					countMin;
+	int					countStep;
+	int					countNum;
+	double				widthMin;
+	double				widthStep;
+	int					widthNum;
+	int					epochCount;
+	double				learningRate;
+	ConvergencePolicy	convergence;
+	int					threadCount;
+	int					seed;
+	bool				warmStartClusters;
+	KMeansRoutine		kmeans;
+	ClusterInitializer	clusterInitializer;
+	TrainingMode		trainingMode;
+	double				ridge;
+	ActivationLayout	activationLayout;
+	ActivationStorage	activationStorage;
+	bool				activationTables;
+	int					trainThreads;
+	int					halvingEpochs;
+	int					halvingRate;
+	double				sparseCutoff;
+	bool				compactData;
+	char			   *modelFilename;
+	const double	   *normalizationConstants;
+	char			   *checkpointFilename;
+	int					checkpointEpochs;
+};
+
+/*
+ * Trains one network for every neuronCount x neuronWidth configuration in the grid and records the
+ * validation error of each. Configurations are independent, so they are handed out to worker threads
+ * from a shared queue. Every worker owns its own output and activation buffers.
+ *
+ * With successive halving, every configuration is first trained for halvingEpochs epochs. Only the
+ * best 1 / halvingRate of them by testing error carry on, for halvingRate times as many epochs, and
+ * so on until the survivors are trained to completion. The configurations that were cut are scored
+ * with the weights they had reached, but their validation error is recorded as NaN. The finished
+ * configuration with the lowest validation error is saved as a model file.
+ *
+ * With a checkpoint file, the cluster centers and each configuration's progress are saved as they are
+ * reached, both at the end of each round and every checkpointEpochs epochs. A sweep that is stopped and started again with the same settings and data carries on from
+ * them. The rounds are replayed with each cut made on the testing error at the round's epoch target,
+ * so a resumed sweep gives the same results as one that was never stopped.
+ *
+ * Parameters:
+ * const SweepSettings &settings - The options for the sweep.
+ * const DataSet &train			 - The data set used to train each network.
+ * const DataSet &test			 - The data set used to decide when training has converged.
+ * const DataSet &validation	 - The data set used to score each trained network.
+ * float *optimisationResults	 - A preallocated matrix to hold the validation error of each
+ *								   configuration, size countNum x widthNum. NaN for those cut by
+ *								   successive halving.
+ */
+void runSweep(const SweepSettings &settings, const DataSet &train, const DataSet &test, const DataSet &validation, float *optimisationResults);
@@ -0,0 +1,124 @@
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+#include "activation.h"
+#include "tables.h"
+
+using namespace std;
+
+/*
+ * Finds the table row of each coordinate of an input point. Returns false if any coordinate isn't a
+ * tabulated value, normalized the way loadData normalizes it.
+ *
+ * Parameters:
+ * const ActivationTables &tables - The tables.
+ * const double *input			  - One data point, which is an array of 3 values.
+ * const double **rows			  - An array of 3 to hold the row of each coordinate.
+ */
+static bool findRows(const ActivationTables &tables, const double *input, const double **rows) {
+	for (int i = 0; i < 3; i++) {
+		// Round to the nearest value, checking the range first so the conversion can't overflow.
+		double position = input[i] * tables.normalizationConstants[i] - tables.valueBegin[i] + 0.5;
+		if (!(position >= 0 && position < tables.valueCount[i])) {
+			return false;
+		}
+		int index = (int) position;
+		if ((tables.valueBegin[i] + index) / tables.normalizationConstants[i] != input[i]) {
+			return false;
+		}
+		rows[i] = tables.rows[i] + (size_t) index * tables.neuronCount;
+	}
+	return true;
+}
+
+/*
+ * Tabulates the activations of the neurons of a network along each input dimension.
+ *
+ * Parameters:
+ * const double *centers				- A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount						- The number of centers.
+ * double width							- The width of each RBF neuron.
+ * const double *normalizationConstants	- The constants the inputs were normalized with, length 3.
+ * ActivationTables &tables				- The tables to fill. Release them with freeActivationTables.
+ */
+void buildActivationTables(const double *centers, int neuronCount, double width, const double *normalizationConstants, ActivationTables &tables) {
+	const int valueBegin[] = TABLE_VALUE_BEGIN, valueCount[] = TABLE_VALUE_COUNT;
+	double scale = -1.0 / (2 * width * width);
+
+	tables.neuronCount = neuronCount;
+	memcpy(tables.normalizationConstants, normalizationConstants, sizeof(tables.normalizationConstants));
+	for (int i = 0; i < 3; i++) {
+		tables.valueBegin[i] = valueBegin[i];
+		tables.valueCount[i] = valueCount[i];
+		tables.rows[i]		 = (double*) malloc(sizeof(double) * valueCount[i] * neuronCount);
+
+		for (int valueIndex = 0; valueIndex < valueCount[i]; valueIndex++) {
+			double x = (valueBegin[i] + valueIndex) / normalizationConstants[i];
+			double *row = tables.rows[i] + (size_t) valueIndex * neuronCount;
+			for (int neuronIndex = 0; neuronIndex < neuronCount; neuronIndex++) {
+				double d = centers[neuronIndex * 3 + i] - x;
+				row[neuronIndex] = exp(d * d * scale);
+			}
+		}
+	}
+}
+
+/*
+ * Releases the memory held by a set of tables.
+ *
+ * Parameters:
+ * ActivationTables &tables - The tables to release.
+ */
+void freeActivationTables(ActivationTables &tables) {
+	for (int i = 0; i < 3; i++) {
+		free(tables.rows[i]);
+		tables.rows[i] = NULL;
+	}
+}
+
+/*
+ * Looks up the activations of neurons neuronBegin to neuronEnd for one input point, like
+ * rbfActivations. Returns false, leaving the activations unset, if the point isn't made of
+ * tabulated values.
+ *
+ * Parameters:
+ * const ActivationTables &tables - The tables.
+ * const double *input			  - One data point, which is an array of 3 values.
+ * int neuronBegin				  - The first neuron to evaluate.
+ * int neuronEnd				  - One past the last neuron to evaluate.
+ * double *activations			  - A preallocated array to hold the result. activations[0] is the
+ *									activation of neuron neuronBegin.
+ */
+bool tableActivations(const ActivationTables &tables, const double *input, int neuronBegin, int neuronEnd, double *activations) {
+	const double *rows[3];
+	if (!findRows(tables, input, rows)) {
+		return false;
+	}
+	rbfTableActivations(rows, neuronBegin, neuronEnd, activations);
+	return true;
+}
+
+/*
+ * Looks up the activations of neurons neuronBegin to neuronEnd for one input point, and adds their
+ * sum and weighted sum to the running totals for the point, like rbfForward. Returns false, leaving
+ * everything unchanged, if the point isn't made of tabulated values.
+ *
+ * Parameters:
+ * const ActivationTables &tables - The tables.
+ * const double *input			  - One data point, which is an array of 3 values.
+ * int neuronBegin				  - The first neuron to evaluate.
+ * int neuronEnd				  - One past the last neuron to evaluate.
+ * const double *weights		  - The weight array for the network, length neuronCount.
+ * double *activations			  - A preallocated array to hold the activations. activations[0] is the
+ *									activation of neuron neuronBegin.
+ * double &activationSum		  - The running sum of the point's activations.
+ * double &weightedSum			  - The running sum of the point's activations multiplied by their weights.
+ */
+bool tableForward(const ActivationTables &tables, const double *input, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum) {
+	const double *rows[3];
+	if (!findRows(tables, input, rows)) {
+		return false;
+	}
+	rbfTableForward(rows, neuronBegin, neuronEnd, weights, activations, activationSum, weightedSum);
+	return true;
+}
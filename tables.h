@@ -0,0 +1,82 @@
+#pragma once
+
+// The integer values the inputs take in the data files before they're normalized: the day of the
+// year, the hour of the day and the day of the week. See loadData.
+#define TABLE_VALUE_BEGIN { 1, 0, 1 }
+#define TABLE_VALUE_COUNT { 366, 24, 7 }
+
+/*
+ * The activations of the neurons of a network along each input dimension, tabulated over the integer
+ * values that dimension takes in the data files. exp(-||x - c||^2 / (2 * width^2)) is the product of
+ * exp(-(x_i - c_i)^2 / (2 * width^2)) over the three dimensions, so the activation of an input made
+ * of tabulated values is three lookups and two multiplications, with no exp. The product agrees with
+ * rbfActivations to within a few units in the last place.
+ *
+ * Members:
+ * int neuronCount					- The number of neurons in the network.
+ * double normalizationConstants[3] - The constants the inputs were normalized with.
+ * int valueBegin[3]				- The smallest value tabulated along each dimension.
+ * int valueCount[3]				- The number of values tabulated along each dimension.
+ * double *rows[3]					- The activations along each dimension, a row of neuronCount for each
+ *									  value in turn. Size valueCount[i] x neuronCount.
+ */
+struct ActivationTables {
+	int		neuronCount;
+	double	normalizationConstants[3];
+	int		valueBegin[3];
+	int		valueCount[3];
+	double *rows[3];
+};
+
+/*
+ * Tabulates the activations of the neurons of a network along each input dimension.
+ *
+ * Parameters:
+ * const double *centers				- A matrix of centers, size neuronCount x 3. Stride 3.
+ * int neuronCount						- The number of centers.
+ * double width							- The width of each RBF neuron.
+ * const double *normalizationConstants	- The constants the inputs were normalized with, length 3.
+ * ActivationTables &tables				- The tables to fill. Release them with freeActivationTables.
+ */
+void buildActivationTables(const double *centers, int neuronCount, double width, const double *normalizationConstants, ActivationTables &tables);
+
+/*
+ * Releases the memory held by a set of tables.
+ *
+ * Parameters:
+ * ActivationTables &tables - The tables to release.
+ */
+void freeActivationTables(ActivationTables &tables);
+
+/*
+ * Looks up the activations of neurons neuronBegin to neuronEnd for one input point, like
+ * rbfActivations. Returns false, leaving the activations unset, if the point isn't made of
+ * tabulated values.
+ *
+ * Parameters:
+ * const ActivationTables &tables - The tables.
+ * const double *input			  - One data point, which is an array of 3 values.
+ * int neuronBegin				  - The first neuron to evaluate.
+ * int neuronEnd				  - One past the last neuron to evaluate.
+ * double *activations			  - A preallocated array to hold the result. activations[0] is the
+ *									activation of neuron neuronBegin.
+ */
+bool tableActivations(const ActivationTables &tables, const double *input, int neuronBegin, int neuronEnd, double *activations);
+
+/*
+ * Looks up the activations of neurons neuronBegin to neuronEnd for one input point, and adds their
+ * sum and weighted sum to the running totals for the point, like rbfForward. Returns false, leaving
+ * everything unchanged, if the point isn't made of tabulated values.
+ *
+ * Parameters:
+ * const ActivationTables &tables - The tables.
+ * const double *input			  - One data point, which is an array of 3 values.
+ * int neuronBegin				  - The first neuron to evaluate.
+ * int neuronEnd				  - One past the last neuron to evaluate.
+ * const double *weights		  - The weight array for the network, length neuronCount.
+ * double *activations			  - A preallocated array to hold the activations. activations[0] is the
+ *									activation of neuron neuronBegin.
+ * double &activationSum		  - The running sum of the point's activations.
+ * double &weightedSum			  - The running sum of the point's activations multiplied by their weights.
+ */
+bool tableForward(const ActivationTables &tables, const double *input, int neuronBegin, int neuronEnd, const double *weights, double *activations, double &activationSum, double &weightedSum);
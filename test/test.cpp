@@ -0,0 +1,634 @@
+/*
+ * Checks for the predictor: that every activation kernel the CPU supports agrees with the C
+ * library's exp, that PRECISION_FAST stays within its stated error and barely moves a trained
+ * network's validation error, that parseData rejects malformed rows, that readSample draws every
+ * row of a data file equally often, that kmeans_04 gives exactly the clusters of kmeans_03, and
+ * that compacting repeated rows doesn't change the results of a sweep. Each check prints its
+ * largest error against its tolerance, and the program exits with status 1 if any check fails. Run
+ * from the repository root.
+ *
+ * Usage:
+ * test/test
+ *
+ * Build:
+ * g++ -O2 -pthread test/test.cpp io.cpp kmeans.cpp network.cpp activation.cpp clusters.cpp sweep.cpp grid.cpp model.cpp tables.cpp -o test/test
+ */
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../activation.h"
+#include "../clusters.h"
+#include "../io.h"
+#include "../kmeans.hpp"
+#include "../network.h"
+#include "../sweep.h"
+
+#define TEST_SEED	  10
+#define TEST_POINTS	  200	// Random input points for each width.
+#define TEST_NEURONS  203	// Not a multiple of 8, so the scalar tail of the vector kernels is checked too.
+#define TEST_WIDTHS	  20
+#define TEST_SMALLEST 1e-300	// Activations below this are flushed to 0 by the vector kernels, so aren't compared.
+
+// The relative error allowed in an activation, per unit of the exponent. The vector kernels round the
+// squared distance differently from the scalar one, which moves exp(x) by a few ulps of x, on top of
+// the couple of ulps exp itself is out by.
+#define TEST_EXACT_TOLERANCE 4e-15
+
+// The relative error allowed between PRECISION_FAST and PRECISION_EXACT, see ActivationPrecision.
+#define TEST_FAST_TOLERANCE 2e-7
+
+// The network the fast exp's effect on the validation error is measured with, the best of the sweep.
+#define TEST_NETWORK_NEURONS 170
+#define TEST_NETWORK_WIDTH	 0.05
+#define TEST_NETWORK_RIDGE	 1e-6
+
+// Every TEST_REPEAT_EVERYth row is repeated for the compacted sweeps, which are TEST_SWEEP_COUNTS x
+// TEST_SWEEP_WIDTHS configurations. Their validation errors are floats, and the weighted sums only
+// differ from the repeated rows' in rounding, so they must agree to within a few float ulps.
+#define TEST_REPEAT_EVERY	  3
+#define TEST_SWEEP_COUNTS	  2
+#define TEST_SWEEP_WIDTHS	  2
+#define TEST_COMPACT_TOLERANCE 1e-6
+
+// kmeans_04 must give exactly the clusters of kmeans_03. They're compared on the first TEST_KMEANS_POINTS
+// training rows, which keeps kmeans_03 quick. Run with MALLOC_PERTURB_ set to catch reads of unset memory.
+#define TEST_KMEANS_POINTS 8000
+
+// Written with each row parseData is checked against, and deleted afterwards.
+#define TEST_CSV_FILENAME "test/rows.csv"
+
+// A data file of TEST_STREAM_ROWS rows, which leaves its last block short, is sampled TEST_STREAM_DRAWS
+// times. Each row should be drawn TEST_STREAM_DRAWS / TEST_STREAM_ROWS times, give or take the spread
+// of drawing from a buffer of blocks, and only rows that were read from the file may be drawn.
+#define TEST_STREAM_FILENAME  "test/rows.bin"
+#define TEST_STREAM_ROWS	  1000
+#define TEST_STREAM_DRAWS	  2000000
+#define TEST_STREAM_BATCH	  1000
+#define TEST_STREAM_TOLERANCE 0.2
+
+using namespace std;
+
+// The number of checks that have failed.
+static int failureCount = 0;
+
+/*
+ * Prints the result of a check and counts it if it failed.
+ *
+ * Parameters:
+ * const char *name	- The name of the check.
+ * double error		- The largest error the check found.
+ * double tolerance	- The largest error allowed.
+ */
+static void report(const char *name, double error, double tolerance) {
+	bool passed = error <= tolerance;
+	printf("%-36s %-6s %11.3g %11.3g\n", name, passed ? "ok" : "FAILED", error, tolerance);
+	failureCount += !passed;
+}
+
+/*
+ * Evaluates random networks with rbfActivations and rbfForward using the selected kernel, and returns
+ * the largest relative error of an activation or a sum against the C library's exp. The error of each
+ * activation is divided by the size of its exponent, since the rounding of the distance scales with it,
+ * and the error of a sum by the sum of those allowances.
+ *
+ * Parameters:
+ * int seed - The random number generator seed.
+ */
+static double activationError(int seed) {
+	double *soaCenters	= (double*) malloc(sizeof(double) * TEST_NEURONS * 3);
+	double *weights		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double *activations = (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double *forward		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double	maxError	= 0;
+
+	for (int widthIndex = 0; widthIndex < TEST_WIDTHS; widthIndex++) {
+		double width;
+		randomMatrix(&width, 1, 1, 0.5, &seed);
+		width += 0.01;
+		double scale = -1.0 / (2 * width * width);
+		randomMatrix(soaCenters, 3, TEST_NEURONS, 1, &seed);
+		randomMatrix(weights, 1, TEST_NEURONS, 1, &seed);
+
+		for (int pointIndex = 0; pointIndex < TEST_POINTS; pointIndex++) {
+			double input[3];
+			randomMatrix(input, 1, 3, 1, &seed);
+
+			// Start part way in, so the kernels are checked on a range that isn't aligned.
+			int neuronBegin = pointIndex % 5;
+			double activationSum = 0, weightedSum = 0;
+			rbfActivations(input, soaCenters, TEST_NEURONS, neuronBegin, TEST_NEURONS, width, activations);
+			rbfForward(input, soaCenters, TEST_NEURONS, neuronBegin, TEST_NEURONS, width, weights, forward, activationSum, weightedSum);
+
+			double expectedSum = 0, expectedWeightedSum = 0, sumAllowance = 0;
+			for (int neuronIndex = neuronBegin; neuronIndex < TEST_NEURONS; neuronIndex++) {
+				double dx = soaCenters[neuronIndex] - input[0];
+				double dy = soaCenters[TEST_NEURONS + neuronIndex] - input[1];
+				double dz = soaCenters[2 * TEST_NEURONS + neuronIndex] - input[2];
+				double exponent = (dx * dx + dy * dy + dz * dz) * scale;
+				double expected = exp(exponent);
+				expectedSum			+= expected;
+				expectedWeightedSum += expected * weights[neuronIndex];
+				sumAllowance		+= fmax(1, fabs(exponent)) * expected;
+				if (expected < TEST_SMALLEST) {
+					continue;
+				}
+
+				double allowance = fmax(1, fabs(exponent)) * expected;
+				maxError = fmax(maxError, fabs(activations[neuronIndex - neuronBegin] - expected) / allowance);
+				maxError = fmax(maxError, fabs(forward[neuronIndex - neuronBegin] - expected) / allowance);
+			}
+			if (expectedSum > TEST_SMALLEST) {
+				maxError = fmax(maxError, fabs(activationSum - expectedSum) / sumAllowance);
+				maxError = fmax(maxError, fabs(weightedSum - expectedWeightedSum) / sumAllowance);
+			}
+		}
+	}
+
+	free(soaCenters);
+	free(weights);
+	free(activations);
+	free(forward);
+	return maxError;
+}
+
+/*
+ * Evaluates random networks with rbfActivations and rbfForward using the selected kernel at both
+ * precisions, and returns the largest relative difference between a fast activation or sum and the
+ * exact one. Both round the distances the same way, so this is the error of the fast polynomial alone.
+ * Leaves the precision as PRECISION_EXACT.
+ *
+ * Parameters:
+ * int seed - The random number generator seed.
+ */
+static double fastExpError(int seed) {
+	double *soaCenters	= (double*) malloc(sizeof(double) * TEST_NEURONS * 3);
+	double *weights		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double *exact		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double *fast		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double *forward		= (double*) malloc(sizeof(double) * TEST_NEURONS);
+	double	maxError	= 0;
+
+	for (int widthIndex = 0; widthIndex < TEST_WIDTHS; widthIndex++) {
+		double width;
+		randomMatrix(&width, 1, 1, 0.5, &seed);
+		width += 0.01;
+		randomMatrix(soaCenters, 3, TEST_NEURONS, 1, &seed);
+		randomMatrix(weights, 1, TEST_NEURONS, 1, &seed);
+
+		for (int pointIndex = 0; pointIndex < TEST_POINTS; pointIndex++) {
+			double input[3];
+			randomMatrix(input, 1, 3, 1, &seed);
+
+			double exactSum = 0, exactWeightedSum = 0, fastSum = 0, fastWeightedSum = 0;
+			selectActivationPrecision(PRECISION_EXACT);
+			rbfForward(input, soaCenters, TEST_NEURONS, 0, TEST_NEURONS, width, weights, exact, exactSum, exactWeightedSum);
+			selectActivationPrecision(PRECISION_FAST);
+			rbfActivations(input, soaCenters, TEST_NEURONS, 0, TEST_NEURONS, width, fast);
+			rbfForward(input, soaCenters, TEST_NEURONS, 0, TEST_NEURONS, width, weights, forward, fastSum, fastWeightedSum);
+
+			for (int neuronIndex = 0; neuronIndex < TEST_NEURONS; neuronIndex++) {
+				if (exact[neuronIndex] < TEST_SMALLEST) {
+					continue;
+				}
+				maxError = fmax(maxError, fabs(fast[neuronIndex] - exact[neuronIndex]) / exact[neuronIndex]);
+				maxError = fmax(maxError, fabs(forward[neuronIndex] - exact[neuronIndex]) / exact[neuronIndex]);
+			}
+			if (exactSum > TEST_SMALLEST) {
+				maxError = fmax(maxError, fabs(fastSum - exactSum) / exactSum);
+				maxError = fmax(maxError, fabs(fastWeightedSum - exactWeightedSum) / exactSum);
+			}
+		}
+	}
+	selectActivationPrecision(PRECISION_EXACT);
+
+	free(soaCenters);
+	free(weights);
+	free(exact);
+	free(fast);
+	free(forward);
+	return maxError;
+}
+
+/*
+ * Clusters the same points with kmeans_03 and kmeans_04 from the same centers for several counts and
+ * initializers, and reports whether each gives byte for byte the same iterations, centers, clusters,
+ * populations and energies. Returns false if the data couldn't be loaded.
+ */
+static bool checkKmeans() {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	DataSet train;
+	if (!parseData((char*) "data/train.csv", normalizationConstants, train)) {
+		return false;
+	}
+	DataSet points = train;
+	points.count = points.count < TEST_KMEANS_POINTS ? points.count : TEST_KMEANS_POINTS;
+
+	const int				 counts[]		= { 50, 60, 120, 333 };
+	const ClusterInitializer initializers[] = { INITIALIZE_FIRST_POINTS, INITIALIZE_RANDOM_ASSIGNMENT, INITIALIZE_KMEANS_PLUS_PLUS };
+	const char				*names[]		= { "firstPoints", "randomAssignment", "kmeansPlusPlus" };
+	int maxCount = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+
+	double *centers[2], *energies[2];
+	int	   *clusters[2], *populations[2], iterations[2];
+	for (int r = 0; r < 2; r++) {
+		centers[r]	   = (double*) malloc(sizeof(double) * maxCount * 3);
+		energies[r]	   = (double*) malloc(sizeof(double) * maxCount);
+		clusters[r]	   = (int*)	   malloc(sizeof(int)	 * points.count);
+		populations[r] = (int*)	   malloc(sizeof(int)	 * maxCount);
+	}
+
+	const KMeansRoutine routines[] = { kmeans_03, kmeans_04 };
+	for (int i = 0; i < (int) (sizeof(counts) / sizeof(counts[0])); i++) {
+		for (int j = 0; j < (int) (sizeof(initializers) / sizeof(initializers[0])); j++) {
+			int count = counts[i];
+			for (int r = 0; r < 2; r++) {
+				int seed = TEST_SEED;
+				initializeCenters(points, count, initializers[j], &seed, centers[r]);
+				i4vec_negone(points.count, clusters[r]);
+				routines[r](3, points.count, count, 500, iterations[r], points.input, clusters[r], centers[r], populations[r], energies[r]);
+			}
+
+			bool same = iterations[0] == iterations[1]
+				&& memcmp(centers[0], centers[1], sizeof(double) * count * 3) == 0
+				&& memcmp(energies[0], energies[1], sizeof(double) * count) == 0
+				&& memcmp(clusters[0], clusters[1], sizeof(int) * points.count) == 0
+				&& memcmp(populations[0], populations[1], sizeof(int) * count) == 0;
+			char name[64];
+			snprintf(name, sizeof(name), "kmeans_04/%s/%d", names[j], count);
+			report(name, same ? 0 : 1, 0);
+		}
+	}
+
+	for (int r = 0; r < 2; r++) {
+		free(centers[r]);
+		free(energies[r]);
+		free(clusters[r]);
+		free(populations[r]);
+	}
+	freeDataSet(train);
+	return true;
+}
+
+/*
+ * Trains a network on the training set by least squares, and returns the RMS error of its output on
+ * the validation set. Uses the selected kernel & precision for both.
+ *
+ * Parameters:
+ * const DataSet &train			 - The training data set.
+ * const DataSet &validation	 - The validation data set.
+ * double *centers				 - The centers of the network, size TEST_NETWORK_NEURONS x 3.
+ * ActivationMatrix &activations - A matrix big enough for the training set.
+ * double *weights				 - A preallocated array to hold the weights, length TEST_NETWORK_NEURONS.
+ * double *output				 - A preallocated array to hold the output, as long as the training set.
+ */
+static double validationError(const DataSet &train, const DataSet &validation, double *centers, ActivationMatrix &activations, double *weights, double *output) {
+	for (int neuronIndex = 0; neuronIndex < TEST_NETWORK_NEURONS; neuronIndex++) {
+		weights[neuronIndex] = 0;
+	}
+	getOutput(train.input, train.count, TEST_NETWORK_NEURONS, centers, weights, TEST_NETWORK_WIDTH, activations, output);
+	solveWeights(train.count, activations, train.target, NULL, TEST_NETWORK_NEURONS, TEST_NETWORK_RIDGE, weights);
+	double squaredError = getOutputError(validation.input, validation.count, TEST_NETWORK_NEURONS, centers, weights, TEST_NETWORK_WIDTH, activations,
+		validation.target, output, NULL);
+	return sqrt(squaredError / validation.count);
+}
+
+/*
+ * Clusters the training set into a network of TEST_NETWORK_NEURONS neurons as the sweep would, and
+ * checks with every kernel the CPU supports that the fast exp changes its validation error by no more
+ * than FAST_EXP_TOLERANCE, relative to it. Returns false if the data couldn't be loaded.
+ */
+static bool checkFastValidationError() {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	DataSet train, validation;
+	if (!parseData((char*) "data/train.csv", normalizationConstants, train)) {
+		return false;
+	}
+	if (!parseData((char*) "data/validation.csv", normalizationConstants, validation)) {
+		freeDataSet(train);
+		return false;
+	}
+
+	double *centers			   = (double*) malloc(sizeof(double) * TEST_NETWORK_NEURONS * 3);
+	double *weights			   = (double*) malloc(sizeof(double) * TEST_NETWORK_NEURONS);
+	double *output			   = (double*) malloc(sizeof(double) * train.count);
+	int	   *clusterAllocations = (int*)    malloc(sizeof(int)    * train.count);
+	int	   *clusterPopulations = (int*)    malloc(sizeof(int)    * TEST_NETWORK_NEURONS);
+	double *clusterEnergies	   = (double*) malloc(sizeof(double) * TEST_NETWORK_NEURONS);
+	int		seed			   = TEST_SEED;
+	int		iterations;
+	initializeCenters(train, TEST_NETWORK_NEURONS, INITIALIZE_FIRST_POINTS, &seed, centers);
+	i4vec_negone(train.count, clusterAllocations);
+	kmeans_04(3, train.count, TEST_NETWORK_NEURONS, 500, iterations, train.input, clusterAllocations, centers, clusterPopulations, clusterEnergies);
+
+	ActivationMatrix activations;
+	allocateActivationMatrix(activations, ACTIVATIONS_DOUBLE, ACTIVATIONS_SAMPLE_MAJOR, train.count, TEST_NETWORK_NEURONS);
+
+	const ActivationKernel kernels[] = { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+	for (int i = 0; i < (int) (sizeof(kernels) / sizeof(kernels[0])); i++) {
+		if (!selectActivationKernel(kernels[i])) {
+			continue;
+		}
+		selectActivationPrecision(PRECISION_EXACT);
+		double exactError = validationError(train, validation, centers, activations, weights, output);
+		selectActivationPrecision(PRECISION_FAST);
+		double fastError = validationError(train, validation, centers, activations, weights, output);
+		selectActivationPrecision(PRECISION_EXACT);
+
+		char name[64];
+		snprintf(name, sizeof(name), "fastValidationError/%s", activationKernelName(kernels[i]));
+		report(name, fabs(fastError - exactError) / exactError, FAST_EXP_TOLERANCE);
+	}
+	selectActivationKernel(KERNEL_AUTO);
+
+	freeActivationMatrix(activations);
+	free(centers);
+	free(weights);
+	free(output);
+	free(clusterAllocations);
+	free(clusterPopulations);
+	free(clusterEnergies);
+	freeDataSet(train);
+	freeDataSet(validation);
+	return true;
+}
+
+/*
+ * Writes a single row to TEST_CSV_FILENAME and returns whether parseData accepts it.
+ *
+ * Parameters:
+ * const char *row - The row, without a line ending.
+ */
+static bool parseRowAccepted(const char *row) {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	FILE *file = fopen(TEST_CSV_FILENAME, "wb");
+	if (file == NULL) {
+		return false;
+	}
+	fprintf(file, "%s\n", row);
+	fclose(file);
+
+	DataSet dataSet;
+	bool accepted = parseData((char*) TEST_CSV_FILENAME, normalizationConstants, dataSet);
+	if (accepted) {
+		freeDataSet(dataSet);
+	}
+	remove(TEST_CSV_FILENAME);
+	return accepted;
+}
+
+/*
+ * Checks that parseData accepts well formed rows, including the largest value it can read, and rejects
+ * each kind of malformed row. parseData reports each rejected row to stderr as usual. Values too long to
+ * read must be rejected without overflowing, which building with -fsanitize=undefined checks.
+ */
+static void checkParseData() {
+	const char *acceptedRows[] = { "1,2,3,4", "366,23,7,-5", "1,2,3,999999999" };
+	const char *rejectedRows[] = { "1,2,3,9999999999", "1,2,3,1000000000", "1,2,3", "1,2,3,4,5", "1,2,x,4", "1,,3,4", "1,2,3,-", "1,2,3,4," };
+
+	for (int i = 0; i < (int) (sizeof(acceptedRows) / sizeof(acceptedRows[0])); i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "parseData/accept %s", acceptedRows[i]);
+		report(name, !parseRowAccepted(acceptedRows[i]), 0);
+	}
+	for (int i = 0; i < (int) (sizeof(rejectedRows) / sizeof(rejectedRows[0])); i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "parseData/reject %s", rejectedRows[i]);
+		report(name, parseRowAccepted(rejectedRows[i]), 0);
+	}
+}
+
+/*
+ * Saves a data set with numbered rows to TEST_STREAM_FILENAME, samples it with readSample, and returns
+ * the largest relative difference between how often a row was drawn and how often it should have been.
+ * Returns infinity if a row drawn isn't one of the file's.
+ */
+static double streamSampleError() {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	DataSet dataSet;
+	memset(&dataSet, 0, sizeof(dataSet));
+	dataSet.input  = (double*) malloc(sizeof(double) * TEST_STREAM_ROWS * 3);
+	dataSet.target = (double*) calloc(TEST_STREAM_ROWS, sizeof(double));
+	dataSet.count  = dataSet.rowCount = TEST_STREAM_ROWS;
+	for (int i = 0; i < TEST_STREAM_ROWS; i++) {
+		dataSet.input[i * 3]	 = i;
+		dataSet.input[i * 3 + 1] = 2 * i;
+		dataSet.input[i * 3 + 2] = 3 * i;
+	}
+	bool saved = saveData((char*) TEST_STREAM_FILENAME, NULL, normalizationConstants, dataSet);
+	freeDataSet(dataSet);
+
+	DataStream stream;
+	if (!saved || !openDataStream((char*) TEST_STREAM_FILENAME, normalizationConstants, stream)) {
+		remove(TEST_STREAM_FILENAME);
+		return INFINITY;
+	}
+
+	int	   *drawn = (int*)	  calloc(TEST_STREAM_ROWS, sizeof(int));
+	double *batch = (double*) malloc(sizeof(double) * TEST_STREAM_BATCH * 3);
+	int		seed  = TEST_SEED;
+	bool	valid = true;
+	for (int draws = 0; valid && draws < TEST_STREAM_DRAWS; draws += TEST_STREAM_BATCH) {
+		valid = readSample(stream, TEST_STREAM_BATCH, &seed, batch);
+		for (int i = 0; valid && i < TEST_STREAM_BATCH; i++) {
+			int row = (int) batch[i * 3];
+			valid = row >= 0 && row < TEST_STREAM_ROWS && batch[i * 3] == row && batch[i * 3 + 1] == 2 * row && batch[i * 3 + 2] == 3 * row;
+			drawn[valid ? row : 0]++;
+		}
+	}
+
+	double expected = (double) TEST_STREAM_DRAWS / TEST_STREAM_ROWS, maxError = 0;
+	for (int i = 0; i < TEST_STREAM_ROWS; i++) {
+		maxError = fmax(maxError, fabs(drawn[i] / expected - 1));
+	}
+
+	free(drawn);
+	free(batch);
+	closeDataStream(stream);
+	remove(TEST_STREAM_FILENAME);
+	return valid ? maxError : INFINITY;
+}
+
+/*
+ * Copies a data set with every few of its rows repeated at the end, so that it has rows to compact.
+ *
+ * Parameters:
+ * const DataSet &dataSet - The data set to copy.
+ * int every			  - Every how many rows are repeated.
+ * DataSet &repeated	  - The data set to fill with the copy. Release it with freeDataSet.
+ */
+static void repeatRows(const DataSet &dataSet, int every, DataSet &repeated) {
+	int count = dataSet.count + (dataSet.count + every - 1) / every;
+	repeated.input		  = (double*) malloc(sizeof(double) * count * 3);
+	repeated.target		  = (double*) malloc(sizeof(double) * count);
+	repeated.count		  = count;
+	repeated.mapping	  = NULL;
+	repeated.mappingSize  = 0;
+	repeated.weight		  = NULL;
+	repeated.rowCount	  = count;
+	repeated.targetSpread = 0;
+	memcpy(repeated.input,	dataSet.input,	sizeof(double) * dataSet.count * 3);
+	memcpy(repeated.target, dataSet.target, sizeof(double) * dataSet.count);
+	for (int dataIndex = 0, copyIndex = dataSet.count; dataIndex < dataSet.count; dataIndex += every, copyIndex++) {
+		memcpy(repeated.input + copyIndex * 3, dataSet.input + dataIndex * 3, sizeof(double) * 3);
+		repeated.target[copyIndex] = dataSet.target[dataIndex];
+	}
+}
+
+/*
+ * Runs a small sweep over data sets with repeated rows, with the driver's defaults apart from its size
+ * and successive halving.
+ *
+ * Parameters:
+ * const DataSet &train			 - The training data set.
+ * const DataSet &test			 - The testing data set.
+ * const DataSet &validation	 - The validation data set.
+ * TrainingMode trainingMode	 - How the output weights are trained.
+ * bool compactData				 - Whether the sweep compacts the data sets.
+ * float *optimisationResults	 - A preallocated matrix to hold the validation errors, size
+ *								   TEST_SWEEP_COUNTS x TEST_SWEEP_WIDTHS.
+ */
+static void runTestSweep(const DataSet &train, const DataSet &test, const DataSet &validation, TrainingMode trainingMode, bool compactData, float *optimisationResults) {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	SweepSettings settings;
+	settings.countMin		   = 50;
+	settings.countStep		   = 40;
+	settings.countNum		   = TEST_SWEEP_COUNTS;
+	settings.widthMin		   = 0.03;
+	settings.widthStep		   = 0.02;
+	settings.widthNum		   = TEST_SWEEP_WIDTHS;
+	settings.epochCount		   = 20;
+	settings.learningRate	   = 0.02;
+	settings.convergence.patience	 = 0;
+	settings.convergence.minDelta	 = 0;
+	settings.convergence.restoreBest = false;
+	settings.threadCount	   = 0;
+	settings.seed			   = TEST_SEED;
+	settings.warmStartClusters = true;
+	settings.kmeans			   = kmeans_04;
+	settings.clusterInitializer = INITIALIZE_FIRST_POINTS;
+	settings.trainingMode	   = trainingMode;
+	settings.ridge			   = TEST_NETWORK_RIDGE;
+	settings.activationLayout  = ACTIVATIONS_SAMPLE_MAJOR;
+	settings.activationStorage = ACTIVATIONS_DOUBLE;
+	settings.activationTables  = true;
+	settings.trainThreads	   = 1;
+	settings.halvingEpochs	   = 0;
+	settings.halvingRate	   = 3;
+	settings.sparseCutoff	   = 6;
+	settings.compactData	   = compactData;
+	settings.modelFilename	   = NULL;
+	settings.normalizationConstants = normalizationConstants;
+	settings.checkpointFilename = NULL;
+	settings.checkpointEpochs	= 0;
+	runSweep(settings, train, test, validation, optimisationResults);
+}
+
+/*
+ * Runs the same sweeps over data sets with repeated rows with and without compacting them, and returns
+ * the largest relative difference between their validation errors, for gradient descent and least
+ * squares in turn. Returns false if the data couldn't be loaded.
+ *
+ * Parameters:
+ * double *errors - A preallocated array to hold the difference of each training mode, length 2.
+ */
+static bool compactSweepErrors(double *errors) {
+	const double normalizationConstants[] = { 366.0, 24.0, 7.0 };
+	DataSet train, test, validation;
+	if (!parseData((char*) "data/train.csv", normalizationConstants, train)) {
+		return false;
+	}
+	if (!parseData((char*) "data/test.csv", normalizationConstants, test)) {
+		freeDataSet(train);
+		return false;
+	}
+	if (!parseData((char*) "data/validation.csv", normalizationConstants, validation)) {
+		freeDataSet(train);
+		freeDataSet(test);
+		return false;
+	}
+
+	DataSet repeatedTrain, repeatedTest, repeatedValidation;
+	repeatRows(train,	   TEST_REPEAT_EVERY, repeatedTrain);
+	repeatRows(test,	   TEST_REPEAT_EVERY, repeatedTest);
+	repeatRows(validation, TEST_REPEAT_EVERY, repeatedValidation);
+
+	const TrainingMode trainingModes[] = { TRAIN_GRADIENT_DESCENT, TRAIN_LEAST_SQUARES };
+	for (int i = 0; i < 2; i++) {
+		float rowResults[TEST_SWEEP_COUNTS * TEST_SWEEP_WIDTHS], compactResults[TEST_SWEEP_COUNTS * TEST_SWEEP_WIDTHS];
+		runTestSweep(repeatedTrain, repeatedTest, repeatedValidation, trainingModes[i], false, rowResults);
+		runTestSweep(repeatedTrain, repeatedTest, repeatedValidation, trainingModes[i], true,  compactResults);
+		errors[i] = 0;
+		for (int trialIndex = 0; trialIndex < TEST_SWEEP_COUNTS * TEST_SWEEP_WIDTHS; trialIndex++) {
+			errors[i] = fmax(errors[i], fabs(compactResults[trialIndex] - rowResults[trialIndex]) / rowResults[trialIndex]);
+		}
+	}
+
+	freeDataSet(repeatedTrain);
+	freeDataSet(repeatedTest);
+	freeDataSet(repeatedValidation);
+	freeDataSet(train);
+	freeDataSet(test);
+	freeDataSet(validation);
+	return true;
+}
+
+int main() {
+	const ActivationKernel kernels[] = { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+	const int			   kernelNum = sizeof(kernels) / sizeof(kernels[0]);
+
+	// The sweeps print their progress, so they run before any results are printed.
+	double compactErrors[2];
+	bool   compactLoaded = compactSweepErrors(compactErrors);
+
+	printf("\n");
+	printf("%-36s %-6s %11s %11s\n", "Check", "Result", "Error", "Tolerance");
+
+	// Every kernel the CPU supports must agree with exp.
+	for (int i = 0; i < kernelNum; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "activation/%s", activationKernelName(kernels[i]));
+		if (!selectActivationKernel(kernels[i])) {
+			printf("%-36s %-6s\n", name, "skip");
+			continue;
+		}
+		report(name, activationError(TEST_SEED), TEST_EXACT_TOLERANCE);
+		snprintf(name, sizeof(name), "fastExp/%s", activationKernelName(kernels[i]));
+		report(name, fastExpError(TEST_SEED), TEST_FAST_TOLERANCE);
+	}
+	selectActivationKernel(KERNEL_AUTO);
+
+	// Malformed rows must be rejected rather than read as something else.
+	checkParseData();
+
+	// Reading a file in blocks mustn't favour some of its rows.
+	report("readSample/file", streamSampleError(), TEST_STREAM_TOLERANCE);
+
+	// kmeans_04 is only a faster kmeans_03.
+	if (!checkKmeans()) {
+		printf("Could not load the data to compare kmeans_04 with kmeans_03.\n");
+		failureCount++;
+	}
+
+	// And the fast exp mustn't change what the sweep would pick.
+	if (!checkFastValidationError()) {
+		printf("Could not load the data to check the fast exp's validation error.\n");
+		failureCount++;
+	}
+
+	// Compacting repeated rows mustn't change the results of the sweep.
+	if (compactLoaded) {
+		report("compactData/gradientDescent", compactErrors[0], TEST_COMPACT_TOLERANCE);
+		report("compactData/leastSquares",	  compactErrors[1], TEST_COMPACT_TOLERANCE);
+	} else {
+		printf("Could not load the data to check the compacted sweeps.\n");
+		failureCount++;
+	}
+
+	if (failureCount > 0) {
+		printf("%d checks failed.\n", failureCount);
+		return 1;
+	}
+	printf("All checks passed.\n");
+	return 0;
+}